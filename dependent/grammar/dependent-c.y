@@ -13,12 +13,14 @@
 
 %union {
     /* Lexer values */
-    uint64_t integral;
+    Natural integral;
     const char *ident;
 
     /* Parser values */
     Expr expr;
     TopLevel top_level;
+    bool opaque;
+    SigmaLayout sigma_layout;
     TranslationUnit unit;
 
     struct {
@@ -79,6 +81,13 @@ void yyerror(YYLTYPE *lloc, Context *context, const char *error_message);
 %token TOK_DOUBLE_ARROW "=>"
 %token TOK_NAT_MAX      "NAT_MAX"
 
+    /* Words which are only keywords where an identifier could not be, and
+     * are identifiers everywhere else. See contextual_keyword. */
+%token TOK_OPAQUE       "opaque"
+%token TOK_TRANSPARENT  "transparent"
+%token TOK_DATA         "data"
+%token TOK_LAYOUT       "layout"
+
     /* Integers */
 %token <integral> TOK_INTEGRAL
 
@@ -88,6 +97,8 @@ void yyerror(YYLTYPE *lloc, Context *context, const char *error_message);
     /* Result types of each rule */
 %type <expr> simple_expr postfix_expr prefix_expr identity_expr expr
 %type <top_level> top_level top_level_
+%type <opaque> opacity
+%type <sigma_layout> layout_clause
 %type <unit> translation_unit
 
 %type <type_ident_list> type_ident_list type_ident_list_
@@ -146,7 +157,8 @@ simple_expr:
         $$.tag = EXPR_SIGMA;
         $$.sigma.num_fields = $fields.len;
         $$.sigma.field_names = $fields.names;
-        $$.sigma.field_types = $fields.types; }
+        $$.sigma.field_types = $fields.types;
+        $$.sigma.layout = SIGMA_LAYOUT_DERIVED; }
     | '<' arg_list[values] '>' {
         $$.tag = EXPR_PACK;
         $$.pack.as_type = NULL;
@@ -167,9 +179,14 @@ postfix_expr:
         $$.call.num_args = $args.len;
         $$.call.args = $args.args; }
     | postfix_expr[record] '[' TOK_INTEGRAL[field_num] ']' {
+        if (!natural_is_small(&$field_num)) {
+            natural_free(&$field_num);
+            yyerror(&@field_num, context, "Field number is too large.");
+            YYERROR;
+        }
         $$.tag = EXPR_ACCESS;
         alloc_assign($$.access.record, $record);
-        $$.access.field_num = $field_num; }
+        $$.access.field_num = $field_num.small; }
     ;
 
 prefix_expr:
@@ -216,7 +233,9 @@ prefix_expr:
 
 nat_ind_base_pattern:
       TOK_INTEGRAL[base] {
-        if ($base != 0) {
+        bool is_zero = natural_is(&$base, 0);
+        natural_free(&$base);
+        if (!is_zero) {
             yyerror(&@1, context, "Expected either \"0\" or \"NAT_MAX\" "
                 "for the base case of natural induction.");
             YYERROR;
@@ -227,7 +246,9 @@ nat_ind_base_pattern:
     ;
 nat_ind_ind_pattern:
       TOK_IDENT[name] '+' TOK_INTEGRAL[step] {
-        if ($step != 1) {
+        bool is_one = natural_is(&$step, 1);
+        natural_free(&$step);
+        if (!is_one) {
             yyerror(&@3, context, "Expected \"1\" for size of inductive "
                 "step.");
             YYERROR;
@@ -235,7 +256,9 @@ nat_ind_ind_pattern:
         $$.adds = true;
         $$.name = $name; }
     | TOK_IDENT[name] '-' TOK_INTEGRAL[step] {
-        if ($step != 1) {
+        bool is_one = natural_is(&$step, 1);
+        natural_free(&$step);
+        if (!is_one) {
             yyerror(&@3, context, "Expected \"1\" for size of inductive "
                 "step.");
             YYERROR;
@@ -259,9 +282,20 @@ expr:
     ;
 
 top_level:
-      top_level_ {
-        $$.location.line = @1.first_line;
-        $$.location.column = @1.first_column; }
+      opacity top_level_ {
+        $$ = $2;
+        $$.opaque = $1;
+        $$.location.line = @2.first_line;
+        $$.location.column = @2.first_column; }
+    ;
+
+opacity:
+      %empty {
+        $$ = false; }
+    | "transparent" {
+        $$ = false; }
+    | "opaque" {
+        $$ = true; }
     ;
 
 top_level_:
@@ -286,6 +320,49 @@ top_level_:
         $$.expr_decl.expr.lambda.param_types = $params.types;
         $$.expr_decl.expr.lambda.param_names = $params.idents;
         alloc_assign($$.expr_decl.expr.lambda.body, $body); }
+    | "data" TOK_IDENT[name] '(' type_ident_list[params] ')' '='
+          '{' maybe_type_ident_list[fields] '}' layout_clause[layout] ';' {
+        // Sugar for a function from the parameters to the sigma type.
+        $$.tag = TOP_LEVEL_EXPR_DECL;
+        $$.name = $name;
+
+        $$.expr_decl.type.tag = EXPR_FORALL;
+        $$.expr_decl.type.forall.num_params = $params.len;
+        alloc_array($$.expr_decl.type.forall.param_types, $params.len);
+        alloc_array($$.expr_decl.type.forall.param_names, $params.len);
+        for (size_t i = 0; i < $params.len; i++) {
+            $$.expr_decl.type.forall.param_types[i] = expr_copy(
+                context, &$params.types[i]);
+            $$.expr_decl.type.forall.param_names[i] = $params.idents[i];
+        }
+        alloc_assign($$.expr_decl.type.forall.ret_type, literal_expr_type);
+
+        Expr sigma = {
+              .tag = EXPR_SIGMA
+            , .sigma.num_fields = $fields.len
+            , .sigma.field_names = $fields.names
+            , .sigma.field_types = $fields.types
+            , .sigma.layout = $layout
+        };
+        sigma.location.line = @fields.first_line;
+        sigma.location.column = @fields.first_column;
+
+        $$.expr_decl.expr.tag = EXPR_LAMBDA;
+        $$.expr_decl.expr.lambda.num_params = $params.len;
+        $$.expr_decl.expr.lambda.param_types = $params.types;
+        $$.expr_decl.expr.lambda.param_names = $params.idents;
+        alloc_assign($$.expr_decl.expr.lambda.body, sigma); }
+    ;
+
+layout_clause:
+      %empty {
+        $$ = SIGMA_LAYOUT_DERIVED; }
+    | "layout" '(' TOK_IDENT[name] ')' {
+        if (!sigma_layout_parse(symbol_name($name), &$$)) {
+            yyerror(&@name, context, "Expected one of \"derived\", "
+                "\"tagged\", \"niche\" or \"packed\" for the layout.");
+            YYERROR;
+        }}
     ;
 
 translation_unit:
@@ -405,6 +482,72 @@ static void token_stream_push_char(TokenStream *stream, int c) {
     }
 }
 
+/* Look past whitespace at the next count other characters, without
+ * consuming anything. Those past the end of the stream are EOF.
+ */
+static void peek_past_whitespace(TokenStream *stream, size_t count,
+        int *peeked) {
+    unsigned line = stream->line, column = stream->column;
+    size_t num_popped = 0;
+    int *popped = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        int c;
+        do {
+            c = token_stream_pop_char(stream);
+            realloc_array(popped, num_popped + 1);
+            popped[num_popped] = c;
+            num_popped += 1;
+        } while (isspace(c));
+        peeked[i] = c;
+    }
+
+    while (num_popped > 0) {
+        num_popped -= 1;
+        token_stream_push_char(stream, popped[num_popped]);
+    }
+    dealloc(popped);
+    stream->line = line;
+    stream->column = column;
+}
+
+/* The token for a word which is a keyword only in some places, such that
+ * programs using it as an identifier elsewhere still parse:
+ *
+ *   - "opaque" and "transparent" start a top level, unless what follows
+ *     continues an expression instead, as in opaque(x), opaque[0], opaque = x
+ *     or opaque <- f() = x.
+ *   - "data" starts a top level, perhaps after one of those, when the name of
+ *     the data declaration follows.
+ *   - "layout" follows the closing brace of a data declaration's fields.
+ */
+static int contextual_keyword(TokenStream *stream, const char *ident) {
+    bool at_start = stream->last_token == 0 || stream->last_token == ';';
+    int next[2];
+
+    if ((strcmp(ident, "opaque") == 0 || strcmp(ident, "transparent") == 0)
+            && at_start) {
+        peek_past_whitespace(stream, 2, next);
+        if (next[0] == '(' || next[0] == '=' || next[0] == '<'
+                || (next[0] == '[' && isdigit(next[1]))) {
+            return TOK_IDENT;
+        }
+        return ident[0] == 'o' ? TOK_OPAQUE : TOK_TRANSPARENT;
+    } else if (strcmp(ident, "data") == 0 && (at_start
+            || stream->last_token == TOK_OPAQUE
+            || stream->last_token == TOK_TRANSPARENT)) {
+        peek_past_whitespace(stream, 1, next);
+        if (isalpha(next[0]) || next[0] == '_') {
+            stream->in_data = true;
+            return TOK_DATA;
+        }
+    } else if (strcmp(ident, "layout") == 0 && stream->in_data
+            && stream->last_token == '}') {
+        return TOK_LAYOUT;
+    }
+    return TOK_IDENT;
+}
+
 static void skip_whitespace(TokenStream *stream) {
     while (true) {
         int c = token_stream_pop_char(stream);
@@ -416,7 +559,7 @@ static void skip_whitespace(TokenStream *stream) {
     }
 }
 
-int yylex(YYSTYPE *lval, YYLTYPE *lloc, Context *context) {
+static int yylex_(YYSTYPE *lval, YYLTYPE *lloc, Context *context) {
 start_of_function:;
     TokenStream *stream = &context->tokens;
     skip_whitespace(stream);
@@ -469,6 +612,12 @@ start_of_function:;
         check_is_reserved(of,           TOK_OF)
         check_is_reserved(NAT_MAX,      TOK_NAT_MAX)
         else {
+            int token = contextual_keyword(stream, ident);
+            if (token != TOK_IDENT) {
+                dealloc(ident);
+                return token;
+            }
+
             const char *interned_ident = symbol_intern(&context->interns, ident);
             dealloc(ident);
             lval->ident = interned_ident;
@@ -477,14 +626,14 @@ start_of_function:;
 
 #undef check_is_reserved
     } else if (isdigit(c)) {
-        uint64_t integral = 0;
+        Natural integral = natural_small(0);
         token_stream_push_char(stream, c);
 
         while (true) {
             c = token_stream_pop_char(stream);
 
             if (isdigit(c)) {
-                integral = (integral * 10) + (c - '0');
+                natural_push_decimal(&integral, (unsigned)(c - '0'));
             } else {
                 token_stream_push_char(stream, c);
                 break;
@@ -540,6 +689,17 @@ start_of_function:;
     }
 }
 
+/* Read a token, remembering it for contextual_keyword. */
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, Context *context) {
+    TokenStream *stream = &context->tokens;
+    int token = yylex_(lval, lloc, context);
+    if (token == ';') {
+        stream->in_data = false;
+    }
+    stream->last_token = token;
+    return token;
+}
+
 void yyerror(YYLTYPE *lloc, Context *context, const char *error_message) {
     fprintf(stdout, "Parser error at line %d, column %d: %s\n",
         lloc->first_line, lloc->first_column, error_message);
@@ -19,9 +19,28 @@ void expr_pprint(struct Context*, FILE *to, unsigned indent, const Expr *expr);
  */
 bool expr_equal(struct Context*, const Expr *x, const Expr *y);
 
+/* Hash an expression such that expressions which are expr_equal hash to the
+ * same value.
+ */
+uint64_t expr_hash(struct Context*, const Expr *expr);
+
+/* The number of nodes in an expression. */
+size_t expr_size(struct Context*, const Expr *expr);
+
+/* Record that an expression and all of its subexpressions are well typed. */
+void expr_mark_well_typed(struct Context*, Expr *expr);
+
 /* Calculate the set of free variables in an expression. */
 void expr_free_vars(struct Context*, const Expr *expr, SymbolSet *set);
 
+/***** Sigma Layouts *********************************************************/
+
+/* The name of a layout, as written in layout clauses. */
+const char *sigma_layout_name(SigmaLayout layout);
+
+/* Find the layout with the given name. Returns false if there is none. */
+bool sigma_layout_parse(const char *name, SigmaLayout *result);
+
 /***** Top-Level Definitions *************************************************/
 void top_level_free(struct Context*, TopLevel *top_level);
 void top_level_pprint(struct Context*, FILE *to, const TopLevel *top_level);
@@ -35,6 +54,12 @@ void translation_unit_pprint(struct Context*, FILE *to,
 void expr_subst(struct Context*, Expr *expr,
     const char *name, const Expr *replacement);
 
+/* Simultaneously substitute names[i] for replacements[i] in a single pass.
+ * Names may be NULL, in which case the corresponding replacement is ignored.
+ */
+void expr_subst_many(struct Context*, Expr *expr, size_t num,
+    const char *const *names, const Expr *replacements);
+
 /***** Specializations of printf *********************************************/
 
 #define ewrap(...) \
@@ -54,6 +79,8 @@ __attribute__((__format__ (__printf__, 3, 5)))
  * $(e - print an expression, parenthesized if it is complex (eg `1 + 2` would
  *       be parenthesized, but `3` would not).
  *
+ * Nothing is printed to stderr while the context is quiet.
+ *
  * Arguments to these additional escapes should be passed through an array
  * of pointers rather than directly as arguments. For example:
  *
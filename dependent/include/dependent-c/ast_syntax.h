@@ -8,7 +8,8 @@ typedef struct {
 
 typedef enum {
     // Misc.
-      EXPR_IDENT
+      EXPR_IDENT  // A local variable.
+    , EXPR_GLOBAL // A global, by its index into the symbol table.
     , EXPR_TYPE
 
     // Function type, constructor, and destructor.
@@ -42,13 +43,30 @@ typedef enum {
     , EXPR_ACCESS
 } ExprTag;
 
+/* How the fields of a sigma type are stored, as chosen by the layout clause
+ * of the data declaration defining it. Sigma types with different layouts are
+ * different types, since their values are represented differently.
+ */
+typedef enum {
+      SIGMA_LAYOUT_DERIVED // Chosen by the compiler.
+    , SIGMA_LAYOUT_TAGGED  // Every Bool field is stored by itself.
+    , SIGMA_LAYOUT_NICHE   // Bool fields deciding whether a later field holds
+                           // a value are stored in niches of that field.
+    , SIGMA_LAYOUT_PACKED  // Bool fields are stored as single bits.
+} SigmaLayout;
+
 typedef struct Expr Expr;
 struct Expr {
     LocationInfo location;
 
     ExprTag tag;
+    // Set once the expression is known to be well typed in its scope. Since
+    // substitution preserves typing it is kept by copies and substitutions,
+    // letting evaluation skip checking such terms again.
+    bool well_typed;
     union {
         const char *ident;
+        size_t global;
         // struct {} type;
 
         struct {
@@ -95,7 +113,7 @@ struct Expr {
         } ifthenelse;
 
         // struct {} nat;
-        uint64_t natural;
+        Natural natural;
         struct {
             Expr *natural;
             bool goes_down;
@@ -108,6 +126,7 @@ struct Expr {
             size_t num_fields;
             const char **field_names; // May be NULL if params not named.
             Expr *field_types;
+            SigmaLayout layout;
         } sigma;
         struct {
             Expr *as_type; // May be NULL if fields are non-dependent
@@ -141,6 +160,18 @@ struct Expr {
           .tag = EXPR_NAT \
     })
 
+#define literal_expr_true \
+    ((Expr){ \
+          .tag = EXPR_BOOLEAN \
+        , .boolean = true \
+    })
+
+#define literal_expr_false \
+    ((Expr){ \
+          .tag = EXPR_BOOLEAN \
+        , .boolean = false \
+    })
+
 typedef enum {
       TOP_LEVEL_EXPR_DECL
 } TopLevelTag;
@@ -148,6 +179,8 @@ typedef enum {
 typedef struct {
     LocationInfo location;
     const char *name;
+    // Opaque definitions are never unfolded when checking conversion.
+    bool opaque;
 
     TopLevelTag tag;
     union {
@@ -0,0 +1,43 @@
+#ifndef DEPENDENT_C_BUILTIN_H
+#define DEPENDENT_C_BUILTIN_H
+
+struct Context;
+
+/***** Builtin Globals *******************************************************/
+
+/* A global implemented natively rather than defined, taking naturals and
+ * returning a natural or a boolean, as 0 or 1. Builtins are registered as
+ * the first globals, in the order of the registry, and are lowered to C as
+ * static inline functions. Used as values, both backends wrap them in
+ * closures calling them like any other global.
+ *
+ * Type checking evaluates builtins exactly, while at run time naturals are
+ * 64 bits. A builtin which may overflow there traps instead, failing the
+ * bytecode VM's run and calling dc_overflow() in generated C, which aborts
+ * unless the code including it defines it otherwise. Whenever both give a
+ * result it is the same.
+ */
+typedef struct {
+    const char *name;
+    size_t num_params;
+    ExprTag ret_type; // EXPR_NAT or EXPR_BOOL.
+    bool may_overflow;
+    Natural (*eval)(const Natural *args); // Exact, for type checking.
+
+    // For the bytecode VM, returning false if the result overflows.
+    bool (*run)(const uint64_t *args, uint64_t *result);
+
+    const char *c_body; // The C expression computing it from x and y.
+} Builtin;
+
+/* Register every builtin in the symbol table, before any other global. */
+void builtin_register_all(struct Context*);
+
+/* The builtin a global is, or NULL if it is not one. */
+const Builtin *builtin_lookup(const SymbolTable *symbols, size_t global);
+
+/* Evaluate a call of a builtin, whose arguments must evaluate to literals. */
+bool builtin_eval_call(struct Context*, const Builtin *builtin,
+    const Expr *call, Expr *result);
+
+#endif /* DEPENDENT_C_BUILTIN_H */
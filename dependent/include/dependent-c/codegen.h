@@ -0,0 +1,51 @@
+#ifndef DEPENDENT_C_CODEGEN_H
+#define DEPENDENT_C_CODEGEN_H
+
+struct Context;
+
+/* Lower the checked top-levels of a translation unit to C, writing it to the
+ * given file. Types, Type-sorted parameters and proofs are erased, Nat
+ * becomes uint64_t, Bool becomes bool, and records become structs. Fields
+ * whose types branch on an earlier Bool field become unions tagged by it, or
+ * store it in a niche when the other branch is empty. Vectors by induction,
+ * such as Array(T, n), become flat arrays of their elements. Records whose
+ * layout depends upon their fields become pointers to buffers allocated in
+ * the arena below, sized by an emitted NAME_size function and built by
+ * NAME_new, whose fields are found through NAME_offset_K functions. Only the
+ * types which the lowered functions refer to are declared.
+ *
+ * Functions with type parameters are specialized to each closed type
+ * argument they are called with, so that every function works on concrete
+ * representations. Local functions are lifted into functions taking the
+ * locals they capture as extra parameters, and function values point at
+ * closures. Their environments live on the stack of the function creating
+ * them where they cannot outlive it, and otherwise in an arena which is
+ * released in stack order: each function whose result holds no pointers
+ * into it releases what was allocated while it ran. C code calling a function
+ * which returns such a pointer releases it the same way, by calling
+ * dcrt_release with the dcrt_mark that dcrt_save returned before the call.
+ *
+ * Top-levels which cannot be lowered are reported and left out, in which
+ * case false is returned.
+ */
+bool codegen_translation_unit(struct Context*, FILE *to,
+    const TranslationUnit *unit);
+
+/* Lower only the given globals as above, along with the specializations they
+ * call. Calls of other monomorphic functions cannot be lowered.
+ */
+bool codegen_globals(struct Context*, FILE *to, size_t num_globals,
+    const size_t *globals);
+
+/* Lower a translation unit as above, but split into a C file for each global
+ * holding the functions lowered from it, a header they share declaring every
+ * type and function, and a Makefile building them into a static library, all
+ * in the given directory. The files of a global are named after its C
+ * function, such as dc_main.c and dc_main.h for main. Files whose contents
+ * would not change are left untouched, so that only the files of changed
+ * globals are rebuilt.
+ */
+bool codegen_translation_unit_split(struct Context*, const char *dir,
+    const TranslationUnit *unit);
+
+#endif /* DEPENDENT_C_CODEGEN_H */
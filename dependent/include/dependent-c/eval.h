@@ -0,0 +1,33 @@
+#ifndef DEPENDENT_C_EVAL_H
+#define DEPENDENT_C_EVAL_H
+
+struct Context;
+
+/***** Compiled Evaluation ***************************************************/
+
+/* The body of a global function compiled into a tree of nodes, each holding
+ * the C function which evaluates it. Variables are resolved to slots of an
+ * environment holding the arguments of a call and the locals bound by natural
+ * induction, so that applying the function neither substitutes the arguments
+ * into its body nor dispatches on the syntax of each node it evaluates.
+ */
+typedef struct EvalCode EvalCode;
+
+void eval_code_free(struct Context*, EvalCode *code);
+
+/* The compiled definition of a global function, compiling it on first use.
+ * Returns NULL if the global is not a defined function, or if compiled
+ * evaluation is disabled.
+ */
+const EvalCode *eval_global_code(struct Context*, size_t global);
+
+/* The number of parameters of a compiled function. */
+size_t eval_code_num_params(const EvalCode *code);
+
+/* Evaluate an application of a compiled function to the given arguments,
+ * exactly as type_eval would evaluate its body with them substituted.
+ */
+bool eval_apply(struct Context*, const EvalCode *code, const Expr *args,
+    Expr *result);
+
+#endif /* DEPENDENT_C_EVAL_H */
@@ -6,10 +6,19 @@
 #include <stddef.h>
 #include <stdio.h>
 
-#include "dependent-c/ast_syntax.h"   /* No dependencies */
+#include "dependent-c/nat.h"          /* No dependencies */
+#include "dependent-c/ast_syntax.h"   /* nat */
 #include "dependent-c/lex.h"          /* No dependencies */
-#include "dependent-c/symbol_table.h" /* ast_syntax */
+#include "dependent-c/memo.h"         /* ast_syntax */
+#include "dependent-c/symbol_table.h" /* ast_syntax, memo */
+#include "dependent-c/builtin.h"      /* ast_syntax, symbol_table */
 #include "dependent-c/type.h"         /* ast_syntax */
+#include "dependent-c/resolve.h"      /* ast_syntax */
+#include "dependent-c/layout.h"       /* ast_syntax */
+#include "dependent-c/codegen.h"      /* ast_syntax */
+#include "dependent-c/vm.h"           /* ast_syntax */
+#include "dependent-c/eval.h"         /* ast_syntax */
+#include "dependent-c/jit.h"          /* ast_syntax */
 #include "dependent-c/ast.h"          /* ast_syntax, symbol_table */
 
 typedef struct Context Context;
@@ -19,9 +28,45 @@ struct Context {
     char *source_name;
     TokenStream tokens;
     InternedSymbols interns;
+    FreshSymbols fresh;
     SymbolTable symbol_table;
     TranslationUnit ast;
 
+    /* Results of evaluation shared between identical subexpressions for the
+     * duration of a single outermost call to type_eval. */
+    ExprMemo eval_shared;
+    unsigned eval_depth;
+
+    /* Upper bound on eval_depth. Evaluation that would recurse deeper is
+     * reported as an error rather than overflowing the stack. */
+    unsigned eval_depth_cap;
+
+    /* Set when evaluation consults the types of locals in the current scope,
+     * whose result must then not be shared with other scopes. */
+    bool eval_scoped;
+
+    /* While positive, diagnostics are not printed, for checks which are
+     * expected to fail and report nothing, such as conversion. */
+    unsigned quiet;
+
+    /* Definitions of globals compiled for evaluation, indexed by global and
+     * compiled on demand, unless compiled evaluation is disabled. */
+    size_t num_compiled;
+    struct EvalCode **compiled;
+    bool eval_compiled;
+
+    /* Globals compiled to native code once they are unfolded often. */
+    Jit jit;
+
+    /* Upper bound on the memory used by the per-global tables of evaluated
+     * applications, and how much of it is currently in use. */
+    size_t table_cap;
+    size_t table_bytes;
+
+    /* Upper bound on the number of specializations of polymorphic functions
+     * generated when lowering to C. */
+    size_t specialization_cap;
+
     /* Whether or not to use color when printing to the terminal. */
     bool color_enabled;
 };
@@ -0,0 +1,54 @@
+#ifndef DEPENDENT_C_JIT_H
+#define DEPENDENT_C_JIT_H
+
+struct Context;
+
+/***** Native Evaluation *****************************************************/
+
+/* A global lowered to C and loaded from a shared object, taking its arguments
+ * as naturals, with booleans as 0 or 1. Sets overflowed, returning nothing
+ * meaningful, if a natural would not fit in 64 bits.
+ */
+typedef uint64_t JitFn(const uint64_t *args, bool *overflowed);
+
+typedef enum {
+      JIT_COUNTING  // Not yet called often enough to be compiled.
+    , JIT_NATIVE
+    , JIT_REJECTED  // Cannot be compiled, so is always interpreted.
+} JitStatus;
+
+/* Globals which are unfolded often during type checking are compiled to
+ * native code with the system C compiler, when they are first-order functions
+ * on naturals and booleans calling only other such functions.
+ */
+typedef struct {
+    bool enabled;
+    bool compiler_missing; // Once set, nothing more is compiled.
+    size_t threshold;      // How many unfoldings make a global hot.
+
+    size_t num_globals;
+    struct JitGlobal {
+        JitStatus status;
+        size_t unfoldings;
+        JitFn *native;
+    } *globals;
+
+    // The directory holding the generated code and the shared objects loaded
+    // from it, which are unloaded when it is freed.
+    char *dir;
+    size_t num_handles;
+    void **handles;
+} Jit;
+
+Jit jit_new(void);
+void jit_free(Jit *jit);
+
+/* Count an unfolding of a call of a global, compiling the global once it is
+ * hot, and evaluate the call natively if it has been compiled and its
+ * arguments are already literals. Reports nothing otherwise, or if a natural
+ * overflows 64 bits natively, returning false so that the call is
+ * interpreted instead.
+ */
+bool jit_eval_call(struct Context*, const Expr *call, Expr *result);
+
+#endif /* DEPENDENT_C_JIT_H */
@@ -0,0 +1,83 @@
+#ifndef DEPENDENT_C_LAYOUT_H
+#define DEPENDENT_C_LAYOUT_H
+
+struct Context;
+
+/***** Data Layout ***********************************************************/
+
+/* How the runtime representation of a type is laid out in memory, using the
+ * sizes and alignments of the C types it is lowered to. Types which carry no
+ * information at runtime have size zero.
+ */
+typedef struct {
+    bool is_static; // Whether the size is known without knowing any values.
+    size_t size;    // Zero unless the size is static.
+    size_t align;
+    bool has_niche; // Whether some bit pattern of the representation is never
+                    // a value, so that it can stand for an absent value.
+} Layout;
+
+/* The layout of a sigma type. Fields with static sizes are placed first,
+ * most aligned first to minimise padding, followed by the dynamically sized
+ * fields in their original order.
+ *
+ * A Bool field which only decides whether a later field of type
+ * "if tag then T else {}" (or the reverse) holds a value is stored in a niche
+ * of T, taking no space of its own, unless the sigma type's layout is tagged
+ * or packed. Packed sigma types store their Bool fields as bits after every
+ * other statically sized field, eight to a byte.
+ */
+typedef struct {
+    Layout layout;
+    size_t num_fields;
+    Layout *fields;   // Indexed by field number.
+    size_t *order;    // Field numbers in the order they are placed in memory.
+    size_t *offsets;  // Indexed by field number, for statically placed fields.
+    size_t num_static; // The number of fields at the start of order which
+                       // have static offsets.
+    size_t *niches;   // Indexed by field number. For a Bool field stored in a
+                      // niche, the field storing it, otherwise itself.
+    bool *bits;       // Indexed by field number. Whether the field is stored
+                      // as a single bit, in the byte at its offset.
+} RecordLayout;
+
+/* Lay out a type in the current scope. Returns false if the type is
+ * abstract, so that its representation is unknown.
+ */
+bool layout_type(struct Context*, const Expr *type, Layout *result);
+
+/* Lay out the fields of a sigma type in the current scope. */
+bool layout_record(struct Context*, const Expr *sigma, RecordLayout *result);
+void record_layout_free(RecordLayout *layout);
+
+/* Determine whether a field of a sigma type is "if tag then T else {}" (or
+ * the reverse), where tag is an earlier Bool field which no other field
+ * depends upon, so that the field only holds a value of T when its tag says
+ * so. If it is, T is placed in payload. Must be called with the earlier
+ * fields in scope.
+ */
+bool layout_optional_field(struct Context*, const Expr *sigma, size_t field,
+    size_t *tag, Expr *payload);
+
+/* The shape of a vector by induction, such as
+ *
+ *     Array(T, n) = case n of | 0 => {} | x + 1 => {T, Array(T, x)}
+ *
+ * whose values hold n values of T one after another, exactly as an array of
+ * T would. The length is a natural literal when it is known statically.
+ */
+typedef struct {
+    Expr elem;
+    Expr length;
+} VectorShape;
+
+/* Recognise a vector in the current scope, either as nested sigma types
+ * ending in {} or as a stuck application of a type family defined as above.
+ */
+bool layout_vector(struct Context*, const Expr *type, VectorShape *result);
+void vector_shape_free(struct Context*, VectorShape *shape);
+
+/* Round an offset up to a multiple of an alignment. */
+size_t layout_align_up(size_t offset, size_t align);
+
+#endif /* DEPENDENT_C_LAYOUT_H */
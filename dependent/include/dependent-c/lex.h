@@ -28,6 +28,11 @@ typedef struct {
     CharStream source;
     unsigned line;
     unsigned column;
+
+    // The last token read, or 0 before the first, and whether it is within a
+    // data declaration, for words which are keywords only in some places.
+    int last_token;
+    bool in_data;
 } TokenStream;
 
 /* Create and free token streams. */
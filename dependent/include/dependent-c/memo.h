@@ -0,0 +1,50 @@
+#ifndef DEPENDENT_C_MEMO_H
+#define DEPENDENT_C_MEMO_H
+
+struct Context;
+
+/***** Expression Memo Tables (aka map from Expr -> Expr) ********************/
+
+/* An open-addressed hash table keyed on structural equality of expressions.
+ * Both keys and values are owned by the table.
+ */
+typedef struct {
+    size_t len;
+    size_t cap;
+
+    // Statistics, maintained by lookups and inserts.
+    size_t hits;
+    size_t misses;
+    size_t bytes; // Approximate size of all keys and values.
+
+    struct ExprMemoEntry {
+        uint64_t hash;
+        bool occupied;
+        Expr key;
+        Expr value;
+    } *entries;
+} ExprMemo;
+
+ExprMemo expr_memo_new(void);
+void expr_memo_free(struct Context*, ExprMemo *memo);
+
+/* Remove every entry, keeping the allocated table around for reuse. */
+void expr_memo_clear(struct Context*, ExprMemo *memo);
+
+/* Lookup the value associated with a key. On success a copy of the value is
+ * placed in result.
+ */
+bool expr_memo_lookup(struct Context*, ExprMemo *memo,
+    const Expr *key, Expr *result);
+
+/* Associate a copy of value with a copy of key. Does nothing if the key is
+ * already present.
+ */
+void expr_memo_insert(struct Context*, ExprMemo *memo,
+    const Expr *key, const Expr *value);
+
+/* The approximate number of bytes an entry for key and value would occupy. */
+size_t expr_memo_entry_size(struct Context*,
+    const Expr *key, const Expr *value);
+
+#endif /* DEPENDENT_C_MEMO_H */
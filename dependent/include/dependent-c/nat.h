@@ -0,0 +1,46 @@
+#ifndef DEPENDENT_C_NAT_H
+#define DEPENDENT_C_NAT_H
+
+/***** Arbitrary Precision Naturals ******************************************/
+
+/* A natural number. Those which fit in 64 bits are stored unboxed in small,
+ * so that the common case never allocates. Larger ones are stored in digits,
+ * base 2^32 with the least significant first and the last nonzero, in which
+ * case small is unused. A natural only has digits if it needs more than 64
+ * bits, so each value has exactly one representation.
+ */
+typedef struct {
+    uint64_t small;
+    size_t num_digits; // 0 for small naturals.
+    uint32_t *digits;
+} Natural;
+
+Natural natural_small(uint64_t value);
+Natural natural_copy(const Natural *n);
+void natural_free(Natural *n);
+
+/* Whether a natural is small, and if so whether it equals value. */
+bool natural_is_small(const Natural *n);
+bool natural_is(const Natural *n, uint64_t value);
+
+bool natural_equal(const Natural *x, const Natural *y);
+/* Negative, zero or positive as x is less than, equal to or greater than y. */
+int natural_compare(const Natural *x, const Natural *y);
+/* The hash of a small natural is its value. */
+uint64_t natural_hash(const Natural *n);
+
+/* Arithmetic, which never overflows. Subtraction stops at 0, and division
+ * and remainder by 0 give 0.
+ */
+Natural natural_add(const Natural *x, const Natural *y);
+Natural natural_sub(const Natural *x, const Natural *y);
+Natural natural_mul(const Natural *x, const Natural *y);
+Natural natural_div(const Natural *x, const Natural *y);
+Natural natural_mod(const Natural *x, const Natural *y);
+
+/* Append a decimal digit to a natural, as when reading a literal. */
+void natural_push_decimal(Natural *n, unsigned digit);
+
+void natural_fprint(FILE *to, const Natural *n);
+
+#endif /* DEPENDENT_C_NAT_H */
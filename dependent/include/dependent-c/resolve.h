@@ -0,0 +1,15 @@
+#ifndef DEPENDENT_C_RESOLVE_H
+#define DEPENDENT_C_RESOLVE_H
+
+struct Context;
+
+/* Register the builtins and every global of a translation unit in the
+ * symbol table and replace each reference to a global with its index, so
+ * that later passes never have to look names up. Locally bound names are
+ * left as identifiers.
+ * Reports every unbound or duplicate name in the unit, and returns false if
+ * there were any.
+ */
+bool resolve_translation_unit(struct Context*, TranslationUnit *unit);
+
+#endif /* DEPENDENT_C_RESOLVE_H */
@@ -19,8 +19,45 @@ void symbol_free_all(InternedSymbols *interns);
 
 const char *symbol_intern(InternedSymbols *interns, const char *str);
 
-/* Returns a fresh symbol based upon the given string. */
-const char *symbol_gensym(InternedSymbols *interns, const char *str);
+/***** Fresh Symbols *********************************************************/
+
+/* Fresh symbols are numbered variants of another symbol which bypass the
+ * interner entirely. A fresh symbol points at the marker of its FreshSymbol,
+ * which is always '\0' and so can never be confused with an interned (and
+ * necessarily non-empty) symbol. Its text is only rendered when printed.
+ */
+typedef struct {
+    char marker;
+    const char *base;
+    uint64_t number;
+    char *rendered; // NULL until the symbol is first printed.
+    char *mangled;  // NULL until the symbol is first used in generated code.
+} FreshSymbol;
+
+typedef struct {
+    size_t len;
+    size_t cap;
+    FreshSymbol **symbols;
+} FreshSymbols;
+
+FreshSymbols symbol_fresh_new(void);
+void symbol_fresh_free_all(FreshSymbols *fresh);
+
+/* Returns a symbol distinct from every other symbol, based upon the given
+ * one.
+ */
+const char *symbol_fresh(FreshSymbols *fresh, const char *symbol);
+
+/* Returns the text of a symbol for printing. Fresh symbols are written as
+ * base#number, which cannot be read back as an identifier.
+ */
+const char *symbol_name(const char *symbol);
+
+/* Returns the text of a symbol for use within an identifier of generated
+ * code. Fresh symbols are written as number_base, and identifiers cannot
+ * begin with a digit, so these never collide with symbols read from source.
+ */
+const char *symbol_mangled(const char *symbol);
 
 /***** Symbol Table (aka map from Symbol -> Type) ****************************/
 typedef struct {
@@ -29,6 +66,23 @@ typedef struct {
     Expr *global_types;
     bool *global_defined;
     Expr *global_defines;
+    // The evaluated definition of each global, computed on first use. The
+    // global's name is kept in terms alongside this, so it can be compared
+    // folded and only unfolded when needed.
+    bool *global_evaluated;
+    Expr *global_values;
+    // One more than the greatest height of the other globals a global's
+    // definition refers to. Conversion unfolds the higher side first.
+    unsigned *global_heights;
+    bool *global_opaque;
+    // Which parameters of each global's definition a call always evaluates,
+    // computed on first use and NULL until then.
+    bool **global_strict;
+    // Fully evaluated applications of each global, keyed on the call with
+    // the arguments it is strict in evaluated.
+    ExprMemo *global_tables;
+    // The first globals are builtins, which have no definition.
+    size_t num_builtins;
 
     size_t locals_stack_size;
     struct {
@@ -39,7 +93,7 @@ typedef struct {
 } SymbolTable;
 
 SymbolTable symbol_table_new(void);
-void symbol_table_free(SymbolTable *symbols);
+void symbol_table_free(struct Context*, SymbolTable *symbols);
 
 /* Enter and leave local scopes. */
 void symbol_table_enter_scope(SymbolTable *symbols);
@@ -60,14 +114,20 @@ bool symbol_table_register_local(SymbolTable *symbols,
 bool symbol_table_lookup(SymbolTable *symbols,
     const char *name, Expr *result);
 
-/* Lookup a symbol's definition. Returns false if the symbol is not defined. */
-bool symbol_table_lookup_define(SymbolTable *symbols,
-    const char *name, Expr *result);
+/* Lookup the index of the global a symbol refers to. Returns false if the
+ * symbol is not a global or is shadowed by a local.
+ */
+bool symbol_table_lookup_global(SymbolTable *symbols,
+    const char *name, size_t *index);
 
 /* Print the contents of the symbol table. */
 void symbol_table_pprint(struct Context *ctx, FILE *to,
     const SymbolTable *symbols);
 
+/* Print usage statistics of the tables of evaluated applications. */
+void symbol_table_pprint_tables(struct Context *ctx, FILE *to,
+    const SymbolTable *symbols);
+
 /***** Symbol Sets ***********************************************************/
 
 typedef struct {
@@ -8,6 +8,26 @@ bool type_infer(struct Context*, const Expr *expr, Expr *result);
 bool type_equal(struct Context*, const Expr *type1, const Expr *type2);
 bool type_eval(struct Context*, const Expr *type, Expr *result);
 
-bool type_check_top_level(struct Context*, const TopLevel *top_level);
+/* Evaluate a type as type_eval does, but unfolding opaque globals at its head
+ * too, as finding the representation of its values must.
+ */
+bool type_eval_transparent(struct Context*, const Expr *type, Expr *result);
+
+/* Unfold the defined global at the head of a type once, substituting the
+ * arguments it is applied to but evaluating nothing further. Fails if there
+ * is no such global.
+ */
+bool type_unfold(struct Context*, const Expr *type, Expr *result);
+
+/* Which parameters a defined global always evaluates, indexed by parameter,
+ * or NULL if that is not known.
+ */
+const bool *type_global_strict(struct Context*, size_t global);
+
+/* Determine if two types are convertible without reporting anything. */
+bool type_convertible(struct Context*, const Expr *type1, const Expr *type2);
+
+/* Type check a top-level, marking it as well typed if it is. */
+bool type_check_top_level(struct Context*, TopLevel *top_level);
 
 #endif /* DEPENDENT_C_TYPE_H */
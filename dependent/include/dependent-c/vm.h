@@ -0,0 +1,89 @@
+#ifndef DEPENDENT_C_VM_H
+#define DEPENDENT_C_VM_H
+
+struct Context;
+
+/***** Bytecode Virtual Machine **********************************************/
+
+/* Values at runtime. Naturals and booleans are unboxed, while tuples and
+ * closures point into the machine's arena. Types and proofs carry no
+ * information, so they are never computed and are represented by 0.
+ */
+typedef uint64_t VmValue;
+
+/* A position in the arena, to free everything allocated since. */
+typedef struct {
+    size_t num_chunks;
+    size_t chunk_used;
+    size_t chunk_cap;
+} VmMark;
+
+/* Checked definitions compiled to bytecode for a stack machine. Each function
+ * has a frame holding its arguments, then the locals it captured if it is a
+ * closure, then the locals it binds, with the operand stack above that.
+ */
+typedef struct {
+    size_t code_len;
+    size_t code_cap;
+    uint64_t *code;
+
+    size_t num_functions;
+    struct VmFunction {
+        size_t entry;        // The index of its first instruction.
+        size_t num_captures;
+        size_t num_locals;   // Including its arguments and captures.
+        size_t frame_size;   // Its locals and its deepest operand stack.
+
+        // How its result refers to the arena: 0 if it does not, the number
+        // of fields if it is a tuple of values which do not, or SIZE_MAX if
+        // it may hold more or that is not known.
+        size_t result_words;
+    } *functions;
+    // Functions are numbered by global, followed by the local functions.
+    size_t num_globals;
+
+    // Runtime state, kept between runs to avoid reallocating it.
+    size_t stack_cap;
+    VmValue *stack;
+    size_t frames_cap;
+    struct VmFrame {
+        size_t return_to;
+        size_t base;
+        const struct VmFunction *function;
+        VmMark mark; // The arena when the call was made.
+    } *frames;
+
+    // Tuples and closures, freed all at once at the start of each run. What
+    // a call allocates is also freed when it returns, unless its result
+    // refers to it, as a result which is a tuple of values which do not is
+    // moved down to where the call started allocating.
+    size_t num_chunks;
+    VmValue **chunks;
+    size_t chunk_used;
+    size_t chunk_cap;
+    VmValue *spare_chunk; // Freed, but kept for reuse.
+} Vm;
+
+Vm vm_new(void);
+void vm_free(Vm *vm);
+
+/* Compile the definition of a global along with those of the globals it
+ * refers to, directly or through others, skipping those compiled already.
+ * Builtins used as values are compiled to functions calling them. Returns
+ * false and compiles nothing if any of them refers to a global which is not
+ * defined, or holds a natural literal of more than 64 bits.
+ */
+bool vm_compile(struct Context*, Vm *vm, size_t global);
+
+/* Call a global taking no parameters. Returns false if evaluation reached
+ * explode. Tuples and closures in the result last until the next run.
+ */
+bool vm_run(struct Context*, Vm *vm, size_t global, VmValue *result);
+
+/* Convert a value of a closed type back into the expression it stands for.
+ * Returns false for functions and proofs, which have no such expression.
+ */
+bool vm_value_to_expr(struct Context*, VmValue value, const Expr *type,
+    Expr *result);
+
+#endif /* DEPENDENT_C_VM_H */
@@ -22,6 +22,9 @@ bool expr_equal(Context *ctx, const Expr *x, const Expr *y) {
       case EXPR_IDENT:
         return x->ident == y->ident;
 
+      case EXPR_GLOBAL:
+        return x->global == y->global;
+
       case EXPR_FORALL:
         if (x->forall.num_params != y->forall.num_params) {
             return false;
@@ -40,7 +43,8 @@ bool expr_equal(Context *ctx, const Expr *x, const Expr *y) {
             return false;
         }
         for (size_t i = 0; i < x->lambda.num_params; i++) {
-            if (!expr_equal(ctx, x->lambda.param_types, y->lambda.param_types)
+            if (!expr_equal(ctx,
+                        &x->lambda.param_types[i], &y->lambda.param_types[i])
                     || x->lambda.param_names[i] != y->lambda.param_names[i]) {
                 return false;
             }
@@ -84,7 +88,7 @@ bool expr_equal(Context *ctx, const Expr *x, const Expr *y) {
             && expr_equal(ctx, x->ifthenelse.else_, y->ifthenelse.else_);
 
       case EXPR_NATURAL:
-        return x->natural == y->natural;
+        return natural_equal(&x->natural, &y->natural);
 
       case EXPR_NAT_IND:
         return expr_equal(ctx, x->nat_ind.natural, y->nat_ind.natural)
@@ -94,7 +98,8 @@ bool expr_equal(Context *ctx, const Expr *x, const Expr *y) {
             && expr_equal(ctx, x->nat_ind.ind_val, y->nat_ind.ind_val);
 
       case EXPR_SIGMA:
-        if (x->sigma.num_fields != y->sigma.num_fields) {
+        if (x->sigma.num_fields != y->sigma.num_fields
+                || x->sigma.layout != y->sigma.layout) {
             return false;
         }
         for (size_t i = 0; i < x->sigma.num_fields; i++) {
@@ -107,8 +112,7 @@ bool expr_equal(Context *ctx, const Expr *x, const Expr *y) {
         return true;
 
       case EXPR_PACK:
-        if ((x->pack.as_type == NULL && y->pack.as_type != NULL)
-                || y->pack.as_type == NULL) {
+        if ((x->pack.as_type == NULL) != (y->pack.as_type == NULL)) {
             return false;
         }
         if ((x->pack.as_type != NULL
@@ -130,8 +134,206 @@ bool expr_equal(Context *ctx, const Expr *x, const Expr *y) {
     }
 }
 
+static uint64_t hash_combine(uint64_t hash, uint64_t value) {
+    return (hash ^ value) * UINT64_C(0x100000001b3);
+}
+
+uint64_t expr_hash(Context *ctx, const Expr *expr) {
+    uint64_t hash = hash_combine(UINT64_C(0xcbf29ce484222325), expr->tag);
+
+    switch (expr->tag) {
+      case EXPR_TYPE:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_NAT:
+        return hash;
+
+      case EXPR_IDENT:
+        return hash_combine(hash, (uintptr_t)expr->ident);
+
+      case EXPR_GLOBAL:
+        return hash_combine(hash, expr->global);
+
+      case EXPR_FORALL:
+        for (size_t i = 0; i < expr->forall.num_params; i++) {
+            hash = hash_combine(hash,
+                expr_hash(ctx, &expr->forall.param_types[i]));
+            hash = hash_combine(hash, (uintptr_t)expr->forall.param_names[i]);
+        }
+        return hash_combine(hash, expr_hash(ctx, expr->forall.ret_type));
+
+      case EXPR_LAMBDA:
+        for (size_t i = 0; i < expr->lambda.num_params; i++) {
+            hash = hash_combine(hash,
+                expr_hash(ctx, &expr->lambda.param_types[i]));
+            hash = hash_combine(hash, (uintptr_t)expr->lambda.param_names[i]);
+        }
+        return hash_combine(hash, expr_hash(ctx, expr->lambda.body));
+
+      case EXPR_CALL:
+        hash = hash_combine(hash, expr_hash(ctx, expr->call.func));
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            hash = hash_combine(hash, expr_hash(ctx, &expr->call.args[i]));
+        }
+        return hash;
+
+      case EXPR_ID:
+        hash = hash_combine(hash, expr_hash(ctx, expr->id.expr1));
+        return hash_combine(hash, expr_hash(ctx, expr->id.expr2));
+
+      case EXPR_REFLEXIVE:
+        return hash_combine(hash, expr_hash(ctx, expr->reflexive));
+
+      case EXPR_SUBSTITUTE:
+        hash = hash_combine(hash, expr_hash(ctx, expr->substitute.proof));
+        hash = hash_combine(hash, expr_hash(ctx, expr->substitute.family));
+        return hash_combine(hash, expr_hash(ctx, expr->substitute.instance));
+
+      case EXPR_EXPLODE:
+        hash = hash_combine(hash, expr_hash(ctx, expr->explode.void_instance));
+        return hash_combine(hash, expr_hash(ctx, expr->explode.into_type));
+
+      case EXPR_BOOLEAN:
+        return hash_combine(hash, expr->boolean);
+
+      case EXPR_IFTHENELSE:
+        hash = hash_combine(hash, expr_hash(ctx, expr->ifthenelse.predicate));
+        hash = hash_combine(hash, expr_hash(ctx, expr->ifthenelse.then_));
+        return hash_combine(hash, expr_hash(ctx, expr->ifthenelse.else_));
+
+      case EXPR_NATURAL:
+        return hash_combine(hash, natural_hash(&expr->natural));
+
+      case EXPR_NAT_IND:
+        hash = hash_combine(hash, expr_hash(ctx, expr->nat_ind.natural));
+        hash = hash_combine(hash, expr->nat_ind.goes_down);
+        hash = hash_combine(hash, expr_hash(ctx, expr->nat_ind.base_val));
+        hash = hash_combine(hash, (uintptr_t)expr->nat_ind.ind_name);
+        return hash_combine(hash, expr_hash(ctx, expr->nat_ind.ind_val));
+
+      case EXPR_SIGMA:
+        hash = hash_combine(hash, expr->sigma.layout);
+        for (size_t i = 0; i < expr->sigma.num_fields; i++) {
+            hash = hash_combine(hash, (uintptr_t)expr->sigma.field_names[i]);
+            hash = hash_combine(hash,
+                expr_hash(ctx, &expr->sigma.field_types[i]));
+        }
+        return hash;
+
+      case EXPR_PACK:
+        if (expr->pack.as_type != NULL) {
+            hash = hash_combine(hash, expr_hash(ctx, expr->pack.as_type));
+        }
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            hash = hash_combine(hash,
+                expr_hash(ctx, &expr->pack.field_values[i]));
+        }
+        return hash;
+
+      case EXPR_ACCESS:
+        hash = hash_combine(hash, expr_hash(ctx, expr->access.record));
+        return hash_combine(hash, expr->access.field_num);
+    }
+
+    return hash;
+}
+
+size_t expr_size(Context *ctx, const Expr *expr) {
+    size_t size = 1;
+
+    switch (expr->tag) {
+      case EXPR_IDENT:
+      case EXPR_GLOBAL:
+      case EXPR_TYPE:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_BOOLEAN:
+      case EXPR_NAT:
+      case EXPR_NATURAL:
+        break;
+
+      case EXPR_FORALL:
+        for (size_t i = 0; i < expr->forall.num_params; i++) {
+            size += expr_size(ctx, &expr->forall.param_types[i]);
+        }
+        size += expr_size(ctx, expr->forall.ret_type);
+        break;
+
+      case EXPR_LAMBDA:
+        for (size_t i = 0; i < expr->lambda.num_params; i++) {
+            size += expr_size(ctx, &expr->lambda.param_types[i]);
+        }
+        size += expr_size(ctx, expr->lambda.body);
+        break;
+
+      case EXPR_CALL:
+        size += expr_size(ctx, expr->call.func);
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            size += expr_size(ctx, &expr->call.args[i]);
+        }
+        break;
+
+      case EXPR_ID:
+        size += expr_size(ctx, expr->id.expr1);
+        size += expr_size(ctx, expr->id.expr2);
+        break;
+
+      case EXPR_REFLEXIVE:
+        size += expr_size(ctx, expr->reflexive);
+        break;
+
+      case EXPR_SUBSTITUTE:
+        size += expr_size(ctx, expr->substitute.proof);
+        size += expr_size(ctx, expr->substitute.family);
+        size += expr_size(ctx, expr->substitute.instance);
+        break;
+
+      case EXPR_EXPLODE:
+        size += expr_size(ctx, expr->explode.void_instance);
+        size += expr_size(ctx, expr->explode.into_type);
+        break;
+
+      case EXPR_IFTHENELSE:
+        size += expr_size(ctx, expr->ifthenelse.predicate);
+        size += expr_size(ctx, expr->ifthenelse.then_);
+        size += expr_size(ctx, expr->ifthenelse.else_);
+        break;
+
+      case EXPR_NAT_IND:
+        size += expr_size(ctx, expr->nat_ind.natural);
+        size += expr_size(ctx, expr->nat_ind.base_val);
+        size += expr_size(ctx, expr->nat_ind.ind_val);
+        break;
+
+      case EXPR_SIGMA:
+        for (size_t i = 0; i < expr->sigma.num_fields; i++) {
+            size += expr_size(ctx, &expr->sigma.field_types[i]);
+        }
+        break;
+
+      case EXPR_PACK:
+        if (expr->pack.as_type != NULL) {
+            size += expr_size(ctx, expr->pack.as_type);
+        }
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            size += expr_size(ctx, &expr->pack.field_values[i]);
+        }
+        break;
+
+      case EXPR_ACCESS:
+        size += expr_size(ctx, expr->access.record);
+        break;
+    }
+
+    return size;
+}
+
 Expr expr_copy(Context *ctx, const Expr *x) {
-    Expr y = {.location = x->location, .tag = x->tag};
+    Expr y = {
+          .location = x->location
+        , .tag = x->tag
+        , .well_typed = x->well_typed
+    };
 
     switch (x->tag) {
       case EXPR_TYPE:
@@ -144,6 +346,10 @@ Expr expr_copy(Context *ctx, const Expr *x) {
         y.ident = x->ident;
         break;
 
+      case EXPR_GLOBAL:
+        y.global = x->global;
+        break;
+
       case EXPR_FORALL:
         y.forall.num_params = x->forall.num_params;
         alloc_array(y.forall.param_types, y.forall.num_params);
@@ -207,7 +413,7 @@ Expr expr_copy(Context *ctx, const Expr *x) {
         break;
 
       case EXPR_NATURAL:
-        y.natural = x->natural;
+        y.natural = natural_copy(&x->natural);
         break;
 
       case EXPR_NAT_IND:
@@ -220,6 +426,7 @@ Expr expr_copy(Context *ctx, const Expr *x) {
 
       case EXPR_SIGMA:
         y.sigma.num_fields = x->sigma.num_fields;
+        y.sigma.layout = x->sigma.layout;
         alloc_array(y.sigma.field_names, y.sigma.num_fields);
         alloc_array(y.sigma.field_types, y.sigma.num_fields);
         for (size_t i = 0; i < y.sigma.num_fields; i++) {
@@ -250,10 +457,99 @@ Expr expr_copy(Context *ctx, const Expr *x) {
     return y;
 }
 
+void expr_mark_well_typed(Context *ctx, Expr *expr) {
+    expr->well_typed = true;
+
+    switch (expr->tag) {
+      case EXPR_IDENT:
+      case EXPR_GLOBAL:
+      case EXPR_TYPE:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_BOOLEAN:
+      case EXPR_NAT:
+      case EXPR_NATURAL:
+        break;
+
+      case EXPR_FORALL:
+        for (size_t i = 0; i < expr->forall.num_params; i++) {
+            expr_mark_well_typed(ctx, &expr->forall.param_types[i]);
+        }
+        expr_mark_well_typed(ctx, expr->forall.ret_type);
+        break;
+
+      case EXPR_LAMBDA:
+        for (size_t i = 0; i < expr->lambda.num_params; i++) {
+            expr_mark_well_typed(ctx, &expr->lambda.param_types[i]);
+        }
+        expr_mark_well_typed(ctx, expr->lambda.body);
+        break;
+
+      case EXPR_CALL:
+        expr_mark_well_typed(ctx, expr->call.func);
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            expr_mark_well_typed(ctx, &expr->call.args[i]);
+        }
+        break;
+
+      case EXPR_ID:
+        expr_mark_well_typed(ctx, expr->id.expr1);
+        expr_mark_well_typed(ctx, expr->id.expr2);
+        break;
+
+      case EXPR_REFLEXIVE:
+        expr_mark_well_typed(ctx, expr->reflexive);
+        break;
+
+      case EXPR_SUBSTITUTE:
+        expr_mark_well_typed(ctx, expr->substitute.proof);
+        expr_mark_well_typed(ctx, expr->substitute.family);
+        expr_mark_well_typed(ctx, expr->substitute.instance);
+        break;
+
+      case EXPR_EXPLODE:
+        expr_mark_well_typed(ctx, expr->explode.void_instance);
+        expr_mark_well_typed(ctx, expr->explode.into_type);
+        break;
+
+      case EXPR_IFTHENELSE:
+        expr_mark_well_typed(ctx, expr->ifthenelse.predicate);
+        expr_mark_well_typed(ctx, expr->ifthenelse.then_);
+        expr_mark_well_typed(ctx, expr->ifthenelse.else_);
+        break;
+
+      case EXPR_NAT_IND:
+        expr_mark_well_typed(ctx, expr->nat_ind.natural);
+        expr_mark_well_typed(ctx, expr->nat_ind.base_val);
+        expr_mark_well_typed(ctx, expr->nat_ind.ind_val);
+        break;
+
+      case EXPR_SIGMA:
+        for (size_t i = 0; i < expr->sigma.num_fields; i++) {
+            expr_mark_well_typed(ctx, &expr->sigma.field_types[i]);
+        }
+        break;
+
+      case EXPR_PACK:
+        if (expr->pack.as_type != NULL) {
+            expr_mark_well_typed(ctx, expr->pack.as_type);
+        }
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            expr_mark_well_typed(ctx, &expr->pack.field_values[i]);
+        }
+        break;
+
+      case EXPR_ACCESS:
+        expr_mark_well_typed(ctx, expr->access.record);
+        break;
+    }
+}
+
 void expr_free_vars(Context *ctx, const Expr *expr, SymbolSet *free_vars) {
     SymbolSet free_vars_temp[1];
 
     switch (expr->tag) {
+      case EXPR_GLOBAL:
       case EXPR_TYPE:
       case EXPR_VOID:
       case EXPR_BOOL:
@@ -382,126 +678,100 @@ void expr_free_vars(Context *ctx, const Expr *expr, SymbolSet *free_vars) {
     }
 }
 
-static void expr_forall_subst(Context *ctx, Expr *expr,
-        const char *name, const Expr *replacement) {
-    assert(expr->tag == EXPR_FORALL);
-
-    SymbolSet free_vars;
-    expr_free_vars(ctx, replacement, &free_vars);
-
-    for (size_t i = 0; i < expr->forall.num_params; i++) {
-        expr_subst(ctx, &expr->forall.param_types[i], name, replacement);
-        const char *old_param_name = expr->forall.param_names[i];
-
-        if (old_param_name != NULL) {
-            if (old_param_name == name) {
-                symbol_set_free(&free_vars);
-                return;
-            }
-
-            if (symbol_set_contains(&free_vars, old_param_name)) {
-                const char *new_param_name = symbol_gensym(&ctx->interns,
-                    old_param_name);
-                const Expr new_replacement = {
-                      .tag = EXPR_IDENT
-                    , .ident = new_param_name
-                };
-                expr->forall.param_names[i] = new_param_name;
-
-                for (size_t j = i + 1; j < expr->forall.num_params; j++) {
-                    expr_subst(ctx, &expr->forall.param_types[i],
-                        old_param_name, &new_replacement);
-                }
-                expr_subst(ctx, expr->forall.ret_type,
-                    old_param_name, &new_replacement);
-            }
-        }
+/* A simultaneous substitution of names for expressions. Entries are removed
+ * when a binder shadows them, and added when a binder has to be renamed to
+ * avoid capturing a free variable of one of the replacements.
+ */
+typedef struct {
+    size_t num;
+    const char **names;
+    const Expr **replacements;
+
+    // Identifiers for renamed binders, owned by the substitution.
+    size_t num_renames;
+    Expr **renames;
+} Subst;
+
+static Subst subst_copy(const Subst *subst) {
+    Subst copy = {
+          .num = subst->num
+        , .num_renames = 0
+        , .renames = NULL
+    };
+
+    alloc_array(copy.names, copy.num);
+    alloc_array(copy.replacements, copy.num);
+    for (size_t i = 0; i < copy.num; i++) {
+        copy.names[i] = subst->names[i];
+        copy.replacements[i] = subst->replacements[i];
     }
 
-    expr_subst(ctx, expr->forall.ret_type, name, replacement);
-
-    symbol_set_free(&free_vars);
+    return copy;
 }
 
-static void expr_lambda_subst(Context *ctx, Expr *expr,
-        const char *name, const Expr *replacement) {
-    assert(expr->tag == EXPR_LAMBDA);
-
-    SymbolSet free_vars[1];
-    expr_free_vars(ctx, replacement, free_vars);
-
-    for (size_t i = 0; i < expr->lambda.num_params; i++) {
-        expr_subst(ctx, &expr->lambda.param_types[i], name, replacement);
-        const char *old_param_name = expr->lambda.param_names[i];
-
-        if (old_param_name == name) {
-            symbol_set_free(free_vars);
-            return;
-        }
-
-        if (symbol_set_contains(free_vars, old_param_name)) {
-            const char *new_param_name = symbol_gensym(&ctx->interns,
-                old_param_name);
-            const Expr new_replacement = {
-                  .tag = EXPR_IDENT
-                , .ident = new_param_name
-            };
-            expr->lambda.param_names[i] = new_param_name;
-
-            for (size_t j = i + 1; j < expr->forall.num_params; j++) {
-                expr_subst(ctx, &expr->lambda.param_types[i],
-                    old_param_name, &new_replacement);
-            }
-            expr_subst(ctx, expr->lambda.body,
-                old_param_name, &new_replacement);
-        }
+static void subst_free(Subst *subst) {
+    for (size_t i = 0; i < subst->num_renames; i++) {
+        dealloc(subst->renames[i]);
     }
-
-    expr_subst(ctx, expr->lambda.body, name, replacement);
-
-    symbol_set_free(free_vars);
+    dealloc(subst->renames);
+    dealloc(subst->names);
+    dealloc(subst->replacements);
+    memset(subst, 0, sizeof *subst);
 }
 
-static void expr_sigma_subst(Context *ctx, Expr *expr,
-        const char *name, const Expr *replacement) {
-    assert(expr->tag == EXPR_SIGMA);
-
-    SymbolSet free_vars;
-    expr_free_vars(ctx, replacement, &free_vars);
-
-    for (size_t i = 0; i < expr->sigma.num_fields; i++) {
-        expr_subst(ctx, &expr->sigma.field_types[i], name, replacement);
-        const char *old_field_name = expr->sigma.field_names[i];
+/* Bring a binder into scope, returning the (possibly fresh) name it should
+ * be given.
+ */
+static const char *subst_bind(Context *ctx, Subst *subst,
+        const SymbolSet *free_vars, const char *binder) {
+    if (binder == NULL) {
+        return NULL;
+    }
 
-        if (old_field_name == name) {
-            symbol_set_free(&free_vars);
-            return;
+    for (size_t i = 0; i < subst->num; i++) {
+        if (subst->names[i] == binder) {
+            subst->num -= 1;
+            subst->names[i] = subst->names[subst->num];
+            subst->replacements[i] = subst->replacements[subst->num];
+            break;
         }
+    }
 
-        if (symbol_set_contains(&free_vars, old_field_name)) {
-            const char *new_field_name = symbol_gensym(&ctx->interns,
-                old_field_name);
-            const Expr new_replacement = {
-                  .tag = EXPR_IDENT
-                , .ident = new_field_name
-            };
-            expr->sigma.field_names[i] = new_field_name;
-
-            for (size_t j = i + 1; j < expr->sigma.num_fields; j++) {
-                expr_subst(ctx, &expr->sigma.field_types[i],
-                    old_field_name, &new_replacement);
-            }
-        }
+    if (subst->num == 0 || !symbol_set_contains(free_vars, binder)) {
+        return binder;
     }
 
-    symbol_set_free(&free_vars);
+    const char *new_binder = symbol_fresh(&ctx->fresh, binder);
+    Expr *rename;
+    alloc_assign(rename, ((Expr){
+          .tag = EXPR_IDENT
+        , .well_typed = true
+        , .ident = new_binder
+    }));
+
+    realloc_array(subst->renames, subst->num_renames + 1);
+    subst->renames[subst->num_renames] = rename;
+    subst->num_renames += 1;
+
+    realloc_array(subst->names, subst->num + 1);
+    realloc_array(subst->replacements, subst->num + 1);
+    subst->names[subst->num] = binder;
+    subst->replacements[subst->num] = rename;
+    subst->num += 1;
+
+    return new_binder;
 }
 
-void expr_subst(Context *ctx, Expr *expr,
-        const char *name, const Expr *replacement) {
-    SymbolSet free_vars;
+static void expr_subst_(Context *ctx, Expr *expr,
+        const Subst *subst, const SymbolSet *free_vars) {
+    Subst inner;
+
+    if (subst->num == 0) {
+        return;
+    }
 
     switch (expr->tag) {
+      case EXPR_GLOBAL:
       case EXPR_TYPE:
       case EXPR_VOID:
       case EXPR_BOOL:
@@ -511,101 +781,152 @@ void expr_subst(Context *ctx, Expr *expr,
         break;
 
       case EXPR_IDENT:
-        if (name == expr->ident) {
-            expr_free(ctx, expr);
-            *expr = expr_copy(ctx, replacement);
+        for (size_t i = 0; i < subst->num; i++) {
+            if (subst->names[i] == expr->ident) {
+                *expr = expr_copy(ctx, subst->replacements[i]);
+                break;
+            }
         }
         break;
 
       case EXPR_FORALL:
-        expr_forall_subst(ctx, expr, name, replacement);
+        inner = subst_copy(subst);
+        for (size_t i = 0; i < expr->forall.num_params; i++) {
+            expr_subst_(ctx, &expr->forall.param_types[i], &inner, free_vars);
+            expr->forall.param_names[i] = subst_bind(ctx, &inner, free_vars,
+                expr->forall.param_names[i]);
+        }
+        expr_subst_(ctx, expr->forall.ret_type, &inner, free_vars);
+        subst_free(&inner);
         break;
 
       case EXPR_LAMBDA:
-        expr_lambda_subst(ctx, expr, name, replacement);
+        inner = subst_copy(subst);
+        for (size_t i = 0; i < expr->lambda.num_params; i++) {
+            expr_subst_(ctx, &expr->lambda.param_types[i], &inner, free_vars);
+            expr->lambda.param_names[i] = subst_bind(ctx, &inner, free_vars,
+                expr->lambda.param_names[i]);
+        }
+        expr_subst_(ctx, expr->lambda.body, &inner, free_vars);
+        subst_free(&inner);
         break;
 
       case EXPR_CALL:
-        expr_subst(ctx, expr->call.func, name, replacement);
+        expr_subst_(ctx, expr->call.func, subst, free_vars);
         for (size_t i = 0; i < expr->call.num_args; i++) {
-            expr_subst(ctx, &expr->call.args[i], name, replacement);
+            expr_subst_(ctx, &expr->call.args[i], subst, free_vars);
         }
         break;
 
       case EXPR_ID:
-        expr_subst(ctx, expr->id.expr1, name, replacement);
-        expr_subst(ctx, expr->id.expr2, name, replacement);
+        expr_subst_(ctx, expr->id.expr1, subst, free_vars);
+        expr_subst_(ctx, expr->id.expr2, subst, free_vars);
         break;
 
       case EXPR_REFLEXIVE:
-        expr_subst(ctx, expr->reflexive, name, replacement);
+        expr_subst_(ctx, expr->reflexive, subst, free_vars);
         break;
 
       case EXPR_SUBSTITUTE:
-        expr_subst(ctx, expr->substitute.proof, name, replacement);
-        expr_subst(ctx, expr->substitute.family, name, replacement);
-        expr_subst(ctx, expr->substitute.instance, name, replacement);
+        expr_subst_(ctx, expr->substitute.proof, subst, free_vars);
+        expr_subst_(ctx, expr->substitute.family, subst, free_vars);
+        expr_subst_(ctx, expr->substitute.instance, subst, free_vars);
         break;
 
       case EXPR_EXPLODE:
-        expr_subst(ctx, expr->explode.void_instance, name, replacement);
-        expr_subst(ctx, expr->explode.into_type, name, replacement);
+        expr_subst_(ctx, expr->explode.void_instance, subst, free_vars);
+        expr_subst_(ctx, expr->explode.into_type, subst, free_vars);
         break;
 
       case EXPR_IFTHENELSE:
-        expr_subst(ctx, expr->ifthenelse.predicate, name, replacement);
-        expr_subst(ctx, expr->ifthenelse.then_, name, replacement);
-        expr_subst(ctx, expr->ifthenelse.else_, name, replacement);
+        expr_subst_(ctx, expr->ifthenelse.predicate, subst, free_vars);
+        expr_subst_(ctx, expr->ifthenelse.then_, subst, free_vars);
+        expr_subst_(ctx, expr->ifthenelse.else_, subst, free_vars);
         break;
 
       case EXPR_NAT_IND:
-        expr_subst(ctx, expr->nat_ind.natural, name, replacement);
-        expr_subst(ctx, expr->nat_ind.base_val, name, replacement);
-        expr_free_vars(ctx, replacement, &free_vars);
-        if (symbol_set_contains(&free_vars, expr->nat_ind.ind_name)) {
-            const char *new_ind_name = symbol_gensym(&ctx->interns,
-                expr->nat_ind.ind_name);
-            const Expr new_replacement = {
-                  .tag = EXPR_IDENT
-                , .ident = new_ind_name
-            };
-            expr->nat_ind.ind_name = new_ind_name;
-            expr_subst(ctx, expr->nat_ind.ind_val,
-                expr->nat_ind.ind_name, &new_replacement);
-        }
-        symbol_set_free(&free_vars);
-        expr_subst(ctx, expr->nat_ind.ind_val, name, replacement);
+        expr_subst_(ctx, expr->nat_ind.natural, subst, free_vars);
+        expr_subst_(ctx, expr->nat_ind.base_val, subst, free_vars);
+        inner = subst_copy(subst);
+        expr->nat_ind.ind_name = subst_bind(ctx, &inner, free_vars,
+            expr->nat_ind.ind_name);
+        expr_subst_(ctx, expr->nat_ind.ind_val, &inner, free_vars);
+        subst_free(&inner);
         break;
 
       case EXPR_SIGMA:
-        expr_sigma_subst(ctx, expr, name, replacement);
+        inner = subst_copy(subst);
+        for (size_t i = 0; i < expr->sigma.num_fields; i++) {
+            expr_subst_(ctx, &expr->sigma.field_types[i], &inner, free_vars);
+            expr->sigma.field_names[i] = subst_bind(ctx, &inner, free_vars,
+                expr->sigma.field_names[i]);
+        }
+        subst_free(&inner);
         break;
 
       case EXPR_PACK:
         if (expr->pack.as_type != NULL) {
-            expr_subst(ctx, expr->pack.as_type, name, replacement);
+            expr_subst_(ctx, expr->pack.as_type, subst, free_vars);
         }
         for (size_t i = 0; i < expr->pack.num_fields; i++) {
-            expr_subst(ctx, &expr->pack.field_values[i], name, replacement);
+            expr_subst_(ctx, &expr->pack.field_values[i], subst, free_vars);
         }
         break;
 
       case EXPR_ACCESS:
-        expr_subst(ctx, expr->access.record, name, replacement);
+        expr_subst_(ctx, expr->access.record, subst, free_vars);
         break;
     }
 }
 
+void expr_subst_many(Context *ctx, Expr *expr, size_t num,
+        const char *const *names, const Expr *replacements) {
+    Subst subst = {
+          .num = 0
+        , .num_renames = 0
+        , .renames = NULL
+    };
+    SymbolSet free_vars = symbol_set_empty();
+
+    alloc_array(subst.names, num);
+    alloc_array(subst.replacements, num);
+    for (size_t i = 0; i < num; i++) {
+        if (names[i] != NULL) {
+            subst.names[subst.num] = names[i];
+            subst.replacements[subst.num] = &replacements[i];
+            subst.num += 1;
+
+            SymbolSet replacement_free_vars;
+            expr_free_vars(ctx, &replacements[i], &replacement_free_vars);
+            symbol_set_union(&free_vars, &replacement_free_vars);
+        }
+    }
+
+    expr_subst_(ctx, expr, &subst, &free_vars);
+
+    symbol_set_free(&free_vars);
+    subst_free(&subst);
+}
+
+void expr_subst(Context *ctx, Expr *expr,
+        const char *name, const Expr *replacement) {
+    expr_subst_many(ctx, expr, 1, &name, replacement);
+}
+
 /***** Freeing ast nodes *****************************************************/
 void expr_free(Context *ctx, Expr *expr) {
     switch (expr->tag) {
       case EXPR_IDENT:
+      case EXPR_GLOBAL:
       case EXPR_TYPE:
       case EXPR_VOID:
       case EXPR_BOOL:
       case EXPR_BOOLEAN:
       case EXPR_NAT:
+        break;
+
       case EXPR_NATURAL:
+        natural_free(&expr->natural);
         break;
 
       case EXPR_FORALL:
@@ -727,6 +1048,30 @@ void translation_unit_free(Context *ctx, TranslationUnit *unit) {
     memset(unit, 0, sizeof *unit);
 }
 
+/***** Sigma Layouts *********************************************************/
+static const char *const sigma_layout_names[] = {
+      [SIGMA_LAYOUT_DERIVED] = "derived"
+    , [SIGMA_LAYOUT_TAGGED] = "tagged"
+    , [SIGMA_LAYOUT_NICHE] = "niche"
+    , [SIGMA_LAYOUT_PACKED] = "packed"
+};
+
+const char *sigma_layout_name(SigmaLayout layout) {
+    return sigma_layout_names[layout];
+}
+
+bool sigma_layout_parse(const char *name, SigmaLayout *result) {
+    size_t num_layouts =
+        sizeof sigma_layout_names / sizeof sigma_layout_names[0];
+    for (size_t i = 0; i < num_layouts; i++) {
+        if (strcmp(sigma_layout_names[i], name) == 0) {
+            *result = (SigmaLayout)i;
+            return true;
+        }
+    }
+    return false;
+}
+
 /***** Pretty-printing ast nodes *********************************************/
 static void indent_pprint(FILE *to, unsigned indent) {
     for (unsigned i = 0; i < indent; i++) {
@@ -735,13 +1080,16 @@ static void indent_pprint(FILE *to, unsigned indent) {
 }
 
 void location_pprint(Context *ctx, const char *file, const LocationInfo *info) {
+    if (ctx->quiet > 0) {
+        return;
+    }
     fprintf(stderr, "    At file %s, line %u, column %u.\n",
         file, info->line, info->column);
 }
 
 static void expr_pprint_(Context *ctx, FILE *to, unsigned indent,
         const Expr *expr) {
-    bool simple = expr->tag == EXPR_IDENT
+    bool simple = expr->tag == EXPR_IDENT || expr->tag == EXPR_GLOBAL
             || expr->tag == EXPR_TYPE
             || expr->tag == EXPR_VOID
             || expr->tag == EXPR_BOOL || expr->tag == EXPR_BOOLEAN
@@ -789,7 +1137,11 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
         break;
 
       case EXPR_IDENT:
-        fprintf(to, "%s", expr->ident);
+        fprintf(to, "%s", symbol_name(expr->ident));
+        break;
+
+      case EXPR_GLOBAL:
+        fprintf(to, "%s", ctx->symbol_table.global_names[expr->global]);
         break;
 
       case EXPR_FORALL:
@@ -799,7 +1151,7 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
                 fprintf(to, ", ");
             }
             if (expr->forall.param_names[i] != NULL) {
-                fprintf(to, "%s ", expr->forall.param_names[i]);
+                fprintf(to, "%s ", symbol_name(expr->forall.param_names[i]));
                 if (ctx->color_enabled) {
                     fprintf(to, RED ":" NORMAL " ");
                 } else {
@@ -827,7 +1179,7 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
             if (i > 0) {
                 fprintf(to, ", ");
             }
-            fprintf(to, "%s ", expr->lambda.param_names[i]);
+            fprintf(to, "%s ", symbol_name(expr->lambda.param_names[i]));
             if (ctx->color_enabled) {
                 fprintf(to, RED ":" NORMAL " ");
             } else {
@@ -909,11 +1261,9 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
         break;
 
       case EXPR_NATURAL:
-        if (ctx->color_enabled) {
-            fprintf(to, CYAN "%" PRIu64 NORMAL, expr->natural);
-        } else {
-            fprintf(to, "%" PRIu64, expr->natural);
-        }
+        fputs(ctx->color_enabled ? CYAN : "", to);
+        natural_fprint(to, &expr->natural);
+        fputs(ctx->color_enabled ? NORMAL : "", to);
         break;
 
       case EXPR_NAT_IND:
@@ -927,7 +1277,8 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
             expr_pprint(ctx, to, indent + 1, expr->nat_ind.base_val);
             putc('\n', to); indent_pprint(to, indent + 1);
             fprintf(to, "| %s %c " CYAN "1" NORMAL " " RED "=>" NORMAL " ",
-                expr->nat_ind.ind_name, expr->nat_ind.goes_down ? '+' : '-');
+                symbol_name(expr->nat_ind.ind_name),
+                expr->nat_ind.goes_down ? '+' : '-');
             expr_pprint(ctx, to, indent + 1, expr->nat_ind.ind_val);
         } else {
             fprintf(to, "case ");
@@ -939,7 +1290,8 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
             expr_pprint(ctx, to, indent + 1, expr->nat_ind.base_val);
             putc('\n', to); indent_pprint(to, indent + 1);
             fprintf(to, "| %s %c 1 => ",
-                expr->nat_ind.ind_name, expr->nat_ind.goes_down ? '+' : '-');
+                symbol_name(expr->nat_ind.ind_name),
+                expr->nat_ind.goes_down ? '+' : '-');
             expr_pprint(ctx, to, indent + 1, expr->nat_ind.ind_val);
        }
         break;
@@ -951,7 +1303,7 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
                 fprintf(to, ", ");
             }
             if (expr->sigma.field_names[i] != NULL) {
-                fprintf(to, "%s ", expr->sigma.field_names[i]);
+                fprintf(to, "%s ", symbol_name(expr->sigma.field_names[i]));
                 if (ctx->color_enabled) {
                     fprintf(to, RED ":" NORMAL " ");
                 } else {
@@ -961,6 +1313,9 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
             expr_pprint(ctx, to, indent, &expr->sigma.field_types[i]);
         }
         putc('}', to);
+        if (expr->sigma.layout != SIGMA_LAYOUT_DERIVED) {
+            fprintf(to, " layout(%s)", sigma_layout_name(expr->sigma.layout));
+        }
         break;
 
       case EXPR_PACK:
@@ -1001,6 +1356,9 @@ void expr_pprint(Context *ctx, FILE *to, unsigned indent, const Expr *expr) {
 void top_level_pprint(Context *ctx, FILE *to, const TopLevel *top_level) {
     switch (top_level->tag) {
        case TOP_LEVEL_EXPR_DECL:
+        if (top_level->opaque) {
+            fprintf(to, "opaque ");
+        }
         if (ctx->color_enabled) {
             efprintf(ctx, to, "%s " RED ":" NORMAL " $e\n"
                 "%s " RED "=" NORMAL " $e\n",
@@ -1030,6 +1388,10 @@ void translation_unit_pprint(Context *ctx, FILE *to,
 
 void efprintf(Context *ctx, FILE *file,
         const char *format, const void *eargs[], ...) {
+    if (file == stderr && ctx->quiet > 0) {
+        return;
+    }
+
     va_list vargs;
     va_start(vargs, eargs);
 
@@ -0,0 +1,185 @@
+#include <assert.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Registry **************************************************************/
+
+// At run time naturals are the uint64_t they are stored as, and a result
+// which does not fit fails rather than wrapping around. Subtraction stops at
+// 0 and division by 0 gives 0, as they do during type checking.
+static bool builtin_run_add(const uint64_t *args, uint64_t *result) {
+    *result = args[0] + args[1];
+    return *result >= args[0];
+}
+
+static bool builtin_run_sub(const uint64_t *args, uint64_t *result) {
+    *result = args[0] > args[1] ? args[0] - args[1] : 0;
+    return true;
+}
+
+static bool builtin_run_mul(const uint64_t *args, uint64_t *result) {
+    *result = args[0] * args[1];
+    return args[1] == 0 || args[0] <= UINT64_MAX / args[1];
+}
+
+static bool builtin_run_div(const uint64_t *args, uint64_t *result) {
+    *result = args[1] == 0 ? 0 : args[0] / args[1];
+    return true;
+}
+
+static bool builtin_run_mod(const uint64_t *args, uint64_t *result) {
+    *result = args[1] == 0 ? 0 : args[0] % args[1];
+    return true;
+}
+
+static bool builtin_run_eq(const uint64_t *args, uint64_t *result) {
+    *result = args[0] == args[1];
+    return true;
+}
+
+static bool builtin_run_lt(const uint64_t *args, uint64_t *result) {
+    *result = args[0] < args[1];
+    return true;
+}
+
+static bool builtin_run_le(const uint64_t *args, uint64_t *result) {
+    *result = args[0] <= args[1];
+    return true;
+}
+
+// During type checking they are exact.
+static Natural builtin_eval_add(const Natural *args) {
+    return natural_add(&args[0], &args[1]);
+}
+
+static Natural builtin_eval_sub(const Natural *args) {
+    return natural_sub(&args[0], &args[1]);
+}
+
+static Natural builtin_eval_mul(const Natural *args) {
+    return natural_mul(&args[0], &args[1]);
+}
+
+static Natural builtin_eval_div(const Natural *args) {
+    return natural_div(&args[0], &args[1]);
+}
+
+static Natural builtin_eval_mod(const Natural *args) {
+    return natural_mod(&args[0], &args[1]);
+}
+
+static Natural builtin_eval_eq(const Natural *args) {
+    return natural_small(natural_equal(&args[0], &args[1]));
+}
+
+static Natural builtin_eval_lt(const Natural *args) {
+    return natural_small(natural_compare(&args[0], &args[1]) < 0);
+}
+
+static Natural builtin_eval_le(const Natural *args) {
+    return natural_small(natural_compare(&args[0], &args[1]) <= 0);
+}
+
+#define BUILTIN(name, ret_type, op, may_overflow, c_body) \
+    {"nat_" #name, 2, ret_type, may_overflow, builtin_eval_##op, \
+        builtin_run_##op, c_body}
+
+static const Builtin builtins[] = {
+      BUILTIN(add, EXPR_NAT, add, true,
+        "x + y < x ? (dc_overflow(), 0) : x + y")
+    , BUILTIN(sub, EXPR_NAT, sub, false, "x > y ? x - y : 0")
+    , BUILTIN(mul, EXPR_NAT, mul, true,
+        "y != 0 && x > UINT64_MAX / y ? (dc_overflow(), 0) : x * y")
+    , BUILTIN(div, EXPR_NAT, div, false, "y == 0 ? 0 : x / y")
+    , BUILTIN(mod, EXPR_NAT, mod, false, "y == 0 ? 0 : x % y")
+    , BUILTIN(eq, EXPR_BOOL, eq, false, "x == y")
+    , BUILTIN(lt, EXPR_BOOL, lt, false, "x < y")
+    , BUILTIN(le, EXPR_BOOL, le, false, "x <= y")
+};
+
+#define NUM_BUILTINS (sizeof builtins / sizeof builtins[0])
+
+void builtin_register_all(Context *ctx) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    assert(symbols->num_globals == 0);
+    const char *param_names[] = {"x", "y"};
+
+    for (size_t i = 0; i < NUM_BUILTINS; i++) {
+        const Builtin *builtin = &builtins[i];
+        assert(builtin->num_params <= 2);
+
+        Expr type = {
+              .tag = EXPR_FORALL
+            , .well_typed = true
+            , .forall.num_params = builtin->num_params
+        };
+        alloc_array(type.forall.param_types, builtin->num_params);
+        alloc_array(type.forall.param_names, builtin->num_params);
+        for (size_t j = 0; j < builtin->num_params; j++) {
+            type.forall.param_types[j] = literal_expr_nat;
+            type.forall.param_names[j] =
+                symbol_intern(&ctx->interns, param_names[j]);
+        }
+        alloc_assign(type.forall.ret_type, builtin->ret_type == EXPR_BOOL
+            ? literal_expr_bool : literal_expr_nat);
+
+        symbol_table_register_global(symbols,
+            symbol_intern(&ctx->interns, builtin->name), type);
+    }
+    symbols->num_builtins = NUM_BUILTINS;
+}
+
+const Builtin *builtin_lookup(const SymbolTable *symbols, size_t global) {
+    return global < symbols->num_builtins ? &builtins[global] : NULL;
+}
+
+/***** Evaluation ************************************************************/
+
+bool builtin_eval_call(Context *ctx, const Builtin *builtin,
+        const Expr *call, Expr *result) {
+    assert(call->tag == EXPR_CALL);
+    assert(call->call.num_args == builtin->num_params);
+    Natural args[2];
+
+    for (size_t i = 0; i < builtin->num_params; i++) {
+        Expr arg;
+        if (!type_eval(ctx, &call->call.args[i], &arg)) {
+            for (size_t j = 0; j < i; j++) {
+                natural_free(&args[j]);
+            }
+            return false;
+        }
+
+        if (arg.tag != EXPR_NATURAL) {
+            efprintf(ctx, stderr, "Cannot evaluate builtin \"%s\" with "
+                "non-literal natural ($e).\n", ewrap(&arg), builtin->name);
+            expr_free(ctx, &arg);
+            for (size_t j = 0; j < i; j++) {
+                natural_free(&args[j]);
+            }
+            return false;
+        }
+        args[i] = arg.natural;
+    }
+
+    Natural value = builtin->eval(args);
+    for (size_t i = 0; i < builtin->num_params; i++) {
+        natural_free(&args[i]);
+    }
+    if (builtin->ret_type == EXPR_BOOL) {
+        *result = (Expr){
+              .tag = EXPR_BOOLEAN
+            , .well_typed = true
+            , .boolean = !natural_is(&value, 0)
+        };
+        natural_free(&value);
+    } else {
+        *result = (Expr){
+              .tag = EXPR_NATURAL
+            , .well_typed = true
+            , .natural = value
+        };
+    }
+    return true;
+}
@@ -0,0 +1,3574 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Output Buffers ********************************************************/
+
+typedef struct {
+    size_t len;
+    size_t cap;
+    char *data; // Always null terminated once anything has been written.
+} Buffer;
+
+static Buffer buffer_new(void) {
+    return (Buffer){
+          .len = 0
+        , .cap = 0
+        , .data = NULL
+    };
+}
+
+static void buffer_free(Buffer *buffer) {
+    dealloc(buffer->data);
+    memset(buffer, 0, sizeof *buffer);
+}
+
+static void buffer_vprintf(Buffer *buffer, const char *format, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = vsnprintf(NULL, 0, format, args_copy);
+    va_end(args_copy);
+    assert(len >= 0);
+
+    if (buffer->len + len + 1 > buffer->cap) {
+        buffer->cap = (buffer->len + len + 1) * 2;
+        realloc_array(buffer->data, buffer->cap);
+    }
+
+    vsnprintf(buffer->data + buffer->len, len + 1, format, args);
+    buffer->len += len;
+}
+
+static void buffer_printf(Buffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    buffer_vprintf(buffer, format, args);
+    va_end(args);
+}
+
+static const char *buffer_str(const Buffer *buffer) {
+    return buffer->len == 0 ? "" : buffer->data;
+}
+
+/***** Code Generation State *************************************************/
+
+typedef enum {
+      LOWER_OK     // Values are represented by a C type.
+    , LOWER_ERASED // Values carry no information at runtime.
+    , LOWER_FAILED // Values cannot be represented, which has been reported.
+} Lowering;
+
+/* How a field of a record is stored in the struct it is lowered to. */
+typedef struct {
+    const char *c_type; // The representation of the field's values, or NULL
+                        // if they are erased.
+    const char *member; // The type of the struct member, or NULL if there is
+                        // no member.
+    size_t slot;        // The member is f<slot>, counting only the fields
+                        // with members, so that erased fields such as proofs
+                        // leave the struct as if they were never written.
+
+    // A Bool field may be stored in a niche of the member of another field,
+    // the payload, whose value is the sentinel when no payload is present.
+    size_t tag;         // For a payload, the Bool field. Otherwise itself.
+    size_t stored_in;   // For a Bool field, the payload. Otherwise itself.
+    bool present_when;  // For a payload, the value of the Bool field when the
+                        // payload is present.
+    const char *sentinel;
+} FieldRep;
+
+typedef enum {
+      FUNCTION_QUEUED   // Its signature is lowered, but not its body.
+    , FUNCTION_PENDING  // Its body is being lowered.
+    , FUNCTION_DONE
+    , FUNCTION_ERASED
+    , FUNCTION_FAILED
+} FunctionStatus;
+
+/* A C function lowering a global, or a specialization of a polymorphic global
+ * to particular type arguments, with the type arguments substituted into its
+ * type and definition, or a local function lifted out of one of these.
+ */
+struct Function {
+    size_t global;
+    char *name;
+    Expr *type;
+    Expr *lambda;
+    Expr *type_args; // For specializations, indexed by parameter, with Type in
+                     // place of the arguments which are not types.
+    size_t num_captures; // For local functions, the number of leading
+                         // parameters which are the locals it captures.
+    size_t num_lambdas; // How many local functions were lifted out of it.
+    size_t origin; // The function whose body needed it, or SIZE_MAX for the
+                   // functions lowering globals.
+
+    // The function pointer type of its closures, once they are needed.
+    const char *closure_type;
+
+    // Which parameters are erased and how the rest and the result are
+    // represented, when the signature lowers.
+    FunctionStatus status;
+    bool *erased;
+    const char **param_types;
+    const char *ret_type;
+};
+
+typedef struct {
+    Context *ctx;
+
+    // The sections of the output, in the order they are written after the
+    // named types they refer to. The types are the environments of closures
+    // and the constructors of records. The prototypes and definitions are
+    // indexed by global, holding the functions lowered from it, along with
+    // the other globals whose functions they refer to.
+    Buffer types;
+    Buffer builtins;
+    Buffer *protos;
+    Buffer *defs;
+    size_t *num_refs;
+    size_t **refs;
+
+    // The body of the function currently being generated.
+    Buffer body;
+    unsigned indent;
+    size_t next_temp;
+
+    // The function currently being generated, whether it calls itself in
+    // tail position, and the locals bound within it which may shadow its
+    // parameters.
+    size_t current;
+    bool tail_called;
+    size_t num_bound;
+    const char **bound;
+
+    // The environments of the closures created by the current function, or
+    // pointers to them in the arena, declared at its start so that they live
+    // as long as it does, and whether the expression being generated is only
+    // passed to a call which cannot return it, so that closures in it cannot
+    // outlive the function.
+    Buffer envs;
+    bool downward;
+
+    // Whether the current function may leave environments in the arena,
+    // either its own or those of the function values its callees return,
+    // and whether any function does, so that the arena must be written.
+    bool arena_left;
+    bool uses_arena;
+
+    // Every function so far, in the order they were added. Indexed by
+    // global, the function each global is lowered to, or SIZE_MAX if it is
+    // polymorphic so that only its specializations are.
+    size_t num_functions;
+    struct Function *functions;
+    size_t *global_functions;
+    size_t num_specializations;
+
+    // Indexed by global, whether the function lowering each builtin has been
+    // defined, which happens when it is first called.
+    bool *builtins_defined;
+
+    // Structs, unions and function pointers, keyed on their C definitions so
+    // that types which lower identically share a name. Their declarations
+    // are only written if the rest of the output refers to them, since
+    // types are also named when lowering is only probing them.
+    size_t num_named;
+    struct NamedType {
+        char *key;
+        char *name;
+        Buffer decl;
+        bool written;
+
+        // For unions, the representations of the branches.
+        const char *then_type;
+        const char *else_type;
+
+        // For structs, how each field is stored.
+        size_t num_fields;
+        FieldRep *fields;
+
+        // For vectors, the representation of the elements and how many there
+        // are. The length is zero when it is only known at runtime, in which
+        // case the vector is a pointer to its first element. Otherwise it is
+        // an array in a struct, so that it can be passed by value.
+        const char *elem_type;
+        uint64_t length;
+
+        // For records whose layout depends upon their fields, which point at
+        // a buffer in the arena, the offset of each field, or SIZE_MAX if it
+        // is computed by <name>_offset_<field>. Their fields are described
+        // by fields, with a c_type but no member. The constructor is written
+        // when it is first called.
+        size_t *offsets;
+        char *constructor;
+    } *named;
+} Codegen;
+
+static void codegen_line(Codegen *gen, const char *format, ...) {
+    buffer_printf(&gen->body, "%*s", (int)(gen->indent * 4), "");
+
+    va_list args;
+    va_start(args, format);
+    buffer_vprintf(&gen->body, format, args);
+    va_end(args);
+
+    buffer_printf(&gen->body, "\n");
+}
+
+static void codegen_bind(Codegen *gen, const char *name) {
+    realloc_array(gen->bound, gen->num_bound + 1);
+    gen->bound[gen->num_bound] = name;
+    gen->num_bound += 1;
+}
+
+static void codegen_unbind(Codegen *gen) {
+    gen->num_bound -= 1;
+}
+
+static bool codegen_unsupported(Codegen *gen, const Expr *expr,
+        const char *reason) {
+    efprintf(gen->ctx, stderr, "Cannot generate C for ($e): %s.\n",
+        ewrap(expr), reason);
+    return false;
+}
+
+/* Hash a string with FNV-1a, so that the names derived from it only change
+ * with what they name, and not with whatever else the program has.
+ */
+static uint32_t codegen_hash(const char *str) {
+    uint32_t hash = UINT32_C(2166136261);
+    for (; *str != '\0'; str++) {
+        hash = (hash ^ (unsigned char)*str) * UINT32_C(16777619);
+    }
+    return hash;
+}
+
+/* Print an expression without color, as the key of a name. */
+static void codegen_print_key(Codegen *gen, const Expr *expr, Buffer *out) {
+    char *data = NULL;
+    size_t len = 0;
+    FILE *to = open_memstream(&data, &len);
+    if (to == NULL) {
+        abort();
+    }
+
+    bool color_enabled = gen->ctx->color_enabled;
+    gen->ctx->color_enabled = false;
+    expr_pprint(gen->ctx, to, 0, expr);
+    gen->ctx->color_enabled = color_enabled;
+
+    fclose(to);
+    buffer_printf(out, "%s\n", data);
+    free(data);
+}
+
+static struct NamedType *codegen_find_named(Codegen *gen, const char *name);
+
+/* Find the name of a struct or function pointer type with the given
+ * definition, creating one and its typedef if there is none. The name is
+ * derived from the definition.
+ */
+static const char *codegen_named(Codegen *gen, const char *prefix,
+        const Buffer *key) {
+    for (size_t i = 0; i < gen->num_named; i++) {
+        if (strcmp(gen->named[i].key, buffer_str(key)) == 0) {
+            return gen->named[i].name;
+        }
+    }
+
+    Buffer name = buffer_new();
+    uint32_t hash = codegen_hash(buffer_str(key));
+    do {
+        name.len = 0;
+        buffer_printf(&name, "dc_%s_%08" PRIx32, prefix, hash);
+        hash += 1;
+    } while (codegen_find_named(gen, buffer_str(&name)) != NULL);
+
+    realloc_array(gen->named, gen->num_named + 1);
+    struct NamedType *named = &gen->named[gen->num_named];
+    alloc_array(named->key, key->len + 1);
+    strcpy(named->key, buffer_str(key));
+    named->name = name.data;
+    named->decl = buffer_new();
+    named->written = false;
+    named->then_type = NULL;
+    named->else_type = NULL;
+    named->num_fields = 0;
+    named->fields = NULL;
+    named->elem_type = NULL;
+    named->length = 0;
+    named->offsets = NULL;
+    named->constructor = NULL;
+    gen->num_named += 1;
+
+    return name.data;
+}
+
+/* Add to the declarations of a named type. */
+static void codegen_declare(Codegen *gen, const char *name,
+        const char *format, ...) {
+    struct NamedType *named = codegen_find_named(gen, name);
+    va_list args;
+    va_start(args, format);
+    buffer_vprintf(&named->decl, format, args);
+    va_end(args);
+}
+
+/* Find the definition of a named type. The result is invalidated when
+ * another type is named.
+ */
+static struct NamedType *codegen_find_named(Codegen *gen, const char *name) {
+    for (size_t i = 0; i < gen->num_named; i++) {
+        if (strcmp(gen->named[i].name, name) == 0) {
+            return &gen->named[i];
+        }
+    }
+    return NULL;
+}
+
+/* Whether a C type is a vector, and if so whether its length is static. */
+static bool codegen_is_vector(Codegen *gen, const char *c_type,
+        bool *is_static) {
+    const struct NamedType *named = codegen_find_named(gen, c_type);
+    if (named == NULL || named->elem_type == NULL) {
+        return false;
+    }
+    *is_static = named->length != 0;
+    return true;
+}
+
+/***** Types *****************************************************************/
+
+/* Evaluate a type, unfolding opaque globals. Types mentioning locals or
+ * earlier fields are often stuck, which is not reported.
+ */
+static bool codegen_eval(Codegen *gen, const Expr *type, Expr *result) {
+    gen->ctx->quiet += 1;
+    bool ret_val = type_eval_transparent(gen->ctx, type, result);
+    gen->ctx->quiet -= 1;
+    return ret_val;
+}
+
+static Lowering codegen_type(Codegen *gen, const Expr *type,
+    const char **c_type);
+
+/* Lower the parameter and return types of a function type. Parameters whose
+ * values carry no information are marked as erased. The parameter types are
+ * only lowered if the return type lowers.
+ */
+static Lowering codegen_signature(Codegen *gen, const Expr *forall,
+        bool *erased, const char **param_types, const char **ret_type) {
+    assert(forall->tag == EXPR_FORALL);
+    SymbolTable *symbols = &gen->ctx->symbol_table;
+
+    symbol_table_enter_scope(symbols);
+    for (size_t i = 0; i < forall->forall.num_params; i++) {
+        if (forall->forall.param_names[i] != NULL) {
+            symbol_table_register_local(symbols,
+                forall->forall.param_names[i], forall->forall.param_types[i]);
+        }
+    }
+
+    Lowering ret_val = codegen_type(gen, forall->forall.ret_type, ret_type);
+
+    for (size_t i = 0; ret_val == LOWER_OK
+            && i < forall->forall.num_params; i++) {
+        Lowering param = codegen_type(gen,
+            &forall->forall.param_types[i], &param_types[i]);
+        if (param == LOWER_FAILED) {
+            ret_val = LOWER_FAILED;
+        }
+        erased[i] = param == LOWER_ERASED;
+    }
+
+    symbol_table_leave_scope(symbols);
+    return ret_val;
+}
+
+/* Name the type of function values with the given signature. A function
+ * value points at a closure, whose code is called with the closure itself
+ * followed by the arguments, so that closures capturing locals can keep them
+ * after the closure's first member.
+ */
+static const char *codegen_closure_named(Codegen *gen, size_t num_params,
+        const bool *erased, const char *const *param_types,
+        const char *ret_type) {
+    Buffer params = buffer_new();
+    for (size_t i = 0; i < num_params; i++) {
+        if (!erased[i]) {
+            buffer_printf(&params, ", %s", param_types[i]);
+        }
+    }
+
+    Buffer key = buffer_new();
+    buffer_printf(&key, "%s (*)(%s)", ret_type, buffer_str(&params));
+
+    size_t num_named = gen->num_named;
+    const char *name = codegen_named(gen, "fn", &key);
+    if (gen->num_named != num_named) {
+        codegen_declare(gen, name, "typedef const struct %s {\n"
+            "    %s (*code)(const struct %s *self%s);\n"
+            "} *%s;\n\n", name, ret_type, name, buffer_str(&params), name);
+    }
+
+    buffer_free(&params);
+    buffer_free(&key);
+    return name;
+}
+
+static Lowering codegen_function_type(Codegen *gen, const Expr *forall,
+        const char **c_type) {
+    size_t num_params = forall->forall.num_params;
+    bool *erased;
+    const char **param_types;
+    const char *ret_type;
+    alloc_array(erased, num_params);
+    alloc_array(param_types, num_params);
+
+    Lowering ret_val = codegen_signature(gen, forall,
+        erased, param_types, &ret_type);
+    if (ret_val == LOWER_OK) {
+        *c_type = codegen_closure_named(gen, num_params,
+            erased, param_types, ret_type);
+    }
+
+    dealloc(erased);
+    dealloc(param_types);
+    return ret_val;
+}
+
+/* The C expressions reading the fields of a dynamically sized record which
+ * its layout may depend upon.
+ */
+typedef struct {
+    size_t num;
+    const char **names;
+    Buffer *reads;
+} FieldReads;
+
+/* Write a C expression computing the size of a type whose size may depend
+ * upon the values of fields.
+ */
+static bool codegen_size(Codegen *gen, const Expr *type,
+        const FieldReads *fields, Buffer *out) {
+    Context *ctx = gen->ctx;
+    bool ret_val = false;
+
+    Expr whnf[1];
+    if (!codegen_eval(gen, type, whnf)) {
+        *whnf = expr_copy(ctx, type);
+    }
+
+    Layout layout;
+    VectorShape vector[1];
+    if (layout_type(ctx, whnf, &layout) && layout.is_static) {
+        buffer_printf(out, "%zu", layout.size);
+        ret_val = true;
+    } else if (layout_vector(ctx, whnf, vector)) {
+        // The length times the size of each element.
+        for (size_t i = 0; i < fields->num; i++) {
+            if (vector->length.tag == EXPR_IDENT
+                    && fields->names[i] == vector->length.ident) {
+                buffer_printf(out, "(%s * ", buffer_str(&fields->reads[i]));
+                ret_val = codegen_size(gen, &vector->elem, fields, out);
+                buffer_printf(out, ")");
+                break;
+            }
+        }
+        vector_shape_free(ctx, vector);
+    } else if (whnf->tag == EXPR_IFTHENELSE
+            && whnf->ifthenelse.predicate->tag == EXPR_IDENT) {
+        for (size_t i = 0; i < fields->num; i++) {
+            if (fields->names[i] == whnf->ifthenelse.predicate->ident) {
+                buffer_printf(out, "(%s ? ", buffer_str(&fields->reads[i]));
+                ret_val = codegen_size(gen, whnf->ifthenelse.then_,
+                        fields, out)
+                    && (buffer_printf(out, " : "), true)
+                    && codegen_size(gen, whnf->ifthenelse.else_, fields, out);
+                buffer_printf(out, ")");
+                break;
+            }
+        }
+    }
+
+    if (!ret_val) {
+        codegen_unsupported(gen, type, "its size cannot be computed");
+    }
+
+    expr_free(ctx, whnf);
+    return ret_val;
+}
+
+/* Attach how the fields of a record are stored to the struct it lowers to,
+ * taking ownership of them.
+ */
+static void codegen_record_fields(Codegen *gen, size_t named,
+        size_t num_fields, FieldRep **fields) {
+    gen->named[named].num_fields = num_fields;
+    gen->named[named].fields = *fields;
+    *fields = NULL;
+}
+
+/* Lower a record whose layout depends upon the values of its fields to a
+ * pointer to a buffer holding them, as laid out. Functions are emitted
+ * computing the size of the buffer, along with the offsets and sizes of the
+ * fields placed after the first dynamically sized one, which may only depend
+ * upon statically placed naturals and booleans. Those fields must be vectors,
+ * whose values point at their elements within the buffer.
+ */
+static Lowering codegen_dynamic_record(Codegen *gen, const Expr *sigma,
+        const RecordLayout *layout, const char **c_type) {
+    SymbolTable *symbols = &gen->ctx->symbol_table;
+    size_t num_fields = sigma->sigma.num_fields;
+
+    for (size_t i = 0; i < num_fields; i++) {
+        if (layout->niches[i] != i || layout->bits[i]) {
+            codegen_unsupported(gen, sigma, "records whose layout depends "
+                "upon their fields cannot store fields in niches or bits");
+            return LOWER_FAILED;
+        }
+    }
+
+    Buffer key = buffer_new();
+    buffer_printf(&key, "dynamic ");
+    codegen_print_key(gen, sigma, &key);
+    size_t num_named = gen->num_named;
+    const char *name = codegen_named(gen, "record", &key);
+    buffer_free(&key);
+    if (gen->num_named == num_named) {
+        *c_type = name;
+        return LOWER_OK;
+    }
+
+    FieldRep *fields;
+    alloc_array(fields, num_fields);
+    FieldReads reads = {
+          .num = 0
+    };
+    alloc_array(reads.names, num_fields);
+    alloc_array(reads.reads, num_fields);
+    Buffer funcs = buffer_new();
+    Buffer size = buffer_new();
+    Lowering ret_val = LOWER_OK;
+
+    symbol_table_enter_scope(symbols);
+    for (size_t i = 0; i < num_fields; i++) {
+        if (sigma->sigma.field_names[i] != NULL) {
+            symbol_table_register_local(symbols,
+                sigma->sigma.field_names[i], sigma->sigma.field_types[i]);
+        }
+    }
+
+    for (size_t i = 0; ret_val != LOWER_FAILED && i < num_fields; i++) {
+        const char *field_type;
+        Lowering lowering = codegen_type(gen, &sigma->sigma.field_types[i],
+            &field_type);
+        bool is_static;
+        if (lowering == LOWER_FAILED) {
+            ret_val = LOWER_FAILED;
+        } else if (lowering == LOWER_OK && !layout->fields[i].is_static
+                && !codegen_is_vector(gen, field_type, &is_static)) {
+            codegen_unsupported(gen, &sigma->sigma.field_types[i],
+                "only vectors may have sizes depending upon other fields");
+            ret_val = LOWER_FAILED;
+        }
+
+        fields[i] = (FieldRep){
+              .c_type = lowering == LOWER_OK ? field_type : NULL
+            , .member = NULL
+            , .slot = i
+            , .tag = i
+            , .stored_in = i
+            , .present_when = true
+            , .sentinel = NULL
+        };
+    }
+
+    // Only statically placed naturals and booleans can be read.
+    for (size_t i = 0; i < layout->num_static; i++) {
+        size_t field = layout->order[i];
+        const char *field_type = fields[field].c_type;
+        if (ret_val != LOWER_FAILED && sigma->sigma.field_names[field] != NULL
+                && field_type != NULL && (strcmp(field_type, "bool") == 0
+                    || strcmp(field_type, "uint64_t") == 0)) {
+            reads.names[reads.num] = sigma->sigma.field_names[field];
+            reads.reads[reads.num] = buffer_new();
+            buffer_printf(&reads.reads[reads.num],
+                "*(const %s *)(record + %zu)", field_type,
+                layout->offsets[field]);
+            reads.num += 1;
+        }
+    }
+
+    size_t static_end = 0;
+    if (layout->num_static > 0) {
+        size_t last = layout->order[layout->num_static - 1];
+        static_end = layout->offsets[last] + layout->fields[last].size;
+    }
+
+    buffer_printf(&funcs, "/* The layout of %s depends upon the values of its "
+        "fields. */\n"
+        "typedef const unsigned char *%s;\n\n", name, name);
+    for (size_t i = layout->num_static;
+            ret_val != LOWER_FAILED && i < num_fields; i++) {
+        size_t field = layout->order[i];
+        size_t align = layout->fields[field].align;
+
+        buffer_printf(&funcs, "static inline size_t %s_offset_%zu("
+            "const unsigned char *record) {\n", name, field);
+        if (i == layout->num_static) {
+            buffer_printf(&funcs, "    (void)record;\n"
+                "    size_t end = %zu;\n", static_end);
+        } else {
+            buffer_printf(&funcs, "    size_t end = %s_offset_%zu(record)\n"
+                "        + %s_size_%zu(record);\n", name,
+                layout->order[i - 1], name, layout->order[i - 1]);
+        }
+        buffer_printf(&funcs, "    return (end + %zu) / %zu * %zu;\n}\n\n",
+            align - 1, align, align);
+
+        size.len = 0;
+        if (!codegen_size(gen, &sigma->sigma.field_types[field], &reads,
+                &size)) {
+            ret_val = LOWER_FAILED;
+            break;
+        }
+        buffer_printf(&funcs, "static inline size_t %s_size_%zu("
+            "const unsigned char *record) {\n"
+            "    return %s;\n}\n\n", name, field, buffer_str(&size));
+    }
+    symbol_table_leave_scope(symbols);
+
+    if (ret_val != LOWER_FAILED) {
+        size_t last = layout->order[num_fields - 1];
+        size_t align = layout->layout.align;
+        buffer_printf(&funcs, "static inline size_t %s_size("
+            "const unsigned char *record) {\n"
+            "    size_t end = %s_offset_%zu(record) + %s_size_%zu(record);\n"
+            "    return (end + %zu) / %zu * %zu;\n}\n\n",
+            name, name, last, name, last, align - 1, align, align);
+        codegen_declare(gen, name, "%s", buffer_str(&funcs));
+
+        // The constructor writes the statically placed fields first, so that
+        // the size can be read from them.
+        struct NamedType *named = &gen->named[num_named];
+        Buffer constructor = buffer_new();
+        buffer_printf(&constructor, "static inline %s %s_new(", name, name);
+        bool first = true;
+        for (size_t i = 0; i < num_fields; i++) {
+            if (fields[i].c_type != NULL) {
+                buffer_printf(&constructor, "%s%s f%zu", first ? "" : ", ",
+                    fields[i].c_type, i);
+                first = false;
+            }
+        }
+        buffer_printf(&constructor, "%s) {\n"
+            "    max_align_t header[%zu];\n"
+            "    unsigned char *record = (unsigned char *)header;\n",
+            first ? "void" : "",
+            (static_end + sizeof(max_align_t)) / sizeof(max_align_t));
+        alloc_array(named->offsets, num_fields);
+        for (size_t i = 0; i < num_fields; i++) {
+            size_t field = layout->order[i];
+            named->offsets[field] = i < layout->num_static
+                ? layout->offsets[field] : SIZE_MAX;
+            if (i < layout->num_static && fields[field].c_type != NULL) {
+                buffer_printf(&constructor,
+                    "    *(%s *)(record + %zu) = f%zu;\n",
+                    fields[field].c_type, layout->offsets[field], field);
+            }
+        }
+        buffer_printf(&constructor, "    unsigned char *result = "
+            "dcrt_alloc(%s_size(record));\n"
+            "    memcpy(result, record, %zu);\n", name, static_end);
+        for (size_t i = layout->num_static; i < num_fields; i++) {
+            size_t field = layout->order[i];
+            if (fields[field].c_type != NULL) {
+                buffer_printf(&constructor, "    memcpy(result + "
+                    "%s_offset_%zu(result), f%zu, %s_size_%zu(result));\n",
+                    name, field, field, name, field);
+            }
+        }
+        buffer_printf(&constructor, "    return result;\n}\n\n");
+        named->constructor = constructor.data;
+
+        codegen_record_fields(gen, num_named, num_fields, &fields);
+        *c_type = name;
+    }
+
+    for (size_t i = 0; i < reads.num; i++) {
+        buffer_free(&reads.reads[i]);
+    }
+    dealloc(reads.names);
+    dealloc(reads.reads);
+    dealloc(fields);
+    buffer_free(&funcs);
+    buffer_free(&size);
+    return ret_val;
+}
+
+/* Whether the payload of a field whose Bool tag is stored in its niche is
+ * present when the tag is true, in which case the field's type is
+ * "if tag then T else {}".
+ */
+static bool codegen_payload_branch(Codegen *gen, const Expr *type) {
+    bool ret_val = true;
+
+    Expr whnf[1];
+    if (codegen_eval(gen, type, whnf)) {
+        const char *c_type;
+        ret_val = whnf->tag != EXPR_IFTHENELSE || codegen_type(gen,
+            whnf->ifthenelse.then_, &c_type) != LOWER_ERASED;
+        expr_free(gen->ctx, whnf);
+    }
+
+    return ret_val;
+}
+
+static bool codegen_same_fields(const struct NamedType *named,
+        size_t num_fields, const FieldRep *fields) {
+    if (named->num_fields != num_fields) {
+        return false;
+    }
+
+    for (size_t i = 0; i < num_fields; i++) {
+        const FieldRep *x = &named->fields[i];
+        const FieldRep *y = &fields[i];
+        if ((x->member == NULL) != (y->member == NULL) || x->slot != y->slot
+                || x->tag != y->tag || x->stored_in != y->stored_in
+                || x->present_when != y->present_when) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Name a record whose fields are stored in the same struct as another's, but
+ * which has erased fields in different places. The name is a typedef of the
+ * struct, so that values of either can be used as the other.
+ */
+static const char *codegen_record_view(Codegen *gen, const char *c_type,
+        size_t num_fields, FieldRep **fields) {
+    Buffer key = buffer_new();
+    buffer_printf(&key, "%s with", c_type);
+    for (size_t i = 0; i < num_fields; i++) {
+        const FieldRep *field = &(*fields)[i];
+        if (field->member == NULL && field->stored_in == i) {
+            buffer_printf(&key, " -");
+        } else {
+            buffer_printf(&key, " %zu/%zu/%zu/%d", field->slot, field->tag,
+                field->stored_in, field->present_when);
+        }
+    }
+
+    size_t num_named = gen->num_named;
+    const char *name = codegen_named(gen, "record", &key);
+    if (gen->num_named != num_named) {
+        codegen_declare(gen, name, "typedef %s %s;\n\n", c_type, name);
+        codegen_record_fields(gen, num_named, num_fields, fields);
+    }
+
+    buffer_free(&key);
+    return name;
+}
+
+static Lowering codegen_record(Codegen *gen, const Expr *sigma,
+        const char **c_type) {
+    assert(sigma->tag == EXPR_SIGMA);
+    SymbolTable *symbols = &gen->ctx->symbol_table;
+    size_t num_fields = sigma->sigma.num_fields;
+    Lowering ret_val = LOWER_ERASED;
+
+    RecordLayout layout[1];
+    bool laid_out = layout_record(gen->ctx, sigma, layout);
+    if (laid_out && !layout->layout.is_static
+            && sigma->sigma.layout == SIGMA_LAYOUT_PACKED) {
+        codegen_unsupported(gen, sigma, "packed records cannot have fields "
+            "whose sizes depend upon other fields");
+        record_layout_free(layout);
+        return LOWER_FAILED;
+    } else if (laid_out && !layout->layout.is_static) {
+        ret_val = codegen_dynamic_record(gen, sigma, layout, c_type);
+        record_layout_free(layout);
+        return ret_val;
+    }
+
+    // Fields which carry no information are left out.
+    FieldRep *fields;
+    alloc_array(fields, num_fields);
+
+    symbol_table_enter_scope(symbols);
+    for (size_t i = 0; i < num_fields; i++) {
+        const char *field_type;
+        Lowering lowering = codegen_type(gen,
+            &sigma->sigma.field_types[i], &field_type);
+
+        if (lowering == LOWER_FAILED) {
+            ret_val = LOWER_FAILED;
+            break;
+        } else if (lowering == LOWER_OK) {
+            ret_val = LOWER_OK;
+        }
+
+        fields[i] = (FieldRep){
+              .c_type = lowering == LOWER_OK ? field_type : NULL
+            , .member = lowering == LOWER_OK ? field_type : NULL
+            , .slot = SIZE_MAX
+            , .tag = i
+            , .stored_in = laid_out ? layout->niches[i] : i
+            , .present_when = true
+            , .sentinel = NULL
+        };
+
+        if (fields[i].stored_in != i) {
+            fields[i].member = NULL;
+        }
+
+        size_t tag;
+        Expr payload[1];
+        if (laid_out && sigma->sigma.layout == SIGMA_LAYOUT_NICHE
+                && layout_optional_field(gen->ctx, sigma, i, &tag, payload)) {
+            expr_free(gen->ctx, payload);
+            if (layout->niches[tag] != i) {
+                codegen_unsupported(gen, &sigma->sigma.field_types[i],
+                    "its tag must be stored in a niche, but it has none");
+                ret_val = LOWER_FAILED;
+                break;
+            }
+        }
+        for (size_t tag = 0; laid_out && tag < i; tag++) {
+            if (layout->niches[tag] == i) {
+                fields[i].tag = tag;
+                fields[i].present_when =
+                    codegen_payload_branch(gen, &sigma->sigma.field_types[i]);
+                if (strcmp(field_type, "bool") == 0) {
+                    fields[i].member = "unsigned char";
+                    fields[i].sentinel = "2";
+                } else {
+                    fields[i].sentinel = "NULL";
+                }
+            }
+        }
+
+        if (sigma->sigma.field_names[i] != NULL) {
+            symbol_table_register_local(symbols,
+                sigma->sigma.field_names[i], sigma->sigma.field_types[i]);
+        }
+    }
+    symbol_table_leave_scope(symbols);
+
+    if (ret_val == LOWER_OK) {
+        size_t num_members = 0;
+        for (size_t i = 0; i < num_fields; i++) {
+            if (fields[i].member != NULL) {
+                fields[i].slot = num_members;
+                num_members += 1;
+            }
+        }
+
+        // Declare the fields in the order the layout places them, so that
+        // the C compiler pads them no more than it has to.
+        Buffer body = buffer_new();
+        for (size_t i = 0; i < num_fields; i++) {
+            size_t field_num = laid_out ? layout->order[i] : i;
+            const FieldRep *field = &fields[field_num];
+            if (field->member == NULL) {
+                continue;
+            }
+
+            buffer_printf(&body, "    %s f%zu%s;", field->member, field->slot,
+                laid_out && layout->bits[field_num] ? " : 1" : "");
+            if (field->tag != field_num) {
+                buffer_printf(&body, " // %s when its tag is %s.",
+                    field->sentinel, field->present_when ? "false" : "true");
+            }
+            buffer_printf(&body, "\n");
+        }
+
+        size_t num_named = gen->num_named;
+        *c_type = codegen_named(gen, "record", &body);
+        if (gen->num_named != num_named) {
+            codegen_declare(gen, *c_type, "typedef struct %s {\n%s} %s;\n\n",
+                *c_type, buffer_str(&body), *c_type);
+            codegen_record_fields(gen, num_named, num_fields, &fields);
+        } else if (!codegen_same_fields(codegen_find_named(gen, *c_type),
+                num_fields, fields)) {
+            *c_type = codegen_record_view(gen, *c_type, num_fields, &fields);
+        }
+        buffer_free(&body);
+    }
+
+    if (laid_out) {
+        record_layout_free(layout);
+    }
+    dealloc(fields);
+    return ret_val;
+}
+
+/* Lower a vector by induction to a flat array of its elements. */
+static Lowering codegen_vector(Codegen *gen, const VectorShape *vector,
+        const char **c_type) {
+    const char *elem_type;
+    Lowering ret_val = codegen_type(gen, &vector->elem, &elem_type);
+    if (ret_val != LOWER_OK) {
+        return ret_val;
+    }
+
+    Buffer key = buffer_new();
+    size_t num_named = gen->num_named;
+    uint64_t length = 0;
+
+    if (vector->length.tag == EXPR_NATURAL) {
+        if (!natural_is_small(&vector->length.natural)) {
+            buffer_free(&key);
+            codegen_unsupported(gen, &vector->length,
+                "vectors must have fewer than 2^64 elements");
+            return LOWER_FAILED;
+        }
+        length = vector->length.natural.small;
+        buffer_printf(&key, "    %s at[%" PRIu64 "];\n", elem_type, length);
+        *c_type = codegen_named(gen, "array", &key);
+        if (gen->num_named != num_named) {
+            codegen_declare(gen, *c_type, "typedef struct %s {\n%s} %s;\n\n",
+                *c_type, buffer_str(&key), *c_type);
+        }
+    } else {
+        buffer_printf(&key, "const %s *", elem_type);
+        *c_type = codegen_named(gen, "vector", &key);
+        if (gen->num_named != num_named) {
+            codegen_declare(gen, *c_type, "typedef %s%s;\n\n",
+                buffer_str(&key), *c_type);
+        }
+    }
+
+    if (gen->num_named != num_named) {
+        gen->named[num_named].elem_type = elem_type;
+        gen->named[num_named].length = length;
+    }
+    buffer_free(&key);
+    return LOWER_OK;
+}
+
+static Lowering codegen_type_whnf(Codegen *gen, const Expr *type,
+        const char **c_type) {
+    VectorShape vector[1];
+    Lowering ret_val;
+
+    switch (type->tag) {
+      case EXPR_TYPE:
+      case EXPR_ID:
+      case EXPR_VOID:
+        return LOWER_ERASED;
+
+      case EXPR_NAT:
+        *c_type = "uint64_t";
+        return LOWER_OK;
+
+      case EXPR_BOOL:
+        *c_type = "bool";
+        return LOWER_OK;
+
+      case EXPR_SIGMA:
+        if (layout_vector(gen->ctx, type, vector)) {
+            ret_val = codegen_vector(gen, vector, c_type);
+            vector_shape_free(gen->ctx, vector);
+            return ret_val;
+        }
+        return codegen_record(gen, type, c_type);
+
+      case EXPR_FORALL:
+        return codegen_function_type(gen, type, c_type);
+
+      case EXPR_IFTHENELSE: {
+        // The condition is unknown, so values may come from either branch.
+        // Storage for a branch carrying no information is never read, so
+        // only the other needs representing. Otherwise the branches share
+        // their storage in a union, with the condition acting as its tag.
+        const char *then_type, *else_type;
+        Lowering then_ = codegen_type(gen, type->ifthenelse.then_, &then_type);
+        Lowering else_ = codegen_type(gen, type->ifthenelse.else_, &else_type);
+
+        if (then_ == LOWER_FAILED || else_ == LOWER_FAILED) {
+            return LOWER_FAILED;
+        } else if (then_ == LOWER_ERASED && else_ == LOWER_ERASED) {
+            return LOWER_ERASED;
+        } else if (else_ == LOWER_ERASED
+                || strcmp(then_type, else_type) == 0) {
+            *c_type = then_type;
+            return LOWER_OK;
+        } else if (then_ == LOWER_ERASED) {
+            *c_type = else_type;
+            return LOWER_OK;
+        }
+
+        Buffer key = buffer_new();
+        buffer_printf(&key, "    %s then_;\n    %s else_;\n",
+            then_type, else_type);
+
+        size_t num_named = gen->num_named;
+        *c_type = codegen_named(gen, "union", &key);
+        if (gen->num_named != num_named) {
+            codegen_declare(gen, *c_type, "typedef union %s {\n%s} %s;\n\n",
+                *c_type, buffer_str(&key), *c_type);
+            gen->named[num_named].then_type = then_type;
+            gen->named[num_named].else_type = else_type;
+        }
+        buffer_free(&key);
+        return LOWER_OK;
+      }
+
+      default:
+        if (layout_vector(gen->ctx, type, vector)) {
+            ret_val = codegen_vector(gen, vector, c_type);
+            vector_shape_free(gen->ctx, vector);
+            return ret_val;
+        }
+        codegen_unsupported(gen, type, "the type is abstract");
+        return LOWER_FAILED;
+    }
+}
+
+/* How many times codegen_type unfolds a type that does not evaluate. */
+#define CODEGEN_MAX_UNFOLDS 16
+
+/* Determine how values of a type are represented in C. */
+static Lowering codegen_type(Codegen *gen, const Expr *type,
+        const char **c_type) {
+    Context *ctx = gen->ctx;
+
+    // Evaluation gets stuck on calls whose arguments mention locals, such as
+    // Holds(nat_lt(0, y)). Unfolding the global at the head of such a type
+    // may still reveal its shape, such as an if-then-else of erased branches.
+    Expr whnf[1];
+    Expr current = expr_copy(ctx, type);
+    for (unsigned unfolds = 0; !codegen_eval(gen, &current, whnf); unfolds++) {
+        VectorShape vector[1];
+        if (layout_vector(ctx, &current, vector)) {
+            vector_shape_free(ctx, vector);
+            *whnf = expr_copy(ctx, &current);
+            break;
+        }
+
+        Expr unfolded;
+        ctx->quiet += 1;
+        bool did_unfold = unfolds < CODEGEN_MAX_UNFOLDS
+            && type_unfold(ctx, &current, &unfolded);
+        ctx->quiet -= 1;
+        if (!did_unfold) {
+            *whnf = expr_copy(ctx, &current);
+            break;
+        }
+        expr_free(ctx, &current);
+        current = unfolded;
+    }
+    expr_free(ctx, &current);
+
+    Lowering ret_val = codegen_type_whnf(gen, whnf, c_type);
+    expr_free(ctx, whnf);
+    return ret_val;
+}
+
+/* Lower the type of an expression. */
+static Lowering codegen_type_of(Codegen *gen, const Expr *expr,
+        const char **c_type) {
+    Expr type[1];
+    if (!type_infer(gen->ctx, expr, type)) {
+        return LOWER_FAILED;
+    }
+
+    Lowering ret_val = codegen_type(gen, type, c_type);
+    expr_free(gen->ctx, type);
+    return ret_val;
+}
+
+/***** Functions *************************************************************/
+
+/* Whether a parameter of this type ranges over types or type families, so
+ * that functions taking it are specialized to its arguments.
+ */
+static bool codegen_is_type_param(const Expr *type) {
+    switch (type->tag) {
+      case EXPR_TYPE:
+        return true;
+      case EXPR_FORALL:
+        return codegen_is_type_param(type->forall.ret_type);
+      default:
+        return false;
+    }
+}
+
+/* Whether a global is a function with type parameters, in which case it is
+ * only generated as specializations to the type arguments it is called with.
+ */
+static bool codegen_is_polymorphic(Codegen *gen, size_t global) {
+    const Expr *type = &gen->ctx->symbol_table.global_types[global];
+    if (type->tag != EXPR_FORALL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < type->forall.num_params; i++) {
+        if (codegen_is_type_param(&type->forall.param_types[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Add a function lowering a global, taking ownership of its name, type,
+ * definition and type arguments, and lower its signature.
+ */
+static size_t codegen_add_function(Codegen *gen, size_t global, char *name,
+        Expr type, Expr lambda, Expr *type_args) {
+    size_t num_params = type.forall.num_params;
+    realloc_array(gen->functions, gen->num_functions + 1);
+    size_t index = gen->num_functions;
+    struct Function *function = &gen->functions[index];
+    gen->num_functions += 1;
+
+    function->global = global;
+    function->name = name;
+    alloc(function->type);
+    *function->type = type;
+    alloc(function->lambda);
+    *function->lambda = lambda;
+    function->type_args = type_args;
+    function->num_captures = 0;
+    function->num_lambdas = 0;
+    function->origin = SIZE_MAX;
+    function->closure_type = NULL;
+    alloc_array(function->erased, num_params);
+    alloc_array(function->param_types, num_params);
+    function->ret_type = NULL;
+
+    switch (codegen_signature(gen, function->type, function->erased,
+            function->param_types, &function->ret_type)) {
+      case LOWER_OK:
+        function->status = FUNCTION_QUEUED;
+        break;
+      case LOWER_ERASED:
+        function->status = FUNCTION_ERASED;
+        break;
+      case LOWER_FAILED:
+        function->status = FUNCTION_FAILED;
+        fprintf(stderr, "Cannot generate C for \"%s\".\n",
+            symbol_name(gen->ctx->symbol_table.global_names[global]));
+        break;
+    }
+
+    return index;
+}
+
+static void codegen_function_free(Context *ctx, struct Function *function) {
+    size_t num_params = function->type->forall.num_params;
+    if (function->type_args != NULL) {
+        for (size_t i = 0; i < num_params; i++) {
+            expr_free(ctx, &function->type_args[i]);
+        }
+        dealloc(function->type_args);
+    }
+    expr_free(ctx, function->type);
+    dealloc(function->type);
+    expr_free(ctx, function->lambda);
+    dealloc(function->lambda);
+    dealloc(function->name);
+    dealloc(function->erased);
+    dealloc(function->param_types);
+}
+
+/* Whether there is already a function with the given name. */
+static bool codegen_find_function(Codegen *gen, const char *name) {
+    for (size_t i = 0; i < gen->num_functions; i++) {
+        if (strcmp(gen->functions[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Evaluate the type arguments of a call to a polymorphic global, placing Type
+ * at the positions of the other arguments. Fails if they depend on locals,
+ * since specializations must be closed.
+ */
+static bool codegen_type_args(Codegen *gen, const Expr *call,
+        Expr *type_args) {
+    Context *ctx = gen->ctx;
+    const Expr *type =
+        &ctx->symbol_table.global_types[call->call.func->global];
+    size_t num_params = call->call.num_args;
+    bool ret_val = true;
+
+    for (size_t i = 0; i < num_params; i++) {
+        type_args[i] = literal_expr_type;
+    }
+
+    for (size_t i = 0; ret_val && i < num_params; i++) {
+        if (!codegen_is_type_param(&type->forall.param_types[i])) {
+            continue;
+        }
+        if (!type_eval(ctx, &call->call.args[i], &type_args[i])) {
+            type_args[i] = expr_copy(ctx, &call->call.args[i]);
+        }
+
+        SymbolSet free_vars = symbol_set_empty();
+        expr_free_vars(ctx, &type_args[i], &free_vars);
+        ret_val = free_vars.size == 0;
+        symbol_set_free(&free_vars);
+    }
+
+    if (!ret_val) {
+        for (size_t i = 0; i < num_params; i++) {
+            expr_free(ctx, &type_args[i]);
+        }
+    }
+    return ret_val;
+}
+
+/* Whether a type argument is larger than in a specialization of the same
+ * global that the current function was needed by, directly or not. Such as
+ * in polymorphic recursion, the arguments would then grow without end, each
+ * needing another specialization.
+ */
+static bool codegen_type_args_grow(Codegen *gen, size_t global,
+        size_t num_params, const Expr *type_args) {
+    size_t i = gen->current;
+    for (; i != SIZE_MAX; i = gen->functions[i].origin) {
+        const struct Function *other = &gen->functions[i];
+        if (other->global != global || other->type_args == NULL) {
+            continue;
+        }
+        for (size_t j = 0; j < num_params; j++) {
+            if (expr_size(gen->ctx, &type_args[j])
+                    > expr_size(gen->ctx, &other->type_args[j])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* Find the function a call to a global is lowered to. A call to a polymorphic
+ * global is lowered to its specialization to the call's type arguments, which
+ * is added and queued for generation when it does not exist yet, provided
+ * create is set. Only reports why it fails when create is set.
+ */
+static bool codegen_callee(Codegen *gen, const Expr *call, bool create,
+        size_t *function) {
+    assert(call->tag == EXPR_CALL && call->call.func->tag == EXPR_GLOBAL);
+    Context *ctx = gen->ctx;
+    SymbolTable *symbols = &ctx->symbol_table;
+    size_t global = call->call.func->global;
+    const Expr *type = &symbols->global_types[global];
+    const Expr *define = &symbols->global_defines[global];
+
+    if (gen->global_functions[global] != SIZE_MAX) {
+        *function = gen->global_functions[global];
+        return true;
+    } else if (!codegen_is_polymorphic(gen, global)
+            || !symbols->global_defined[global]
+            || define->tag != EXPR_LAMBDA
+            || call->call.num_args != type->forall.num_params
+            || call->call.num_args != define->lambda.num_params) {
+        return create && codegen_unsupported(gen, call->call.func,
+            "it could not be generated");
+    }
+
+    size_t num_params = call->call.num_args;
+    Expr *type_args;
+    alloc_array(type_args, num_params);
+    if (!codegen_type_args(gen, call, type_args)) {
+        dealloc(type_args);
+        return create && codegen_unsupported(gen, call,
+            "its type arguments are not known");
+    }
+
+    // Specializations are shared between type arguments which are equal
+    // once evaluated.
+    for (size_t i = 0; i < gen->num_functions; i++) {
+        const struct Function *other = &gen->functions[i];
+        if (other->global != global || other->type_args == NULL) {
+            continue;
+        }
+
+        size_t j = 0;
+        while (j < num_params
+                && expr_equal(ctx, &other->type_args[j], &type_args[j])) {
+            j += 1;
+        }
+        if (j == num_params) {
+            for (size_t k = 0; k < num_params; k++) {
+                expr_free(ctx, &type_args[k]);
+            }
+            dealloc(type_args);
+            *function = i;
+            return true;
+        }
+    }
+
+    const char *reason = NULL;
+    if (gen->num_specializations >= ctx->specialization_cap) {
+        reason = "it exceeds the limit on specializations";
+    } else if (codegen_type_args_grow(gen, global, num_params, type_args)) {
+        reason = "its type arguments grow with each specialization";
+    }
+    if (!create || reason != NULL) {
+        for (size_t i = 0; i < num_params; i++) {
+            expr_free(ctx, &type_args[i]);
+        }
+        dealloc(type_args);
+        return create && codegen_unsupported(gen, call, reason);
+    }
+
+    // The type parameters are kept, and erased like any other.
+    const char **names;
+    alloc_array(names, num_params);
+    Expr spec_type = expr_copy(ctx, type);
+    for (size_t i = 0; i < num_params; i++) {
+        names[i] = codegen_is_type_param(&type->forall.param_types[i])
+            ? type->forall.param_names[i] : NULL;
+    }
+    for (size_t i = 0; i < num_params; i++) {
+        expr_subst_many(ctx, &spec_type.forall.param_types[i],
+            num_params, names, type_args);
+    }
+    expr_subst_many(ctx, spec_type.forall.ret_type,
+        num_params, names, type_args);
+
+    Expr lambda = expr_copy(ctx, define);
+    for (size_t i = 0; i < num_params; i++) {
+        names[i] = codegen_is_type_param(&type->forall.param_types[i])
+            ? define->lambda.param_names[i] : NULL;
+    }
+    for (size_t i = 0; i < num_params; i++) {
+        expr_subst_many(ctx, &lambda.lambda.param_types[i],
+            num_params, names, type_args);
+    }
+    expr_subst_many(ctx, lambda.lambda.body, num_params, names, type_args);
+    dealloc(names);
+
+    // Named after its type arguments, so that it keeps its name whichever
+    // other specializations there are.
+    Buffer key = buffer_new();
+    for (size_t i = 0; i < num_params; i++) {
+        codegen_print_key(gen, &type_args[i], &key);
+    }
+    Buffer name = buffer_new();
+    uint32_t hash = codegen_hash(buffer_str(&key));
+    do {
+        name.len = 0;
+        buffer_printf(&name, "dc_%s__%08" PRIx32,
+            symbol_name(symbols->global_names[global]), hash);
+        hash += 1;
+    } while (codegen_find_function(gen, buffer_str(&name)));
+    buffer_free(&key);
+    gen->num_specializations += 1;
+
+    *function = codegen_add_function(gen, global, name.data,
+        spec_type, lambda, type_args);
+    gen->functions[*function].origin = gen->current;
+    return true;
+}
+
+/* Check that a function can be referred to from generated code, recording
+ * that the current function's global refers to the function's.
+ */
+static bool codegen_function_ref(Codegen *gen, const Expr *expr,
+        size_t function) {
+    size_t from = gen->functions[gen->current].global;
+    size_t to = gen->functions[function].global;
+
+    switch (gen->functions[function].status) {
+      case FUNCTION_QUEUED:
+      case FUNCTION_PENDING:
+      case FUNCTION_DONE:
+        for (size_t i = 0; i < gen->num_refs[from]; i++) {
+            if (gen->refs[from][i] == to) {
+                return true;
+            }
+        }
+        realloc_array(gen->refs[from], gen->num_refs[from] + 1);
+        gen->refs[from][gen->num_refs[from]] = to;
+        gen->num_refs[from] += 1;
+        return true;
+      case FUNCTION_ERASED:
+        return codegen_unsupported(gen, expr, "it is erased");
+      case FUNCTION_FAILED:
+        // Why was reported when it failed.
+        return false;
+    }
+
+    return false;
+}
+
+/***** Closures **************************************************************/
+
+/* Add a local to the locals a local function captures, after the locals its
+ * type mentions.
+ */
+static bool codegen_capture(Codegen *gen, const char *name,
+        size_t *num_captures, const char ***captures) {
+    for (size_t i = 0; i < *num_captures; i++) {
+        if ((*captures)[i] == name) {
+            return true;
+        }
+    }
+
+    Expr type;
+    if (!symbol_table_lookup(&gen->ctx->symbol_table, name, &type)) {
+        return false;
+    }
+
+    SymbolSet free_vars = symbol_set_empty();
+    expr_free_vars(gen->ctx, &type, &free_vars);
+    bool ret_val = true;
+    for (size_t i = 0; ret_val && i < free_vars.size; i++) {
+        ret_val = codegen_capture(gen, free_vars.symbols[i],
+            num_captures, captures);
+    }
+    symbol_set_free(&free_vars);
+
+    if (ret_val) {
+        realloc_array(*captures, *num_captures + 1);
+        (*captures)[*num_captures] = name;
+        *num_captures += 1;
+    }
+    return ret_val;
+}
+
+/* Lift a local function out into a function of its own, taking the locals it
+ * captures as extra leading parameters, so that calling it directly needs no
+ * closure.
+ */
+static bool codegen_lift(Codegen *gen, const Expr *lambda, size_t *function) {
+    assert(lambda->tag == EXPR_LAMBDA);
+    Context *ctx = gen->ctx;
+
+    Expr type;
+    if (!type_infer(ctx, lambda, &type)) {
+        return false;
+    }
+
+    size_t num_captures = 0;
+    const char **captures = NULL;
+    SymbolSet free_vars = symbol_set_empty();
+    expr_free_vars(ctx, lambda, &free_vars);
+    bool ret_val = true;
+    for (size_t i = 0; ret_val && i < free_vars.size; i++) {
+        ret_val = codegen_capture(gen, free_vars.symbols[i],
+            &num_captures, &captures);
+    }
+    symbol_set_free(&free_vars);
+
+    if (!ret_val) {
+        expr_free(ctx, &type);
+        dealloc(captures);
+        return codegen_unsupported(gen, lambda,
+            "the types of its captured locals are unknown");
+    }
+
+    size_t num_params = num_captures + lambda->lambda.num_params;
+    Expr lifted_type = {
+          .tag = EXPR_FORALL
+        , .well_typed = true
+        , .forall.num_params = num_params
+    };
+    Expr lifted = {
+          .tag = EXPR_LAMBDA
+        , .well_typed = true
+        , .lambda.num_params = num_params
+    };
+    alloc_array(lifted_type.forall.param_types, num_params);
+    alloc_array(lifted_type.forall.param_names, num_params);
+    alloc_array(lifted.lambda.param_types, num_params);
+    alloc_array(lifted.lambda.param_names, num_params);
+
+    for (size_t i = 0; i < num_params; i++) {
+        Expr param_type;
+        if (i < num_captures) {
+            symbol_table_lookup(&ctx->symbol_table, captures[i], &param_type);
+            lifted_type.forall.param_names[i] = captures[i];
+            lifted.lambda.param_names[i] = captures[i];
+        } else {
+            size_t j = i - num_captures;
+            param_type = lambda->lambda.param_types[j];
+            lifted_type.forall.param_names[i] = type.forall.param_names[j];
+            lifted.lambda.param_names[i] = lambda->lambda.param_names[j];
+        }
+        lifted_type.forall.param_types[i] = expr_copy(ctx, &param_type);
+        lifted.lambda.param_types[i] = expr_copy(ctx, &param_type);
+    }
+    alloc_assign(lifted_type.forall.ret_type,
+        expr_copy(ctx, type.forall.ret_type));
+    alloc_assign(lifted.lambda.body, expr_copy(ctx, lambda->lambda.body));
+    expr_free(ctx, &type);
+    dealloc(captures);
+
+    struct Function *current = &gen->functions[gen->current];
+    Buffer name = buffer_new();
+    buffer_printf(&name, "%s__lambda%zu", current->name, current->num_lambdas);
+    current->num_lambdas += 1;
+    *function = codegen_add_function(gen, gen->functions[gen->current].global,
+        name.data, lifted_type, lifted, NULL);
+    gen->functions[*function].num_captures = num_captures;
+    gen->functions[*function].origin = gen->current;
+    return codegen_function_ref(gen, lambda, *function);
+}
+
+/* Whether values of a type may hold function values, records whose layout
+ * depends upon their fields or vectors of unknown length, which point at
+ * storage that must outlive them.
+ */
+static bool codegen_holds_pointers(Codegen *gen, const char *c_type) {
+    const struct NamedType *named = codegen_find_named(gen, c_type);
+    if (named == NULL) {
+        return false;
+    } else if (strncmp(c_type, "dc_fn_", strlen("dc_fn_")) == 0
+            || named->offsets != NULL
+            || (named->elem_type != NULL && named->length == 0)) {
+        return true;
+    } else if (named->then_type != NULL) {
+        return codegen_holds_pointers(gen, named->then_type)
+            || codegen_holds_pointers(gen, named->else_type);
+    } else if (named->elem_type != NULL) {
+        return codegen_holds_pointers(gen, named->elem_type);
+    }
+
+    for (size_t i = 0; i < named->num_fields; i++) {
+        if (named->fields[i].member != NULL
+                && codegen_holds_pointers(gen, named->fields[i].member)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Write a closure of a function as a value of the given function type. The
+ * code of its closures calls the function with the captured locals stored
+ * after the closure's first member. A function capturing no locals has a
+ * single closure, while the others are stored in the environments of the
+ * current function where they cannot outlive it, or otherwise allocated in
+ * the arena, which codegen_function releases once no result can hold them.
+ */
+static bool codegen_closure(Codegen *gen, const Expr *expr, size_t function,
+        const char *c_type, Buffer *out) {
+    const struct Function *target = &gen->functions[function];
+    size_t num_params = target->type->forall.num_params;
+    size_t num_captures = target->num_captures;
+    const bool *erased = target->erased;
+
+    bool captures = false;
+    for (size_t i = 0; i < num_captures; i++) {
+        captures = captures || !erased[i];
+    }
+
+    if (c_type == NULL && codegen_type_of(gen, expr, &c_type) != LOWER_OK) {
+        return false;
+    } else if (c_type != codegen_closure_named(gen,
+            num_params - num_captures, erased + num_captures,
+            target->param_types + num_captures, target->ret_type)) {
+        return codegen_unsupported(gen, expr, "its representation differs "
+            "from the function's");
+    }
+
+    if (target->closure_type == NULL) {
+        Buffer *defs = &gen->defs[target->global];
+        Buffer code = buffer_new();
+        buffer_printf(&code, "%s %s__code(%s self", target->ret_type,
+            target->name, c_type);
+        for (size_t i = num_captures; i < num_params; i++) {
+            if (!erased[i]) {
+                buffer_printf(&code, ", %s a%zu", target->param_types[i], i);
+            }
+        }
+        buffer_printf(&code, ")");
+        buffer_printf(&gen->protos[target->global], "%s;\n",
+            buffer_str(&code));
+        buffer_printf(defs, "%s {\n", buffer_str(&code));
+
+        if (captures) {
+            buffer_printf(&gen->types, "struct %s__env {\n"
+                "    struct %s closure;\n", target->name, c_type);
+            for (size_t i = 0; i < num_captures; i++) {
+                if (!erased[i]) {
+                    buffer_printf(&gen->types, "    %s v_%s;\n",
+                        target->param_types[i], symbol_mangled(
+                            target->lambda->lambda.param_names[i]));
+                }
+            }
+            buffer_printf(&gen->types, "};\n\n");
+            buffer_printf(defs, "    const struct %s__env *env = "
+                "(const struct %s__env *)self;\n", target->name,
+                target->name);
+        } else {
+            buffer_printf(&gen->protos[target->global],
+                "extern const struct %s %s__closure;\n", c_type, target->name);
+            buffer_printf(defs, "    (void)self;\n");
+        }
+
+        buffer_printf(defs, "    return %s(", target->name);
+        bool first = true;
+        for (size_t i = 0; i < num_params; i++) {
+            if (erased[i]) {
+                continue;
+            } else if (i < num_captures) {
+                buffer_printf(defs, "%senv->v_%s", first ? "" : ", ",
+                    symbol_mangled(target->lambda->lambda.param_names[i]));
+            } else {
+                buffer_printf(defs, "%sa%zu", first ? "" : ", ", i);
+            }
+            first = false;
+        }
+        buffer_printf(defs, ");\n}\n\n");
+
+        if (!captures) {
+            buffer_printf(defs, "const struct %s %s__closure = "
+                "{ %s__code };\n\n", c_type, target->name, target->name);
+        }
+        gen->functions[function].closure_type = c_type;
+        buffer_free(&code);
+    }
+
+    if (!captures) {
+        buffer_printf(out, "(&%s__closure)", target->name);
+        return true;
+    }
+
+    size_t temp = gen->next_temp;
+    gen->next_temp += 1;
+    const char *member = gen->downward ? "." : "->";
+    if (gen->downward) {
+        buffer_printf(&gen->envs, "    struct %s__env t%zu;\n",
+            target->name, temp);
+    } else {
+        // Function values are not owned, so the environment is never freed
+        // by itself. It lives in the arena until a function whose result
+        // holds no function values returns, releasing everything allocated
+        // since it was called.
+        buffer_printf(&gen->envs, "    struct %s__env *t%zu;\n",
+            target->name, temp);
+        codegen_line(gen, "t%zu = dcrt_alloc(sizeof *t%zu);", temp, temp);
+        gen->arena_left = true;
+        gen->uses_arena = true;
+    }
+    codegen_line(gen, "t%zu%sclosure.code = %s__code;",
+        temp, member, target->name);
+    for (size_t i = 0; i < num_captures; i++) {
+        if (!erased[i]) {
+            const char *name =
+                symbol_mangled(target->lambda->lambda.param_names[i]);
+            codegen_line(gen, "t%zu%sv_%s = v_%s;", temp, member, name, name);
+        }
+    }
+    buffer_printf(out, "(&t%zu%sclosure)", temp, member);
+    return true;
+}
+
+/***** Expressions ***********************************************************/
+
+/* Expressions are generated in a given representation, which matters for
+ * packs since records with dependent fields may lower differently to the
+ * types inferred for their packs. When it is NULL, the representation of the
+ * expression's own type is used.
+ */
+static bool codegen_assign(Codegen *gen, const Expr *expr,
+    const char *c_type, const char *dest);
+
+/* Whether generating an expression requires statements, in which case it
+ * cannot be evaluated conditionally within a C expression.
+ */
+static bool codegen_needs_stmt(const Expr *expr) {
+    switch (expr->tag) {
+      case EXPR_NAT_IND:
+      case EXPR_EXPLODE:
+        return true;
+
+      case EXPR_CALL:
+        if (codegen_needs_stmt(expr->call.func)) {
+            return true;
+        }
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            if (codegen_needs_stmt(&expr->call.args[i])) {
+                return true;
+            }
+        }
+        return false;
+
+      case EXPR_IFTHENELSE:
+        return codegen_needs_stmt(expr->ifthenelse.predicate)
+            || codegen_needs_stmt(expr->ifthenelse.then_)
+            || codegen_needs_stmt(expr->ifthenelse.else_);
+
+      case EXPR_SUBSTITUTE:
+        return codegen_needs_stmt(expr->substitute.instance);
+
+      case EXPR_PACK:
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            if (codegen_needs_stmt(&expr->pack.field_values[i])) {
+                return true;
+            }
+        }
+        return false;
+
+      case EXPR_ACCESS:
+        return codegen_needs_stmt(expr->access.record);
+
+      default:
+        return false;
+    }
+}
+
+/* Evaluate an expression into a fresh temporary, writing the temporary's
+ * name to out.
+ */
+static bool codegen_hoist(Codegen *gen, const Expr *expr, const char *c_type,
+        Buffer *out) {
+    Lowering lowering = c_type != NULL
+        ? LOWER_OK : codegen_type_of(gen, expr, &c_type);
+    if (lowering == LOWER_ERASED) {
+        return codegen_unsupported(gen, expr, "its value is erased");
+    } else if (lowering == LOWER_FAILED) {
+        return false;
+    }
+
+    Buffer temp = buffer_new();
+    buffer_printf(&temp, "t%zu", gen->next_temp);
+    gen->next_temp += 1;
+
+    codegen_line(gen, "%s %s;", c_type, buffer_str(&temp));
+    bool ret_val = codegen_assign(gen, expr, c_type, buffer_str(&temp));
+    buffer_printf(out, "%s", buffer_str(&temp));
+    buffer_free(&temp);
+    return ret_val;
+}
+
+static bool codegen_rvalue(Codegen *gen, const Expr *expr,
+    const char *c_type, Buffer *out);
+
+/* Write a C expression for the elements of a vector, which is an array if
+ * its length is static and a pointer otherwise. The vector is first held in
+ * a variable, so that the elements can be indexed repeatedly.
+ */
+static bool codegen_elements(Codegen *gen, const Expr *expr,
+        const char *c_type, Buffer *out) {
+    bool is_static;
+    if (!codegen_is_vector(gen, c_type, &is_static)) {
+        return codegen_unsupported(gen, expr, "it is not a vector");
+    }
+
+    if (expr->tag == EXPR_IDENT) {
+        buffer_printf(out, "v_%s", symbol_mangled(expr->ident));
+    } else if (!codegen_hoist(gen, expr, c_type, out)) {
+        return false;
+    }
+
+    if (is_static) {
+        buffer_printf(out, ".at");
+    }
+    return true;
+}
+
+/* Define the static inline function a builtin is lowered to, taking and
+ * returning uint64_t or bool, unless it is defined already.
+ */
+static void codegen_builtin_define(Codegen *gen, size_t global) {
+    static const char *const param_names[] = {"x", "y"};
+    const SymbolTable *symbols = &gen->ctx->symbol_table;
+    const Builtin *builtin = builtin_lookup(symbols, global);
+    const char *ret_type = builtin->ret_type == EXPR_BOOL ? "bool" : "uint64_t";
+
+    if (gen->builtins_defined[global]) {
+        return;
+    }
+
+    // Overflow aborts unless the including code says otherwise, as the JIT
+    // does to report it to the type checker.
+    bool overflow_defined = false;
+    for (size_t i = 0; i < symbols->num_builtins; i++) {
+        overflow_defined = overflow_defined || (gen->builtins_defined[i]
+            && builtin_lookup(symbols, i)->may_overflow);
+    }
+    if (builtin->may_overflow && !overflow_defined) {
+        buffer_printf(&gen->builtins, "#ifndef dc_overflow\n"
+            "#define dc_overflow() abort()\n"
+            "#endif\n");
+    }
+
+    buffer_printf(&gen->builtins, "static inline %s dc_%s(", ret_type,
+        builtin->name);
+    for (size_t i = 0; i < builtin->num_params; i++) {
+        buffer_printf(&gen->builtins, "%suint64_t %s", i == 0 ? "" : ", ",
+            param_names[i]);
+    }
+    buffer_printf(&gen->builtins, ") { return %s; }\n", builtin->c_body);
+    gen->builtins_defined[global] = true;
+}
+
+/* Add the function standing for a builtin used as a value, whose closure
+ * calls the builtin's static inline function. It is the eta expansion of the
+ * builtin, so that it is represented like any other global.
+ */
+static size_t codegen_builtin_function(Codegen *gen, size_t global) {
+    Context *ctx = gen->ctx;
+    codegen_builtin_define(gen, global);
+    if (gen->global_functions[global] != SIZE_MAX) {
+        return gen->global_functions[global];
+    }
+
+    const Expr *type = &ctx->symbol_table.global_types[global];
+    size_t num_params = type->forall.num_params;
+    Expr lambda = {
+          .tag = EXPR_LAMBDA
+        , .well_typed = true
+        , .lambda.num_params = num_params
+    };
+    Expr call = {
+          .tag = EXPR_CALL
+        , .well_typed = true
+        , .call.num_args = num_params
+    };
+    alloc_array(lambda.lambda.param_types, num_params);
+    alloc_array(lambda.lambda.param_names, num_params);
+    alloc_array(call.call.args, num_params);
+    alloc_assign(call.call.func, ((Expr){
+          .tag = EXPR_GLOBAL
+        , .well_typed = true
+        , .global = global
+    }));
+    for (size_t i = 0; i < num_params; i++) {
+        lambda.lambda.param_types[i] =
+            expr_copy(ctx, &type->forall.param_types[i]);
+        lambda.lambda.param_names[i] = type->forall.param_names[i];
+        call.call.args[i] = (Expr){
+              .tag = EXPR_IDENT
+            , .well_typed = true
+            , .ident = type->forall.param_names[i]
+        };
+    }
+    alloc_assign(lambda.lambda.body, call);
+
+    Buffer name = buffer_new();
+    buffer_printf(&name, "dc_%s", symbol_name(
+        ctx->symbol_table.global_names[global]));
+    size_t function = codegen_add_function(gen, global, name.data,
+        expr_copy(ctx, type), lambda, NULL);
+
+    // Its body is the builtin's, so only its closure is generated.
+    if (gen->functions[function].status == FUNCTION_QUEUED) {
+        gen->functions[function].status = FUNCTION_DONE;
+    }
+    gen->global_functions[global] = function;
+    return function;
+}
+
+/* Call a builtin through the static inline function it is lowered to. */
+static bool codegen_builtin_call(Codegen *gen, const Builtin *builtin,
+        const Expr *expr, Buffer *out) {
+    codegen_builtin_define(gen, expr->call.func->global);
+    buffer_printf(out, "dc_%s(", builtin->name);
+    for (size_t i = 0; i < expr->call.num_args; i++) {
+        buffer_printf(out, "%s", i == 0 ? "" : ", ");
+        if (!codegen_rvalue(gen, &expr->call.args[i], "uint64_t", out)) {
+            return false;
+        }
+    }
+    buffer_printf(out, ")");
+    return true;
+}
+
+static bool codegen_call(Codegen *gen, const Expr *expr, Buffer *out) {
+    assert(expr->tag == EXPR_CALL);
+    const Expr *func = expr->call.func;
+    size_t num_args = expr->call.num_args;
+    bool ret_val = false;
+
+    const Builtin *builtin = func->tag == EXPR_GLOBAL
+        ? builtin_lookup(&gen->ctx->symbol_table, func->global) : NULL;
+    if (builtin != NULL) {
+        return codegen_builtin_call(gen, builtin, expr, out);
+    }
+
+    bool *erased = NULL;
+    const char **param_types = NULL;
+    const char *ret_type = NULL;
+    Expr func_type[1] = {literal_expr_type};
+
+    // Closures passed to a call whose result holds no functions cannot
+    // outlive it.
+    bool downward = gen->downward;
+    bool first = true;
+    size_t num_captures = 0;
+
+    size_t function = SIZE_MAX;
+    if (func->tag == EXPR_GLOBAL) {
+        if (!codegen_callee(gen, expr, true, &function)
+                || !codegen_function_ref(gen, func, function)) {
+            return false;
+        }
+        buffer_printf(out, "%s(", gen->functions[function].name);
+    } else if (func->tag == EXPR_LAMBDA) {
+        // Local functions called where they are written are called directly,
+        // passing the locals they capture.
+        if (!codegen_lift(gen, func, &function)) {
+            return false;
+        }
+        const struct Function *lifted = &gen->functions[function];
+        buffer_printf(out, "%s(", lifted->name);
+        num_captures = lifted->num_captures;
+        for (size_t i = 0; i < num_captures; i++) {
+            if (!lifted->erased[i]) {
+                buffer_printf(out, "%sv_%s", first ? "" : ", ",
+                    symbol_mangled(lifted->lambda->lambda.param_names[i]));
+                first = false;
+            }
+        }
+    } else {
+        // Calls through function values erase the same parameters as the
+        // function pointer type does.
+        Expr inferred;
+        if (!type_infer(gen->ctx, func, &inferred)) {
+            return false;
+        }
+        bool evaluated =
+            codegen_eval(gen, &inferred, func_type);
+        expr_free(gen->ctx, &inferred);
+        if (!evaluated || func_type->tag != EXPR_FORALL
+                || func_type->forall.num_params != num_args) {
+            codegen_unsupported(gen, expr, "the function has no known type");
+            goto end_of_function;
+        }
+
+        alloc_array(erased, num_args);
+        alloc_array(param_types, num_args);
+        Lowering lowering = codegen_signature(gen, func_type,
+            erased, param_types, &ret_type);
+        if (lowering == LOWER_ERASED) {
+            codegen_unsupported(gen, expr, "its value is erased");
+            goto end_of_function;
+        } else if (lowering == LOWER_FAILED) {
+            goto end_of_function;
+        }
+
+        // The closure is passed to its own code.
+        Buffer closure = buffer_new();
+        gen->downward = downward || !codegen_holds_pointers(gen, ret_type);
+        bool hoisted = func->tag == EXPR_IDENT
+            ? codegen_rvalue(gen, func, NULL, &closure)
+            : codegen_hoist(gen, func, NULL, &closure);
+        gen->downward = downward;
+        if (hoisted) {
+            buffer_printf(out, "%s->code(%s", buffer_str(&closure),
+                buffer_str(&closure));
+            first = false;
+        }
+        buffer_free(&closure);
+        if (!hoisted) {
+            goto end_of_function;
+        }
+    }
+
+    const bool *arg_erased = erased != NULL
+        ? erased : gen->functions[function].erased + num_captures;
+    const char *const *arg_types = param_types != NULL
+        ? param_types : gen->functions[function].param_types + num_captures;
+    const char *call_type = param_types != NULL
+        ? ret_type : gen->functions[function].ret_type;
+    gen->downward = downward || !codegen_holds_pointers(gen, call_type);
+    if (codegen_holds_pointers(gen, call_type)) {
+        // The callee may return environments it allocated in the arena.
+        gen->arena_left = true;
+    }
+
+    for (size_t i = 0; i < num_args; i++) {
+        const Expr *arg = &expr->call.args[i];
+        if (arg_erased[i]) {
+            continue;
+        }
+        buffer_printf(out, "%s", first ? "" : ", ");
+        first = false;
+
+        // Arrays of static length are passed where the length is unknown
+        // by pointing at their elements, provided the result cannot point
+        // at them too.
+        const char *arg_type;
+        bool param_static, arg_static, ret_static;
+        if (codegen_is_vector(gen, arg_types[i], &param_static)
+                && !param_static
+                && codegen_type_of(gen, arg, &arg_type) == LOWER_OK
+                && codegen_is_vector(gen, arg_type, &arg_static)
+                && arg_static) {
+            if (codegen_is_vector(gen, call_type, &ret_static)
+                    && !ret_static) {
+                codegen_unsupported(gen, expr, "its result may point into "
+                    "a temporary array");
+                goto end_of_function;
+            } else if (!codegen_elements(gen, arg, arg_type, out)) {
+                goto end_of_function;
+            }
+        } else if (!codegen_rvalue(gen, arg, arg_types[i], out)) {
+            goto end_of_function;
+        }
+    }
+    buffer_printf(out, ")");
+    ret_val = true;
+
+end_of_function:
+    gen->downward = downward;
+    dealloc(erased);
+    dealloc(param_types);
+    expr_free(gen->ctx, func_type);
+    return ret_val;
+}
+
+/* Write the value of a field of a pack, which is stored in a struct member
+ * of the given type.
+ */
+static bool codegen_member(Codegen *gen, const Expr *value,
+        const char *member, Buffer *out) {
+    const char *c_type;
+    Lowering lowering = codegen_type_of(gen, value, &c_type);
+    if (lowering == LOWER_FAILED) {
+        return false;
+    } else if (lowering == LOWER_ERASED) {
+        // The member is storage for a branch which was not taken.
+        buffer_printf(out, "(%s){ 0 }", member);
+        return true;
+    }
+
+    const struct NamedType *named = codegen_find_named(gen, member);
+    if (named == NULL || named->then_type == NULL
+            || strcmp(c_type, member) == 0) {
+        return codegen_rvalue(gen, value, member, out);
+    }
+
+    // Pick the branch of the union whose representation matches.
+    const char *branch;
+    if (strcmp(c_type, named->then_type) == 0) {
+        branch = "then_";
+    } else if (strcmp(c_type, named->else_type) == 0) {
+        branch = "else_";
+    } else {
+        return codegen_unsupported(gen, value, "its representation matches "
+            "neither branch of the field");
+    }
+
+    buffer_printf(out, "((%s){ .%s = ", member, branch);
+    if (!codegen_rvalue(gen, value, c_type, out)) {
+        return false;
+    }
+    buffer_printf(out, " })");
+    return true;
+}
+
+/* Write the value of a payload whose member also stores a Bool field. */
+static bool codegen_niche(Codegen *gen, const Expr *tag, const Expr *payload,
+        const FieldRep *field, Buffer *out) {
+    const char *c_type;
+    Lowering lowering = codegen_type_of(gen, payload, &c_type);
+    if (lowering == LOWER_FAILED) {
+        return false;
+    } else if (lowering == LOWER_ERASED) {
+        // Only an absent payload carries no information.
+        buffer_printf(out, "%s", field->sentinel);
+        return true;
+    }
+
+    buffer_printf(out, "(%s(", field->present_when ? "" : "!");
+    if (!codegen_rvalue(gen, tag, "bool", out)) {
+        return false;
+    }
+    buffer_printf(out, ") ? (%s)(", field->member);
+    if (!codegen_rvalue(gen, payload, field->c_type, out)) {
+        return false;
+    }
+    buffer_printf(out, ") : %s)", field->sentinel);
+    return true;
+}
+
+/* Write a vector of static length, flattening nested packs into its
+ * elements.
+ */
+static bool codegen_array_pack(Codegen *gen, const Expr *expr,
+        const char *c_type, const char *elem_type, uint64_t length,
+        Buffer *out) {
+    bool ret_val = true;
+    const Expr *rest = expr;
+    Buffer tail = buffer_new(); // Holds the remaining elements, if any.
+    uint64_t tail_start = 0;
+
+    buffer_printf(out, "((%s){ .at = {", c_type);
+    for (uint64_t i = 0; ret_val && i < length; i++) {
+        buffer_printf(out, "%s", i == 0 ? " " : ", ");
+
+        if (tail.len == 0 && rest->tag == EXPR_PACK
+                && rest->pack.num_fields == 2) {
+            ret_val = codegen_rvalue(gen, &rest->pack.field_values[0],
+                elem_type, out);
+            rest = &rest->pack.field_values[1];
+            continue;
+        }
+
+        const char *tail_type;
+        if (tail.len == 0) {
+            tail_start = i;
+            ret_val = codegen_type_of(gen, rest, &tail_type) == LOWER_OK
+                && codegen_elements(gen, rest, tail_type, &tail);
+        }
+        if (ret_val) {
+            buffer_printf(out, "%s[%" PRIu64 "]", buffer_str(&tail),
+                i - tail_start);
+        }
+    }
+    buffer_printf(out, " } })");
+
+    buffer_free(&tail);
+    return ret_val;
+}
+
+/* Write a record whose layout depends upon its fields, by calling its
+ * constructor with the values of the statically placed fields and the
+ * elements of the others.
+ */
+static bool codegen_dynamic_pack(Codegen *gen, const Expr *expr,
+        const char *c_type, Buffer *out) {
+    struct NamedType *named = codegen_find_named(gen, c_type);
+    if (named->constructor != NULL) {
+        buffer_printf(&gen->types, "%s", named->constructor);
+        dealloc(named->constructor);
+        named->constructor = NULL;
+    }
+    gen->arena_left = true;
+    gen->uses_arena = true;
+
+    // These outlive named, which naming other types may move.
+    size_t num_fields = named->num_fields;
+    const FieldRep *fields = named->fields;
+    const size_t *offsets = named->offsets;
+
+    bool ret_val = true;
+    bool first = true;
+    buffer_printf(out, "%s_new(", c_type);
+    for (size_t i = 0; ret_val && i < num_fields; i++) {
+        const Expr *value = &expr->pack.field_values[i];
+        const char *value_type;
+        if (fields[i].c_type == NULL) {
+            continue;
+        }
+        buffer_printf(out, "%s", first ? "" : ", ");
+        first = false;
+
+        if (offsets[i] != SIZE_MAX) {
+            ret_val = codegen_rvalue(gen, value, fields[i].c_type, out);
+        } else {
+            ret_val = codegen_type_of(gen, value, &value_type) == LOWER_OK
+                && codegen_elements(gen, value, value_type, out);
+        }
+    }
+    buffer_printf(out, ")");
+    return ret_val;
+}
+
+static bool codegen_pack(Codegen *gen, const Expr *expr, const char *c_type,
+        Buffer *out) {
+    assert(expr->tag == EXPR_PACK);
+
+    Lowering lowering = c_type != NULL
+        ? LOWER_OK : codegen_type_of(gen, expr, &c_type);
+    if (lowering == LOWER_ERASED) {
+        return codegen_unsupported(gen, expr, "its value is erased");
+    } else if (lowering == LOWER_FAILED) {
+        return false;
+    }
+
+    const struct NamedType *named = codegen_find_named(gen, c_type);
+    if (named != NULL && named->offsets != NULL
+            && named->num_fields == expr->pack.num_fields) {
+        return codegen_dynamic_pack(gen, expr, c_type, out);
+    } else if (named != NULL && named->elem_type != NULL) {
+        if (named->length == 0) {
+            return codegen_unsupported(gen, expr, "vectors whose length is "
+                "unknown cannot be constructed");
+        }
+        return codegen_array_pack(gen, expr, c_type, named->elem_type,
+            named->length, out);
+    } else if (named == NULL || named->num_fields != expr->pack.num_fields) {
+        return codegen_unsupported(gen, expr, "it is not a record");
+    }
+    const FieldRep *fields = named->fields;
+
+    buffer_printf(out, "((%s){", c_type);
+    bool first = true;
+    for (size_t i = 0; i < expr->pack.num_fields; i++) {
+        const Expr *value = &expr->pack.field_values[i];
+        if (fields[i].member == NULL) {
+            continue;
+        }
+
+        buffer_printf(out, "%s.f%zu = ", first ? " " : ", ", fields[i].slot);
+        first = false;
+
+        if (fields[i].tag != i) {
+            if (!codegen_niche(gen, &expr->pack.field_values[fields[i].tag],
+                    value, &fields[i], out)) {
+                return false;
+            }
+        } else if (!codegen_member(gen, value, fields[i].member, out)) {
+            return false;
+        }
+    }
+    buffer_printf(out, " })");
+
+    return true;
+}
+
+/* Write a C expression reading the head or tail of a vector. Chains of
+ * tails are indexed directly, so a[1][1][0] reads the third element of a.
+ */
+static bool codegen_vector_access(Codegen *gen, const Expr *expr,
+        Buffer *out) {
+    assert(expr->tag == EXPR_ACCESS);
+
+    const Expr *vector = expr->access.record;
+    uint64_t index = expr->access.field_num;
+    const char *c_type;
+    bool is_static;
+    if (codegen_type_of(gen, vector, &c_type) != LOWER_OK) {
+        return false;
+    }
+
+    while (vector->tag == EXPR_ACCESS && vector->access.field_num == 1) {
+        const char *outer_type;
+        if (codegen_type_of(gen, vector->access.record, &outer_type)
+                    != LOWER_OK
+                || !codegen_is_vector(gen, outer_type, &is_static)) {
+            break;
+        }
+        vector = vector->access.record;
+        c_type = outer_type;
+        index += 1;
+    }
+
+    Buffer elements = buffer_new();
+    bool ret_val = codegen_elements(gen, vector, c_type, &elements);
+
+    if (!ret_val) {
+        // Already reported.
+    } else if (expr->access.field_num == 0) {
+        buffer_printf(out, "%s[%" PRIu64 "]", buffer_str(&elements), index);
+    } else if (codegen_type_of(gen, expr, &c_type) != LOWER_OK
+            || !codegen_is_vector(gen, c_type, &is_static)) {
+        ret_val = false;
+    } else if (!is_static) {
+        buffer_printf(out, "(%s + %" PRIu64 ")", buffer_str(&elements),
+            index);
+    } else {
+        // Copy the remaining elements into an array of their own.
+        uint64_t length = codegen_find_named(gen, c_type)->length;
+        buffer_printf(out, "((%s){ .at = {", c_type);
+        for (uint64_t i = 0; i < length; i++) {
+            buffer_printf(out, "%s%s[%" PRIu64 "]", i == 0 ? " " : ", ",
+                buffer_str(&elements), index + i);
+        }
+        buffer_printf(out, " } })");
+    }
+
+    buffer_free(&elements);
+    return ret_val;
+}
+
+/* Write a C expression reading a field of a record whose layout depends
+ * upon its fields. Fields placed after the dynamically sized ones are found
+ * by reading the record, so it is first held in a variable.
+ */
+static bool codegen_dynamic_access(Codegen *gen, const Expr *expr,
+        const char *c_type, Buffer *out) {
+    const struct NamedType *named = codegen_find_named(gen, c_type);
+    size_t field_num = expr->access.field_num;
+    const char *field_type = named->fields[field_num].c_type;
+    size_t offset = named->offsets[field_num];
+    if (field_type == NULL) {
+        return codegen_unsupported(gen, expr, "its value is erased");
+    }
+
+    Buffer record = buffer_new();
+    bool ret_val = expr->access.record->tag == EXPR_IDENT
+        ? codegen_rvalue(gen, expr->access.record, c_type, &record)
+        : codegen_hoist(gen, expr->access.record, c_type, &record);
+
+    if (!ret_val) {
+        // Already reported.
+    } else if (offset != SIZE_MAX) {
+        buffer_printf(out, "(*(const %s *)(%s + %zu))", field_type,
+            buffer_str(&record), offset);
+    } else {
+        buffer_printf(out, "((%s)(%s + %s_offset_%zu(%s)))", field_type,
+            buffer_str(&record), c_type, field_num, buffer_str(&record));
+    }
+
+    buffer_free(&record);
+    return ret_val;
+}
+
+/* Write a C expression reading a field of a record. */
+static bool codegen_access(Codegen *gen, const Expr *expr, Buffer *out) {
+    assert(expr->tag == EXPR_ACCESS);
+    size_t field_num = expr->access.field_num;
+
+    const char *c_type;
+    bool is_static;
+    if (codegen_type_of(gen, expr->access.record, &c_type) != LOWER_OK) {
+        return false;
+    } else if (codegen_is_vector(gen, c_type, &is_static)) {
+        return codegen_vector_access(gen, expr, out);
+    }
+
+    const struct NamedType *named = codegen_find_named(gen, c_type);
+    if (named == NULL || field_num >= named->num_fields) {
+        return codegen_unsupported(gen, expr, "it is not a record");
+    } else if (named->offsets != NULL) {
+        return codegen_dynamic_access(gen, expr, c_type, out);
+    }
+    FieldRep field = named->fields[field_num];
+    const FieldRep *payload = &named->fields[field.stored_in];
+
+    Buffer record = buffer_new();
+    bool ret_val = codegen_rvalue(gen, expr->access.record, c_type, &record);
+
+    if (!ret_val) {
+        // Already reported.
+    } else if (field.stored_in != field_num) {
+        // The tag is recovered from whether the payload is present.
+        buffer_printf(out, "((%s).f%zu %s %s)", buffer_str(&record),
+            payload->slot, payload->present_when ? "!=" : "==",
+            payload->sentinel);
+    } else if (field.tag != field_num) {
+        buffer_printf(out, "((%s)(%s).f%zu)", field.c_type,
+            buffer_str(&record), field.slot);
+    } else {
+        buffer_printf(out, "(%s).f%zu", buffer_str(&record), field.slot);
+    }
+
+    buffer_free(&record);
+    return ret_val;
+}
+
+/* Write a C expression computing the value of an expression to out. Any
+ * statements it needs first are added to the current function body.
+ */
+static bool codegen_rvalue(Codegen *gen, const Expr *expr,
+        const char *c_type, Buffer *out) {
+    switch (expr->tag) {
+      case EXPR_IDENT:
+        buffer_printf(out, "v_%s", symbol_mangled(expr->ident));
+        return true;
+
+      case EXPR_GLOBAL: {
+        size_t function = builtin_lookup(&gen->ctx->symbol_table,
+            expr->global) != NULL
+            ? codegen_builtin_function(gen, expr->global)
+            : gen->global_functions[expr->global];
+        if (function == SIZE_MAX) {
+            return codegen_unsupported(gen, expr,
+                codegen_is_polymorphic(gen, expr->global)
+                    ? "polymorphic functions are only specialized when called"
+                    : "it could not be generated");
+        } else if (!codegen_function_ref(gen, expr, function)) {
+            return false;
+        }
+        return codegen_closure(gen, expr, function, c_type, out);
+      }
+
+      case EXPR_BOOLEAN:
+        buffer_printf(out, expr->boolean ? "true" : "false");
+        return true;
+
+      case EXPR_NATURAL:
+        if (!natural_is_small(&expr->natural)) {
+            return codegen_unsupported(gen, expr,
+                "naturals are 64 bits at runtime");
+        }
+        buffer_printf(out, "UINT64_C(%" PRIu64 ")", expr->natural.small);
+        return true;
+
+      case EXPR_CALL:
+        return codegen_call(gen, expr, out);
+
+      case EXPR_IFTHENELSE:
+        if (codegen_needs_stmt(expr->ifthenelse.then_)
+                || codegen_needs_stmt(expr->ifthenelse.else_)) {
+            return codegen_hoist(gen, expr, c_type, out);
+        }
+        buffer_printf(out, "(");
+        if (!codegen_rvalue(gen, expr->ifthenelse.predicate, "bool", out)) {
+            return false;
+        }
+        buffer_printf(out, " ? ");
+        if (!codegen_rvalue(gen, expr->ifthenelse.then_, c_type, out)) {
+            return false;
+        }
+        buffer_printf(out, " : ");
+        if (!codegen_rvalue(gen, expr->ifthenelse.else_, c_type, out)) {
+            return false;
+        }
+        buffer_printf(out, ")");
+        return true;
+
+      case EXPR_NAT_IND:
+      case EXPR_EXPLODE:
+        return codegen_hoist(gen, expr, c_type, out);
+
+      case EXPR_SUBSTITUTE:
+        // The proof is erased, leaving the instance unchanged.
+        return codegen_rvalue(gen, expr->substitute.instance, c_type, out);
+
+      case EXPR_PACK:
+        return codegen_pack(gen, expr, c_type, out);
+
+      case EXPR_ACCESS:
+        return codegen_access(gen, expr, out);
+
+      case EXPR_LAMBDA: {
+        size_t function;
+        return codegen_lift(gen, expr, &function)
+            && codegen_closure(gen, expr, function, c_type, out);
+      }
+
+      default:
+        return codegen_unsupported(gen, expr, "its value is erased");
+    }
+}
+
+/* Whether a call is to the current function, and can jump back to its start
+ * with the parameters replaced rather than using more stack. The parameters
+ * must not be shadowed where the call is made.
+ */
+static bool codegen_is_tail_call(Codegen *gen, const Expr *expr) {
+    assert(expr->tag == EXPR_CALL);
+    const struct Function *current = &gen->functions[gen->current];
+    const Expr *lambda = current->lambda;
+    size_t function;
+
+    if (expr->call.func->tag != EXPR_GLOBAL
+            || expr->call.func->global != current->global
+            || expr->call.num_args != lambda->lambda.num_params
+            || !codegen_callee(gen, expr, false, &function)
+            || function != gen->current) {
+        return false;
+    }
+
+    for (size_t i = 0; i < lambda->lambda.num_params; i++) {
+        for (size_t j = 0; j < gen->num_bound; j++) {
+            if (gen->bound[j] == lambda->lambda.param_names[i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool codegen_tail_call(Codegen *gen, const Expr *expr) {
+    const Expr *lambda = gen->functions[gen->current].lambda;
+    size_t num_params = lambda->lambda.num_params;
+    const bool *erased = gen->functions[gen->current].erased;
+    const char *const *param_types = gen->functions[gen->current].param_types;
+    bool ret_val = true;
+
+    // Every argument is evaluated before any parameter is replaced. The
+    // parameters outlive the environments of closures created here, which
+    // are reused when the call jumps back.
+    bool downward = gen->downward;
+    gen->downward = false;
+    size_t *temps;
+    alloc_array(temps, num_params);
+    Buffer value = buffer_new();
+    for (size_t i = 0; ret_val && i < num_params; i++) {
+        const Expr *arg = &expr->call.args[i];
+        if (erased[i] || (arg->tag == EXPR_IDENT
+                && arg->ident == lambda->lambda.param_names[i])) {
+            continue;
+        }
+
+        value.len = 0;
+        ret_val = codegen_rvalue(gen, arg, param_types[i], &value);
+        temps[i] = gen->next_temp;
+        gen->next_temp += 1;
+        codegen_line(gen, "%s t%zu = %s;", param_types[i], temps[i],
+            buffer_str(&value));
+    }
+
+    for (size_t i = 0; ret_val && i < num_params; i++) {
+        const Expr *arg = &expr->call.args[i];
+        if (!erased[i] && (arg->tag != EXPR_IDENT
+                || arg->ident != lambda->lambda.param_names[i])) {
+            codegen_line(gen, "v_%s = t%zu;",
+                symbol_mangled(lambda->lambda.param_names[i]), temps[i]);
+        }
+    }
+
+    if (ret_val) {
+        codegen_line(gen, "goto tail_call;");
+        gen->tail_called = true;
+    }
+
+    gen->downward = downward;
+    buffer_free(&value);
+    dealloc(temps);
+    return ret_val;
+}
+
+/* Add statements to the current function body which store the value of an
+ * expression in dest, or return it if dest is NULL.
+ */
+static bool codegen_assign(Codegen *gen, const Expr *expr,
+        const char *c_type, const char *dest) {
+    SymbolTable *symbols = &gen->ctx->symbol_table;
+    Buffer value = buffer_new();
+    bool ret_val = false;
+
+    switch (expr->tag) {
+      case EXPR_IFTHENELSE:
+        if (!codegen_rvalue(gen, expr->ifthenelse.predicate, "bool",
+                &value)) {
+            break;
+        }
+        codegen_line(gen, "if (%s) {", buffer_str(&value));
+        gen->indent += 1;
+        if (!codegen_assign(gen, expr->ifthenelse.then_, c_type, dest)) {
+            break;
+        }
+        gen->indent -= 1;
+        codegen_line(gen, "} else {");
+        gen->indent += 1;
+        if (!codegen_assign(gen, expr->ifthenelse.else_, c_type, dest)) {
+            break;
+        }
+        gen->indent -= 1;
+        codegen_line(gen, "}");
+        ret_val = true;
+        break;
+
+      case EXPR_NAT_IND: {
+        if (!codegen_rvalue(gen, expr->nat_ind.natural, "uint64_t",
+                &value)) {
+            break;
+        }
+        size_t temp = gen->next_temp;
+        gen->next_temp += 1;
+
+        codegen_line(gen, "uint64_t t%zu = %s;", temp, buffer_str(&value));
+        codegen_line(gen, "if (t%zu == %s) {", temp,
+            expr->nat_ind.goes_down ? "UINT64_C(0)" : "UINT64_MAX");
+        gen->indent += 1;
+        if (!codegen_assign(gen, expr->nat_ind.base_val, c_type, dest)) {
+            break;
+        }
+        gen->indent -= 1;
+        codegen_line(gen, "} else {");
+        gen->indent += 1;
+        codegen_line(gen, "uint64_t v_%s = t%zu %c 1;",
+            symbol_mangled(expr->nat_ind.ind_name), temp,
+            expr->nat_ind.goes_down ? '-' : '+');
+
+        symbol_table_enter_scope(symbols);
+        symbol_table_register_local(symbols,
+            expr->nat_ind.ind_name, literal_expr_nat);
+        codegen_bind(gen, expr->nat_ind.ind_name);
+        bool ind_ok = codegen_assign(gen, expr->nat_ind.ind_val,
+            c_type, dest);
+        codegen_unbind(gen);
+        symbol_table_leave_scope(symbols);
+        if (!ind_ok) {
+            break;
+        }
+
+        gen->indent -= 1;
+        codegen_line(gen, "}");
+        ret_val = true;
+        break;
+      }
+
+      case EXPR_EXPLODE:
+        // Unreachable, since there are no values of Void.
+        codegen_line(gen, "abort();");
+        ret_val = true;
+        break;
+
+      case EXPR_SUBSTITUTE:
+        ret_val = codegen_assign(gen, expr->substitute.instance,
+            c_type, dest);
+        break;
+
+      case EXPR_CALL:
+        if (dest == NULL && codegen_is_tail_call(gen, expr)) {
+            ret_val = codegen_tail_call(gen, expr);
+            break;
+        }
+        // Fall through.
+
+      default:
+        if (!codegen_rvalue(gen, expr, c_type, &value)) {
+            break;
+        }
+        if (dest == NULL) {
+            codegen_line(gen, "return %s;", buffer_str(&value));
+        } else {
+            codegen_line(gen, "%s = %s;", dest, buffer_str(&value));
+        }
+        ret_val = true;
+        break;
+    }
+
+    buffer_free(&value);
+    return ret_val;
+}
+
+/***** Loops *****************************************************************/
+
+/* A function whose body is induction on one of its parameters, where the
+ * inductive case only calls the function itself on the predecessor (or the
+ * successor, when inducting upwards) with its other parameters unchanged.
+ * Every such call stands for the result of the previous step, so the function
+ * can be computed by a loop from the base case which accumulates the result,
+ * using constant stack.
+ */
+typedef struct {
+    size_t global;
+    size_t function;
+    const Expr *lambda;
+    size_t param;       // The parameter being inducted upon.
+    const char *ind_name;
+    const char *acc;    // The local replacing the calls, or NULL if calls
+                        // are not allowed.
+    size_t num_calls;
+} Fold;
+
+static bool codegen_fold_shadows(const Fold *fold, const char *name) {
+    if (name == fold->ind_name) {
+        return true;
+    }
+    for (size_t i = 0; i < fold->lambda->lambda.num_params; i++) {
+        if (name == fold->lambda->lambda.param_names[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Whether a call passes the predecessor and otherwise the parameters, apart
+ * from the erased ones.
+ */
+static bool codegen_fold_args(Codegen *gen, const Expr *call,
+        const Fold *fold) {
+    const Expr *lambda = fold->lambda;
+    const bool *erased = gen->functions[fold->function].erased;
+    if (call->call.num_args != lambda->lambda.num_params) {
+        return false;
+    }
+
+    for (size_t i = 0; i < call->call.num_args; i++) {
+        const Expr *arg = &call->call.args[i];
+        if (erased[i] && i != fold->param) {
+            continue;
+        }
+        const char *expected = i == fold->param
+            ? fold->ind_name : lambda->lambda.param_names[i];
+        if (arg->tag != EXPR_IDENT || arg->ident != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Replace the calls in an inductive case by the accumulator. Fails if the
+ * function refers to itself in any other way, or if a binder shadows the
+ * names the calls are recognised by.
+ */
+static bool codegen_fold_calls(Codegen *gen, Expr *expr, Fold *fold) {
+    switch (expr->tag) {
+      case EXPR_GLOBAL:
+        return expr->global != fold->global;
+
+      case EXPR_IDENT:
+      case EXPR_TYPE:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_BOOLEAN:
+      case EXPR_NAT:
+      case EXPR_NATURAL:
+        return true;
+
+      case EXPR_FORALL:
+        for (size_t i = 0; i < expr->forall.num_params; i++) {
+            if ((expr->forall.param_names[i] != NULL
+                    && codegen_fold_shadows(fold, expr->forall.param_names[i]))
+                    || !codegen_fold_calls(gen,
+                        &expr->forall.param_types[i], fold)) {
+                return false;
+            }
+        }
+        return codegen_fold_calls(gen, expr->forall.ret_type, fold);
+
+      case EXPR_LAMBDA:
+        for (size_t i = 0; i < expr->lambda.num_params; i++) {
+            if (codegen_fold_shadows(fold, expr->lambda.param_names[i])
+                    || !codegen_fold_calls(gen,
+                        &expr->lambda.param_types[i], fold)) {
+                return false;
+            }
+        }
+        return codegen_fold_calls(gen, expr->lambda.body, fold);
+
+      case EXPR_CALL: {
+        size_t function;
+        if (fold->acc != NULL && expr->call.func->tag == EXPR_GLOBAL
+                && expr->call.func->global == fold->global) {
+            if (!codegen_callee(gen, expr, false, &function)
+                    || function != fold->function
+                    || !codegen_fold_args(gen, expr, fold)) {
+                return false;
+            }
+            expr_free(gen->ctx, expr);
+            *expr = (Expr){
+                  .tag = EXPR_IDENT
+                , .well_typed = true
+                , .ident = fold->acc
+            };
+            fold->num_calls += 1;
+            return true;
+        }
+
+        if (!codegen_fold_calls(gen, expr->call.func, fold)) {
+            return false;
+        }
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            if (!codegen_fold_calls(gen, &expr->call.args[i], fold)) {
+                return false;
+            }
+        }
+        return true;
+      }
+
+      case EXPR_ID:
+        return codegen_fold_calls(gen, expr->id.expr1, fold)
+            && codegen_fold_calls(gen, expr->id.expr2, fold);
+
+      case EXPR_REFLEXIVE:
+        return codegen_fold_calls(gen, expr->reflexive, fold);
+
+      case EXPR_SUBSTITUTE:
+        return codegen_fold_calls(gen, expr->substitute.proof, fold)
+            && codegen_fold_calls(gen, expr->substitute.family, fold)
+            && codegen_fold_calls(gen, expr->substitute.instance, fold);
+
+      case EXPR_EXPLODE:
+        return codegen_fold_calls(gen, expr->explode.void_instance, fold)
+            && codegen_fold_calls(gen, expr->explode.into_type, fold);
+
+      case EXPR_IFTHENELSE:
+        return codegen_fold_calls(gen, expr->ifthenelse.predicate, fold)
+            && codegen_fold_calls(gen, expr->ifthenelse.then_, fold)
+            && codegen_fold_calls(gen, expr->ifthenelse.else_, fold);
+
+      case EXPR_NAT_IND:
+        return codegen_fold_calls(gen, expr->nat_ind.natural, fold)
+            && codegen_fold_calls(gen, expr->nat_ind.base_val, fold)
+            && !codegen_fold_shadows(fold, expr->nat_ind.ind_name)
+            && codegen_fold_calls(gen, expr->nat_ind.ind_val, fold);
+
+      case EXPR_SIGMA:
+        for (size_t i = 0; i < expr->sigma.num_fields; i++) {
+            if ((expr->sigma.field_names[i] != NULL
+                    && codegen_fold_shadows(fold, expr->sigma.field_names[i]))
+                    || !codegen_fold_calls(gen,
+                        &expr->sigma.field_types[i], fold)) {
+                return false;
+            }
+        }
+        return true;
+
+      case EXPR_PACK:
+        if (expr->pack.as_type != NULL
+                && !codegen_fold_calls(gen, expr->pack.as_type, fold)) {
+            return false;
+        }
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            if (!codegen_fold_calls(gen, &expr->pack.field_values[i], fold)) {
+                return false;
+            }
+        }
+        return true;
+
+      case EXPR_ACCESS:
+        return codegen_fold_calls(gen, expr->access.record, fold);
+    }
+
+    return false;
+}
+
+/* Recognise a function computable by a loop, copying its base case with the
+ * parameter inducted upon replaced by its value there, and its inductive
+ * case with the calls replaced by the accumulator.
+ */
+static bool codegen_find_fold(Codegen *gen, size_t function,
+        Fold *fold, Expr *base, Expr *step) {
+    const Expr *lambda = gen->functions[function].lambda;
+    const Expr *body = lambda->lambda.body;
+    if (body->tag != EXPR_NAT_IND
+            || body->nat_ind.natural->tag != EXPR_IDENT) {
+        return false;
+    }
+
+    size_t param = 0;
+    while (param < lambda->lambda.num_params
+            && lambda->lambda.param_names[param]
+                != body->nat_ind.natural->ident) {
+        param += 1;
+    }
+    if (param == lambda->lambda.num_params) {
+        return false;
+    }
+
+    *fold = (Fold){
+          .global = gen->functions[function].global
+        , .function = function
+        , .lambda = lambda
+        , .param = param
+        , .ind_name = body->nat_ind.ind_name
+        , .acc = NULL
+        , .num_calls = 0
+    };
+
+    const Expr start = {
+          .tag = EXPR_NATURAL
+        , .well_typed = true
+        , .natural = natural_small(body->nat_ind.goes_down ? 0 : UINT64_MAX)
+    };
+    *base = expr_copy(gen->ctx, body->nat_ind.base_val);
+    expr_subst(gen->ctx, base, lambda->lambda.param_names[param], &start);
+    if (!codegen_fold_calls(gen, base, fold)) {
+        expr_free(gen->ctx, base);
+        return false;
+    }
+
+    fold->acc = symbol_fresh(&gen->ctx->fresh, "acc");
+    *step = expr_copy(gen->ctx, body->nat_ind.ind_val);
+    if (!codegen_fold_calls(gen, step, fold) || fold->num_calls == 0) {
+        expr_free(gen->ctx, base);
+        expr_free(gen->ctx, step);
+        return false;
+    }
+
+    return true;
+}
+
+/* Generate a loop computing a function recognised by codegen_find_fold. Its
+ * parameters must be in scope.
+ */
+static bool codegen_fold(Codegen *gen, const Fold *fold, const Expr *type,
+        const char *ret_type, const Expr *base, const Expr *step) {
+    Context *ctx = gen->ctx;
+    SymbolTable *symbols = &ctx->symbol_table;
+    const Expr *lambda = fold->lambda;
+    const char *param = lambda->lambda.param_names[fold->param];
+    bool goes_down = lambda->lambda.body->nat_ind.goes_down;
+
+    // The accumulator has the result type at the previous step.
+    size_t num_params = lambda->lambda.num_params;
+    Expr *renames;
+    alloc_array(renames, num_params);
+    for (size_t i = 0; i < num_params; i++) {
+        renames[i] = (Expr){
+              .tag = EXPR_IDENT
+            , .well_typed = true
+            , .ident = i == fold->param
+                ? fold->ind_name : lambda->lambda.param_names[i]
+        };
+    }
+    Expr acc_type = expr_copy(ctx, type->forall.ret_type);
+    expr_subst_many(ctx, &acc_type, num_params,
+        type->forall.param_names, renames);
+    dealloc(renames);
+
+    Buffer acc = buffer_new();
+    buffer_printf(&acc, "v_%s", symbol_mangled(fold->acc));
+    codegen_line(gen, "%s %s;", ret_type, buffer_str(&acc));
+    bool ret_val = codegen_assign(gen, base, ret_type, buffer_str(&acc));
+
+    size_t temp = gen->next_temp;
+    gen->next_temp += 1;
+    codegen_line(gen, "for (uint64_t t%zu = %s; t%zu != v_%s; t%zu%s) {",
+        temp, goes_down ? "UINT64_C(0)" : "UINT64_MAX", temp,
+        symbol_mangled(param), temp, goes_down ? "++" : "--");
+    gen->indent += 1;
+
+    SymbolSet free_vars = symbol_set_empty();
+    expr_free_vars(ctx, step, &free_vars);
+    if (symbol_set_contains(&free_vars, fold->ind_name)) {
+        codegen_line(gen, "uint64_t v_%s = t%zu;",
+            symbol_mangled(fold->ind_name), temp);
+    }
+    if (param != fold->ind_name && symbol_set_contains(&free_vars, param)) {
+        // The parameter is one more (or less) than the step's.
+        codegen_line(gen, "uint64_t v_%s = t%zu %c 1;", symbol_mangled(param),
+            temp, goes_down ? '+' : '-');
+    }
+    symbol_set_free(&free_vars);
+
+    symbol_table_enter_scope(symbols);
+    symbol_table_register_local(symbols, fold->ind_name, literal_expr_nat);
+    symbol_table_register_local(symbols, fold->acc, acc_type);
+    codegen_bind(gen, fold->ind_name);
+
+    // What a step leaves in the arena is unreachable once the step is done,
+    // unless the accumulator can hold it, so each step releases it rather
+    // than leaving every step's to the end of the function.
+    bool arena_left = gen->arena_left;
+    gen->arena_left = false;
+    Buffer body = gen->body;
+    gen->body = buffer_new();
+    ret_val = ret_val && codegen_assign(gen, step, ret_type, buffer_str(&acc));
+    Buffer step_body = gen->body;
+    gen->body = body;
+    if (gen->arena_left && !codegen_holds_pointers(gen, ret_type)) {
+        size_t mark = gen->next_temp;
+        gen->next_temp += 1;
+        codegen_line(gen, "dcrt_mark t%zu = dcrt_save();", mark);
+        buffer_printf(&gen->body, "%s", buffer_str(&step_body));
+        codegen_line(gen, "dcrt_release(t%zu);", mark);
+        gen->arena_left = arena_left;
+    } else {
+        buffer_printf(&gen->body, "%s", buffer_str(&step_body));
+        gen->arena_left = arena_left || gen->arena_left;
+    }
+    buffer_free(&step_body);
+
+    codegen_unbind(gen);
+    symbol_table_leave_scope(symbols);
+
+    gen->indent -= 1;
+    codegen_line(gen, "}");
+    codegen_line(gen, "return %s;", buffer_str(&acc));
+
+    expr_free(ctx, &acc_type);
+    buffer_free(&acc);
+    return ret_val;
+}
+
+/***** Top-Levels ************************************************************/
+
+/* Generate the body of a queued function. */
+static void codegen_function(Codegen *gen, size_t index) {
+    Context *ctx = gen->ctx;
+    SymbolTable *symbols = &ctx->symbol_table;
+    struct Function *function = &gen->functions[index];
+    const char *name = symbol_name(symbols->global_names[function->global]);
+    const Expr *type = function->type;
+    const Expr *lambda = function->lambda;
+    const bool *erased = function->erased;
+    const char *const *param_types = function->param_types;
+    const char *ret_type = function->ret_type;
+    size_t num_params = lambda->lambda.num_params;
+    assert(function->status == FUNCTION_QUEUED);
+    function->status = FUNCTION_PENDING;
+
+    Buffer proto = buffer_new();
+    buffer_printf(&proto, "%s %s(", ret_type, function->name);
+    bool first = true;
+    for (size_t i = 0; i < num_params; i++) {
+        if (!erased[i]) {
+            buffer_printf(&proto, "%s%s v_%s", first ? "" : ", ",
+                param_types[i], symbol_mangled(lambda->lambda.param_names[i]));
+            first = false;
+        }
+    }
+    buffer_printf(&proto, "%s)", first ? "void" : "");
+
+    gen->body.len = 0;
+    gen->indent = 1;
+    gen->next_temp = 0;
+    gen->current = index;
+    gen->tail_called = false;
+    gen->num_bound = 0;
+    gen->envs.len = 0;
+    gen->downward = false;
+    gen->arena_left = false;
+
+    symbol_table_enter_scope(symbols);
+    for (size_t i = 0; i < num_params; i++) {
+        symbol_table_register_local(symbols,
+            lambda->lambda.param_names[i], lambda->lambda.param_types[i]);
+    }
+
+    // Generating the body may add specializations, moving the functions.
+    Fold fold;
+    Expr base, step;
+    bool success;
+    if (codegen_find_fold(gen, index, &fold, &base, &step)) {
+        success = codegen_fold(gen, &fold, type, ret_type, &base, &step);
+        expr_free(ctx, &base);
+        expr_free(ctx, &step);
+    } else {
+        success = codegen_assign(gen, lambda->lambda.body, ret_type, NULL);
+    }
+    symbol_table_leave_scope(symbols);
+
+    if (success && gen->arena_left && !codegen_holds_pointers(gen, ret_type)) {
+        // Nothing left in the arena can be reached once this returns, so the
+        // body is wrapped in a function releasing it.
+        size_t global = gen->functions[index].global;
+        Buffer *defs = &gen->defs[global];
+        buffer_printf(&gen->protos[global], "%s;\n", buffer_str(&proto));
+        buffer_printf(defs, "static %s %s__body(", ret_type, function->name);
+        first = true;
+        for (size_t i = 0; i < num_params; i++) {
+            if (!erased[i]) {
+                buffer_printf(defs, "%s%s v_%s", first ? "" : ", ",
+                    param_types[i],
+                    symbol_mangled(lambda->lambda.param_names[i]));
+                first = false;
+            }
+        }
+        buffer_printf(defs, "%s) {\n%s%s%s}\n\n", first ? "void" : "",
+            buffer_str(&gen->envs), gen->tail_called ? "tail_call: ;\n" : "",
+            buffer_str(&gen->body));
+
+        buffer_printf(defs, "%s {\n"
+            "    dcrt_mark mark = dcrt_save();\n"
+            "    %s result = %s__body(", buffer_str(&proto), ret_type,
+            function->name);
+        first = true;
+        for (size_t i = 0; i < num_params; i++) {
+            if (!erased[i]) {
+                buffer_printf(defs, "%sv_%s", first ? "" : ", ",
+                    symbol_mangled(lambda->lambda.param_names[i]));
+                first = false;
+            }
+        }
+        buffer_printf(defs, ");\n"
+            "    dcrt_release(mark);\n"
+            "    return result;\n"
+            "}\n\n");
+    } else if (success) {
+        size_t global = gen->functions[index].global;
+        buffer_printf(&gen->protos[global], "%s;\n", buffer_str(&proto));
+        buffer_printf(&gen->defs[global],
+            "%s {\n%s%s%s}\n\n", buffer_str(&proto), buffer_str(&gen->envs),
+            gen->tail_called ? "tail_call: ;\n" : "", buffer_str(&gen->body));
+    } else {
+        fprintf(stderr, "Cannot generate C for \"%s\".\n", name);
+    }
+
+    gen->functions[index].status = success ? FUNCTION_DONE : FUNCTION_FAILED;
+    buffer_free(&proto);
+}
+
+/* Add the function lowering a global, unless it is polymorphic. */
+static bool codegen_global(Codegen *gen, size_t global, const Expr *type,
+        const Expr *lambda) {
+    Context *ctx = gen->ctx;
+    const char *name = symbol_name(ctx->symbol_table.global_names[global]);
+
+    if (type->tag != EXPR_FORALL || lambda->tag != EXPR_LAMBDA
+            || type->forall.num_params != lambda->lambda.num_params) {
+        fprintf(stderr, "Cannot generate C for \"%s\" since it is not a "
+            "function.\n", name);
+        return false;
+    } else if (codegen_is_polymorphic(gen, global)) {
+        return true;
+    }
+
+    Buffer c_name = buffer_new();
+    buffer_printf(&c_name, "dc_%s", name);
+    gen->global_functions[global] = codegen_add_function(gen, global,
+        c_name.data, expr_copy(ctx, type), expr_copy(ctx, lambda), NULL);
+    return gen->functions[gen->global_functions[global]].status
+        != FUNCTION_FAILED;
+}
+
+/* Generate the functions added since the given one, returning whether all of
+ * them could be.
+ */
+static bool codegen_queued(Codegen *gen, size_t *next_function) {
+    bool success = true;
+    for (; *next_function < gen->num_functions; *next_function += 1) {
+        if (gen->functions[*next_function].status == FUNCTION_QUEUED) {
+            codegen_function(gen, *next_function);
+        }
+        if (gen->functions[*next_function].status == FUNCTION_FAILED) {
+            success = false;
+        }
+    }
+    return success;
+}
+
+/* Lower every top-level of a translation unit, returning whether all of them
+ * could be.
+ */
+static bool codegen_generate(Codegen *gen, const TranslationUnit *unit) {
+    Context *ctx = gen->ctx;
+
+    // Functions are generated in order, each top-level followed by the
+    // specializations it needed which were not already generated.
+    bool success = true;
+    size_t next_function = 0;
+    for (size_t i = 0; i < unit->num_top_levels; i++) {
+        const TopLevel *top_level = &unit->top_levels[i];
+        size_t global;
+        if (!symbol_table_lookup_global(&ctx->symbol_table,
+                top_level->name, &global)
+                || !codegen_global(gen, global, &top_level->expr_decl.type,
+                    &top_level->expr_decl.expr)) {
+            success = false;
+        }
+
+        success = codegen_queued(gen, &next_function) && success;
+    }
+
+    return success;
+}
+
+static Codegen codegen_new(Context *ctx) {
+    size_t num_globals = ctx->symbol_table.num_globals;
+    Codegen gen = {
+          .ctx = ctx
+        , .types = buffer_new()
+        , .builtins = buffer_new()
+        , .body = buffer_new()
+        , .indent = 0
+        , .next_temp = 0
+        , .current = 0
+        , .tail_called = false
+        , .num_bound = 0
+        , .bound = NULL
+        , .envs = buffer_new()
+        , .downward = false
+        , .arena_left = false
+        , .uses_arena = false
+        , .num_functions = 0
+        , .functions = NULL
+        , .num_specializations = 0
+        , .num_named = 0
+        , .named = NULL
+    };
+    alloc_array(gen.protos, num_globals);
+    alloc_array(gen.defs, num_globals);
+    alloc_array(gen.num_refs, num_globals);
+    alloc_array(gen.refs, num_globals);
+    alloc_array(gen.global_functions, num_globals);
+    for (size_t i = 0; i < num_globals; i++) {
+        gen.protos[i] = buffer_new();
+        gen.defs[i] = buffer_new();
+        gen.num_refs[i] = 0;
+        gen.refs[i] = NULL;
+        gen.global_functions[i] = SIZE_MAX;
+    }
+    alloc_array(gen.builtins_defined, ctx->symbol_table.num_builtins);
+    for (size_t i = 0; i < ctx->symbol_table.num_builtins; i++) {
+        gen.builtins_defined[i] = false;
+    }
+    return gen;
+}
+
+static void codegen_free(Codegen *gen) {
+    Context *ctx = gen->ctx;
+
+    for (size_t i = 0; i < gen->num_functions; i++) {
+        codegen_function_free(ctx, &gen->functions[i]);
+    }
+    dealloc(gen->functions);
+    dealloc(gen->global_functions);
+    dealloc(gen->builtins_defined);
+    dealloc(gen->bound);
+    for (size_t i = 0; i < gen->num_named; i++) {
+        dealloc(gen->named[i].key);
+        dealloc(gen->named[i].name);
+        buffer_free(&gen->named[i].decl);
+        dealloc(gen->named[i].fields);
+        dealloc(gen->named[i].offsets);
+        dealloc(gen->named[i].constructor);
+    }
+    dealloc(gen->named);
+    for (size_t i = 0; i < ctx->symbol_table.num_globals; i++) {
+        buffer_free(&gen->protos[i]);
+        buffer_free(&gen->defs[i]);
+        dealloc(gen->refs[i]);
+    }
+    dealloc(gen->protos);
+    dealloc(gen->defs);
+    dealloc(gen->num_refs);
+    dealloc(gen->refs);
+    buffer_free(&gen->types);
+    buffer_free(&gen->builtins);
+    buffer_free(&gen->body);
+    buffer_free(&gen->envs);
+}
+
+static void codegen_includes(FILE *to) {
+    fputs("#include <stdbool.h>\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n\n", to);
+}
+
+/* The arena holding the environments of closures which outlive the function
+ * creating them. It is released in stack order: a function whose result
+ * holds no function values releases whatever it and its callees allocated
+ * when it returns. C code calling a function which returns a function value
+ * must do the same once it is done with the value, with
+ *
+ *     dcrt_mark mark = dcrt_save();
+ *     ... call and use the function value ...
+ *     dcrt_release(mark);
+ */
+static const char *const codegen_arena_decls =
+    "typedef struct {\n"
+    "    struct dcrt_block *block;\n"
+    "    size_t used;\n"
+    "} dcrt_mark;\n\n";
+
+static const char *const codegen_arena_protos[] = {
+      "void *dcrt_alloc(size_t size)"
+    , "dcrt_mark dcrt_save(void)"
+    , "void dcrt_release(dcrt_mark mark)"
+};
+
+static const char *const codegen_arena_defs =
+    "struct dcrt_block {\n"
+    "    struct dcrt_block *prev;\n"
+    "    size_t used;\n"
+    "    size_t cap;\n"
+    "    max_align_t data[];\n"
+    "};\n\n"
+    "/* The block allocated from, and one released block kept for reuse. */\n"
+    "static struct dcrt_block *dcrt_top = NULL;\n"
+    "static struct dcrt_block *dcrt_spare = NULL;\n\n"
+    "%svoid *dcrt_alloc(size_t size) {\n"
+    "    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t)\n"
+    "        * sizeof(max_align_t);\n"
+    "    if (dcrt_top == NULL || dcrt_top->cap - dcrt_top->used < size) {\n"
+    "        struct dcrt_block *block = dcrt_spare;\n"
+    "        if (block == NULL || block->cap < size) {\n"
+    "            size_t cap = size > 4096 ? size : 4096;\n"
+    "            free(block);\n"
+    "            block = malloc(sizeof *block + cap);\n"
+    "            if (block == NULL) {\n"
+    "                abort();\n"
+    "            }\n"
+    "            block->cap = cap;\n"
+    "        }\n"
+    "        dcrt_spare = NULL;\n"
+    "        block->prev = dcrt_top;\n"
+    "        block->used = 0;\n"
+    "        dcrt_top = block;\n"
+    "    }\n"
+    "    void *ptr = (unsigned char *)dcrt_top->data + dcrt_top->used;\n"
+    "    dcrt_top->used += size;\n"
+    "    return ptr;\n"
+    "}\n\n"
+    "%sdcrt_mark dcrt_save(void) {\n"
+    "    dcrt_mark mark = { dcrt_top, 0 };\n"
+    "    if (dcrt_top != NULL) {\n"
+    "        mark.used = dcrt_top->used;\n"
+    "    }\n"
+    "    return mark;\n"
+    "}\n\n"
+    "%svoid dcrt_release(dcrt_mark mark) {\n"
+    "    while (dcrt_top != mark.block) {\n"
+    "        struct dcrt_block *prev = dcrt_top->prev;\n"
+    "        free(dcrt_spare);\n"
+    "        dcrt_spare = dcrt_top;\n"
+    "        dcrt_top = prev;\n"
+    "    }\n"
+    "    if (dcrt_top != NULL) {\n"
+    "        dcrt_top->used = mark.used;\n"
+    "    }\n"
+    "}\n\n";
+
+/* Write the declarations of the named types some code refers to, each after
+ * those of the named types it refers to itself. Named types are referred to
+ * by their names, or by those of the functions declared with them, which
+ * extend their names.
+ */
+static void codegen_declare_used(Codegen *gen, const char *code,
+        Buffer *out) {
+    static const char *const prefixes[] = {
+        "dc_record_", "dc_fn_", "dc_array_", "dc_vector_", "dc_union_"
+    };
+
+    for (const char *at = code; *at != '\0'; at++) {
+        if ((!isalpha((unsigned char)*at) && *at != '_')
+                || (at != code && (isalnum((unsigned char)at[-1])
+                    || at[-1] == '_'))) {
+            continue;
+        }
+
+        for (size_t i = 0; i < sizeof prefixes / sizeof *prefixes; i++) {
+            size_t len = strlen(prefixes[i]);
+            if (strncmp(at, prefixes[i], len) != 0) {
+                continue;
+            }
+            while (len < strlen(prefixes[i]) + 8 && isxdigit(
+                    (unsigned char)at[len])) {
+                len += 1;
+            }
+
+            char name[32];
+            memcpy(name, at, len);
+            name[len] = '\0';
+            struct NamedType *named = codegen_find_named(gen, name);
+            if (named != NULL && !named->written) {
+                named->written = true;
+                codegen_declare_used(gen, buffer_str(&named->decl), out);
+                buffer_printf(out, "%s", buffer_str(&named->decl));
+            }
+        }
+    }
+}
+
+/* Write the named types the output refers to, followed by the other types.
+ */
+static void codegen_write_types(Codegen *gen, Buffer *out) {
+    Context *ctx = gen->ctx;
+    codegen_declare_used(gen, buffer_str(&gen->types), out);
+    for (size_t i = 0; i < ctx->symbol_table.num_globals; i++) {
+        codegen_declare_used(gen, buffer_str(&gen->protos[i]), out);
+        codegen_declare_used(gen, buffer_str(&gen->defs[i]), out);
+    }
+    buffer_printf(out, "%s", buffer_str(&gen->types));
+}
+
+static void codegen_write(Codegen *gen, FILE *to) {
+    Context *ctx = gen->ctx;
+
+    fprintf(to, "/* Generated by dependent-c from %s. */\n\n",
+        ctx->source_name);
+    codegen_includes(to);
+    if (gen->uses_arena) {
+        fputs(codegen_arena_decls, to);
+        fprintf(to, codegen_arena_defs, "static ", "static ", "static ");
+    }
+    Buffer types = buffer_new();
+    codegen_write_types(gen, &types);
+    fputs(buffer_str(&types), to);
+    buffer_free(&types);
+    fputs(buffer_str(&gen->builtins), to);
+    bool any_protos = gen->builtins.len > 0;
+    for (size_t i = 0; i < ctx->symbol_table.num_globals; i++) {
+        fputs(buffer_str(&gen->protos[i]), to);
+        any_protos = any_protos || gen->protos[i].len > 0;
+    }
+    if (any_protos) {
+        putc('\n', to);
+    }
+    for (size_t i = 0; i < ctx->symbol_table.num_globals; i++) {
+        fputs(buffer_str(&gen->defs[i]), to);
+    }
+}
+
+bool codegen_translation_unit(Context *ctx, FILE *to,
+        const TranslationUnit *unit) {
+    Codegen gen = codegen_new(ctx);
+    bool success = codegen_generate(&gen, unit);
+    codegen_write(&gen, to);
+    codegen_free(&gen);
+    return success;
+}
+
+bool codegen_globals(Context *ctx, FILE *to, size_t num_globals,
+        const size_t *globals) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    Codegen gen = codegen_new(ctx);
+
+    // Every signature is lowered before any body, so that the globals may
+    // call each other in any order.
+    bool success = true;
+    for (size_t i = 0; i < num_globals; i++) {
+        size_t global = globals[i];
+        success = symbols->global_defined[global]
+            && codegen_global(&gen, global, &symbols->global_types[global],
+                &symbols->global_defines[global])
+            && success;
+    }
+    size_t next_function = 0;
+    success = codegen_queued(&gen, &next_function) && success;
+
+    codegen_write(&gen, to);
+    codegen_free(&gen);
+    return success;
+}
+
+/***** Split Output **********************************************************/
+
+#define CODEGEN_HEADER "program.h"
+#define CODEGEN_LIBRARY "libprogram.a"
+#define CODEGEN_RUNTIME "dc-runtime"
+
+/* Write the contents of a file unless it already has them, so that its
+ * modification time only changes with its contents.
+ */
+static bool codegen_write_file(const char *dir, const char *file,
+        const char *contents) {
+    Buffer path = buffer_new();
+    buffer_printf(&path, "%s/%s", dir, file);
+    size_t len = strlen(contents);
+    bool same = false;
+
+    FILE *existing = fopen(buffer_str(&path), "rb");
+    if (existing != NULL) {
+        size_t i = 0;
+        int c;
+        same = true;
+        while (same && (c = getc(existing)) != EOF) {
+            same = i < len && c == (unsigned char)contents[i];
+            i += 1;
+        }
+        same = same && i == len;
+        fclose(existing);
+    }
+
+    bool ret_val = true;
+    if (!same) {
+        FILE *to = fopen(buffer_str(&path), "wb");
+        if (to == NULL) {
+            fprintf(stderr, "Could not open \"%s\" for writing.\n",
+                buffer_str(&path));
+            ret_val = false;
+        } else {
+            ret_val = fwrite(contents, 1, len, to) == len;
+            ret_val = fclose(to) == 0 && ret_val;
+            if (!ret_val) {
+                fprintf(stderr, "Could not write \"%s\".\n",
+                    buffer_str(&path));
+            }
+        }
+    }
+
+    buffer_free(&path);
+    return ret_val;
+}
+
+bool codegen_translation_unit_split(Context *ctx, const char *dir,
+        const TranslationUnit *unit) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    Codegen gen = codegen_new(ctx);
+    bool success = codegen_generate(&gen, unit);
+
+    // The types are shared, while the prototypes of each global's functions
+    // get a header of their own, so that a global's object only depends on
+    // the headers of the globals it refers to.
+    Buffer arena = buffer_new();
+    if (gen.uses_arena) {
+        buffer_printf(&arena, "%s", codegen_arena_decls);
+        for (size_t i = 0; i < sizeof codegen_arena_protos
+                / sizeof *codegen_arena_protos; i++) {
+            buffer_printf(&arena, "%s;\n", codegen_arena_protos[i]);
+        }
+        buffer_printf(&arena, "\n");
+    }
+
+    Buffer types = buffer_new();
+    codegen_write_types(&gen, &types);
+
+    Buffer contents = buffer_new();
+    buffer_printf(&contents, "/* Generated by dependent-c from %s. */\n\n"
+        "#ifndef DEPENDENT_C_PROGRAM_H\n"
+        "#define DEPENDENT_C_PROGRAM_H\n\n"
+        "#include <stdbool.h>\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n\n"
+        "%s%s%s%s"
+        "#endif\n", ctx->source_name, buffer_str(&arena),
+        buffer_str(&types), buffer_str(&gen.builtins),
+        gen.builtins.len > 0 ? "\n" : "");
+    success = codegen_write_file(dir, CODEGEN_HEADER, buffer_str(&contents))
+        && success;
+    buffer_free(&arena);
+    buffer_free(&types);
+
+    // Each global is compiled separately, along with the specializations and
+    // local functions lowered from it. Its files are named like its C
+    // function, dc_ followed by its name, so that they cannot have the name
+    // of a shared file. The arena is compiled on its own.
+    Buffer objects = buffer_new();
+    Buffer rules = buffer_new();
+    if (gen.uses_arena) {
+        contents.len = 0;
+        buffer_printf(&contents, "/* Generated by dependent-c from %s. */\n\n"
+            "#include \"" CODEGEN_HEADER "\"\n\n", ctx->source_name);
+        buffer_printf(&contents, codegen_arena_defs, "", "", "");
+        success = codegen_write_file(dir, CODEGEN_RUNTIME ".c",
+            buffer_str(&contents)) && success;
+        buffer_printf(&objects, " \\\n    " CODEGEN_RUNTIME ".o");
+        buffer_printf(&rules, CODEGEN_RUNTIME ".o: " CODEGEN_HEADER "\n");
+    }
+    for (size_t i = 0; i < symbols->num_globals; i++) {
+        if (gen.defs[i].len == 0) {
+            continue;
+        }
+        const char *name = symbol_name(symbols->global_names[i]);
+
+        contents.len = 0;
+        buffer_printf(&contents, "/* Generated by dependent-c from %s. */\n\n"
+            "#ifndef DEPENDENT_C_DC_%s_H\n"
+            "#define DEPENDENT_C_DC_%s_H\n\n"
+            "#include \"" CODEGEN_HEADER "\"\n\n%s\n"
+            "#endif\n", ctx->source_name, name, name,
+            buffer_str(&gen.protos[i]));
+        Buffer file = buffer_new();
+        buffer_printf(&file, "dc_%s.h", name);
+        success = codegen_write_file(dir, buffer_str(&file),
+            buffer_str(&contents)) && success;
+
+        contents.len = 0;
+        buffer_printf(&contents, "/* Generated by dependent-c from %s. */\n\n"
+            "#include \"dc_%s.h\"\n", ctx->source_name, name);
+        buffer_printf(&rules, "dc_%s.o: " CODEGEN_HEADER " dc_%s.h",
+            name, name);
+        for (size_t j = 0; j < gen.num_refs[i]; j++) {
+            size_t ref = gen.refs[i][j];
+            if (ref != i && gen.defs[ref].len > 0) {
+                const char *ref_name = symbol_name(symbols->global_names[ref]);
+                buffer_printf(&contents, "#include \"dc_%s.h\"\n", ref_name);
+                buffer_printf(&rules, " dc_%s.h", ref_name);
+            }
+        }
+        buffer_printf(&contents, "\n%s", buffer_str(&gen.defs[i]));
+        buffer_printf(&rules, "\n");
+
+        file.len = 0;
+        buffer_printf(&file, "dc_%s.c", name);
+        success = codegen_write_file(dir, buffer_str(&file),
+            buffer_str(&contents)) && success;
+        buffer_printf(&objects, " \\\n    dc_%s.o", name);
+        buffer_free(&file);
+    }
+
+    contents.len = 0;
+    buffer_printf(&contents, "# Generated by dependent-c from %s.\n\n"
+        "CFLAGS = -std=c11 -O2\n"
+        "OBJECTS =%s\n\n"
+        CODEGEN_LIBRARY ": $(OBJECTS)\n"
+        "\t$(AR) rcs $@ $(OBJECTS)\n\n"
+        "%s\n"
+        "clean:\n"
+        "\trm -f " CODEGEN_LIBRARY " $(OBJECTS)\n\n"
+        ".PHONY: clean\n", ctx->source_name, buffer_str(&objects),
+        buffer_str(&rules));
+    success = codegen_write_file(dir, "Makefile", buffer_str(&contents))
+        && success;
+
+    buffer_free(&objects);
+    buffer_free(&rules);
+    buffer_free(&contents);
+    codegen_free(&gen);
+    return success;
+}
@@ -0,0 +1,430 @@
+#include <assert.h>
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Compiled Nodes ********************************************************/
+
+typedef struct EvalNode EvalNode;
+
+/* Evaluate a node with its variables bound to the expressions in env. */
+typedef bool EvalFn(Context*, const EvalNode *node, const Expr **env,
+    Expr *result);
+
+/* Whether the branches of an if-then-else are convertible, which decides
+ * the result without evaluating its predicate.
+ */
+typedef enum {
+      BRANCHES_EQUAL    // Syntactically equal, so always convertible.
+    , BRANCHES_DISTINCT // Headed by different constructors, so never.
+    , BRANCHES_UNKNOWN  // Only known once the variables are substituted.
+} EvalBranches;
+
+struct EvalNode {
+    EvalFn *eval;
+    const Expr *syntax; // The expression compiled, within the definition.
+
+    // The variables in scope which occur free in the syntax, so that it can
+    // be instantiated.
+    size_t num_vars;
+    const char **var_names;
+    size_t *var_slots;
+
+    size_t slot; // The slot read by a variable, or bound by an induction.
+    EvalBranches branches;
+    size_t num_children;
+    EvalNode *children;
+};
+
+struct EvalCode {
+    size_t num_params;
+    size_t num_slots;
+    EvalNode body;
+};
+
+/* The locals in scope while compiling, innermost last. */
+typedef struct {
+    size_t num;
+    const char **names;
+    size_t *slots;
+    size_t num_slots;
+} EvalScope;
+
+static bool eval_node(Context *ctx, const EvalNode *node, const Expr **env,
+        Expr *result) {
+    return node->eval(ctx, node, env, result);
+}
+
+/* Copy the syntax of a node, replacing its variables with their values. */
+static Expr eval_instantiate(Context *ctx, const EvalNode *node,
+        const Expr **env) {
+    if (node->syntax->tag == EXPR_IDENT && node->num_vars == 1) {
+        return expr_copy(ctx, env[node->var_slots[0]]);
+    }
+
+    Expr result = expr_copy(ctx, node->syntax);
+    if (node->num_vars > 0) {
+        Expr *replacements;
+        alloc_array(replacements, node->num_vars);
+        for (size_t i = 0; i < node->num_vars; i++) {
+            replacements[i] = *env[node->var_slots[i]];
+        }
+        expr_subst_many(ctx, &result, node->num_vars, node->var_names,
+            replacements);
+        dealloc(replacements);
+    }
+    return result;
+}
+
+/* A variable, evaluating the expression bound to it. */
+static bool eval_var(Context *ctx, const EvalNode *node, const Expr **env,
+        Expr *result) {
+    return type_eval(ctx, env[node->slot], result);
+}
+
+/* Syntax already in weak head normal form. */
+static bool eval_whnf(Context *ctx, const EvalNode *node, const Expr **env,
+        Expr *result) {
+    *result = eval_instantiate(ctx, node, env);
+    return true;
+}
+
+/* Anything else is instantiated and left to type_eval. Applications are
+ * too, so that they are shared and tabled as usual.
+ */
+static bool eval_syntax(Context *ctx, const EvalNode *node, const Expr **env,
+        Expr *result) {
+    Expr instance = eval_instantiate(ctx, node, env);
+    bool ret_val = type_eval(ctx, &instance, result);
+    expr_free(ctx, &instance);
+    return ret_val;
+}
+
+static bool eval_ifthenelse(Context *ctx, const EvalNode *node,
+        const Expr **env, Expr *result) {
+    const EvalNode *predicate = &node->children[0];
+    const EvalNode *then_ = &node->children[1];
+    const EvalNode *else_ = &node->children[2];
+
+    bool convertible = node->branches == BRANCHES_EQUAL;
+    if (node->branches == BRANCHES_UNKNOWN) {
+        Expr then_instance = eval_instantiate(ctx, then_, env);
+        Expr else_instance = eval_instantiate(ctx, else_, env);
+        convertible = type_convertible(ctx, &then_instance, &else_instance);
+        expr_free(ctx, &then_instance);
+        expr_free(ctx, &else_instance);
+    }
+    if (convertible) {
+        return eval_node(ctx, then_, env, result);
+    }
+
+    Expr reduced_cond[1];
+    if (!eval_node(ctx, predicate, env, reduced_cond)) {
+        return false;
+    }
+
+    if (reduced_cond->tag == EXPR_BOOLEAN) {
+        return eval_node(ctx, reduced_cond->boolean ? then_ : else_,
+            env, result);
+    } else {
+        expr_free(ctx, reduced_cond);
+        return false;
+    }
+}
+
+static bool eval_nat_ind(Context *ctx, const EvalNode *node,
+        const Expr **env, Expr *result) {
+    const Expr *syntax = node->syntax;
+
+    Expr reduced_nat;
+    if (!eval_node(ctx, &node->children[0], env, &reduced_nat)) {
+        return false;
+    }
+
+    if (reduced_nat.tag != EXPR_NATURAL) {
+        efprintf(ctx, stderr, "Cannot evaluate natural induction with "
+            "non-literal natural ($e).\n", ewrap(&reduced_nat));
+        expr_free(ctx, &reduced_nat);
+        return false;
+    }
+
+    if (natural_is(&reduced_nat.natural,
+            syntax->nat_ind.goes_down ? 0 : UINT64_MAX)) {
+        expr_free(ctx, &reduced_nat);
+        return eval_node(ctx, &node->children[1], env, result);
+    } else if (!syntax->nat_ind.goes_down
+            && !natural_is_small(&reduced_nat.natural)) {
+        efprintf(ctx, stderr, "Cannot count up to NAT_MAX from $e, which is "
+            "above it.\n", ewrap(&reduced_nat));
+        expr_free(ctx, &reduced_nat);
+        return false;
+    }
+
+    const Natural one = natural_small(1);
+    Expr step = {
+          .tag = EXPR_NATURAL
+        , .well_typed = true
+        , .natural = syntax->nat_ind.goes_down
+            ? natural_sub(&reduced_nat.natural, &one)
+            : natural_add(&reduced_nat.natural, &one)
+    };
+    expr_free(ctx, &reduced_nat);
+    const Expr *saved = env[node->slot];
+    env[node->slot] = &step;
+    bool ret_val = eval_node(ctx, &node->children[2], env, result);
+    env[node->slot] = saved;
+    expr_free(ctx, &step);
+    return ret_val;
+}
+
+static bool eval_access(Context *ctx, const EvalNode *node, const Expr **env,
+        Expr *result) {
+    Expr reduced_pack;
+    if (!eval_node(ctx, &node->children[0], env, &reduced_pack)) {
+        return false;
+    }
+
+    if (reduced_pack.tag != EXPR_PACK) {
+        efprintf(ctx, stderr, "Cannot evaluate access of non-literal record "
+            "($e).\n", ewrap(&reduced_pack));
+        expr_free(ctx, &reduced_pack);
+        return false;
+    }
+
+    size_t num_fields = reduced_pack.pack.num_fields;
+    size_t field_num = node->syntax->access.field_num;
+    if (field_num >= num_fields) {
+        efprintf(ctx, stderr, "Cannot access field #%zu of literal record "
+            "($e) with %zu fields.\n", ewrap(&reduced_pack),
+            field_num, num_fields);
+        expr_free(ctx, &reduced_pack);
+        return false;
+    }
+
+    bool ret_val = type_eval(ctx,
+        &reduced_pack.pack.field_values[field_num], result);
+    expr_free(ctx, &reduced_pack);
+    return ret_val;
+}
+
+/***** Compilation ***********************************************************/
+
+static void eval_node_free(EvalNode *node) {
+    for (size_t i = 0; i < node->num_children; i++) {
+        eval_node_free(&node->children[i]);
+    }
+    dealloc(node->children);
+    dealloc(node->var_names);
+    dealloc(node->var_slots);
+}
+
+static size_t eval_scope_bind(EvalScope *scope, const char *name) {
+    realloc_array(scope->names, scope->num + 1);
+    realloc_array(scope->slots, scope->num + 1);
+    scope->names[scope->num] = name;
+    scope->slots[scope->num] = scope->num_slots;
+    scope->num += 1;
+    scope->num_slots += 1;
+    return scope->num_slots - 1;
+}
+
+/* Record which variables in scope a node's syntax refers to. */
+static void eval_node_vars(Context *ctx, const EvalScope *scope,
+        EvalNode *node) {
+    SymbolSet free_vars = symbol_set_empty();
+    expr_free_vars(ctx, node->syntax, &free_vars);
+
+    alloc_array(node->var_names, free_vars.size);
+    alloc_array(node->var_slots, free_vars.size);
+    for (size_t i = scope->num; i-- > 0;) {
+        if (symbol_set_contains(&free_vars, scope->names[i])) {
+            symbol_set_delete(&free_vars, scope->names[i]);
+            node->var_names[node->num_vars] = scope->names[i];
+            node->var_slots[node->num_vars] = scope->slots[i];
+            node->num_vars += 1;
+        }
+    }
+    symbol_set_free(&free_vars);
+}
+
+/* Whether an expression is in weak head normal form whatever its variables
+ * are replaced with.
+ */
+static bool eval_is_whnf(const Expr *expr) {
+    switch (expr->tag) {
+      case EXPR_TYPE:
+      case EXPR_FORALL:     case EXPR_LAMBDA:
+      case EXPR_ID:         case EXPR_REFLEXIVE:
+      case EXPR_VOID:
+      case EXPR_BOOL:       case EXPR_BOOLEAN:
+      case EXPR_NAT:        case EXPR_NATURAL:
+      case EXPR_SIGMA:      case EXPR_PACK:
+        return true;
+
+      default:
+        return false;
+    }
+}
+
+static EvalBranches eval_branches(Context *ctx, const Expr *then_,
+        const Expr *else_) {
+    if (expr_equal(ctx, then_, else_)) {
+        return BRANCHES_EQUAL;
+    } else if (eval_is_whnf(then_) && eval_is_whnf(else_)
+            && (then_->tag != else_->tag
+                || (then_->tag == EXPR_BOOLEAN
+                    && then_->boolean != else_->boolean)
+                || (then_->tag == EXPR_NATURAL
+                    && !natural_equal(&then_->natural, &else_->natural)))) {
+        return BRANCHES_DISTINCT;
+    } else {
+        return BRANCHES_UNKNOWN;
+    }
+}
+
+static void eval_compile_node(Context *ctx, EvalScope *scope,
+        const Expr *syntax, EvalNode *node) {
+    *node = (EvalNode){
+          .eval = eval_syntax
+        , .syntax = syntax
+        , .num_vars = 0
+        , .var_names = NULL
+        , .var_slots = NULL
+        , .slot = 0
+        , .branches = BRANCHES_UNKNOWN
+        , .num_children = 0
+        , .children = NULL
+    };
+
+    switch (syntax->tag) {
+      case EXPR_IDENT:
+        for (size_t i = scope->num; i-- > 0;) {
+            if (scope->names[i] == syntax->ident) {
+                node->eval = eval_var;
+                node->slot = scope->slots[i];
+                break;
+            }
+        }
+        break;
+
+      case EXPR_IFTHENELSE:
+        node->eval = eval_ifthenelse;
+        node->branches = eval_branches(ctx,
+            syntax->ifthenelse.then_, syntax->ifthenelse.else_);
+        node->num_children = 3;
+        alloc_array(node->children, node->num_children);
+        eval_compile_node(ctx, scope, syntax->ifthenelse.predicate,
+            &node->children[0]);
+        eval_compile_node(ctx, scope, syntax->ifthenelse.then_,
+            &node->children[1]);
+        eval_compile_node(ctx, scope, syntax->ifthenelse.else_,
+            &node->children[2]);
+        break;
+
+      case EXPR_NAT_IND: {
+        node->eval = eval_nat_ind;
+        node->num_children = 3;
+        alloc_array(node->children, node->num_children);
+        eval_compile_node(ctx, scope, syntax->nat_ind.natural,
+            &node->children[0]);
+        eval_compile_node(ctx, scope, syntax->nat_ind.base_val,
+            &node->children[1]);
+
+        size_t num_bound = scope->num;
+        node->slot = eval_scope_bind(scope, syntax->nat_ind.ind_name);
+        eval_compile_node(ctx, scope, syntax->nat_ind.ind_val,
+            &node->children[2]);
+        scope->num = num_bound;
+        break;
+      }
+
+      case EXPR_ACCESS:
+        node->eval = eval_access;
+        node->num_children = 1;
+        alloc_array(node->children, node->num_children);
+        eval_compile_node(ctx, scope, syntax->access.record,
+            &node->children[0]);
+        break;
+
+      default:
+        if (eval_is_whnf(syntax)) {
+            node->eval = eval_whnf;
+        }
+        break;
+    }
+
+    // Variables are instantiated by copying their values, and branches of
+    // if-then-else may need instantiating to compare them.
+    if (node->eval != eval_var) {
+        eval_node_vars(ctx, scope, node);
+    }
+}
+
+static EvalCode *eval_compile(Context *ctx, const Expr *lambda) {
+    assert(lambda->tag == EXPR_LAMBDA);
+    EvalScope scope = {
+          .num = 0
+        , .names = NULL
+        , .slots = NULL
+        , .num_slots = 0
+    };
+
+    for (size_t i = 0; i < lambda->lambda.num_params; i++) {
+        eval_scope_bind(&scope, lambda->lambda.param_names[i]);
+    }
+
+    EvalCode *code;
+    alloc(code);
+    code->num_params = lambda->lambda.num_params;
+    eval_compile_node(ctx, &scope, lambda->lambda.body, &code->body);
+    code->num_slots = scope.num_slots;
+
+    dealloc(scope.names);
+    dealloc(scope.slots);
+    return code;
+}
+
+void eval_code_free(Context *ctx, EvalCode *code) {
+    eval_node_free(&code->body);
+    dealloc(code);
+}
+
+const EvalCode *eval_global_code(Context *ctx, size_t global) {
+    const SymbolTable *symbols = &ctx->symbol_table;
+    if (!ctx->eval_compiled || !symbols->global_defined[global]
+            || symbols->global_defines[global].tag != EXPR_LAMBDA) {
+        return NULL;
+    }
+
+    if (ctx->num_compiled < symbols->num_globals) {
+        realloc_array(ctx->compiled, symbols->num_globals);
+        for (size_t i = ctx->num_compiled; i < symbols->num_globals; i++) {
+            ctx->compiled[i] = NULL;
+        }
+        ctx->num_compiled = symbols->num_globals;
+    }
+
+    if (ctx->compiled[global] == NULL) {
+        ctx->compiled[global] = eval_compile(ctx,
+            &symbols->global_defines[global]);
+    }
+    return ctx->compiled[global];
+}
+
+size_t eval_code_num_params(const EvalCode *code) {
+    return code->num_params;
+}
+
+bool eval_apply(Context *ctx, const EvalCode *code, const Expr *args,
+        Expr *result) {
+    const Expr **env;
+    alloc_array(env, code->num_slots);
+    for (size_t i = 0; i < code->num_slots; i++) {
+        env[i] = i < code->num_params ? &args[i] : NULL;
+    }
+
+    bool ret_val = eval_node(ctx, &code->body, env, result);
+    dealloc(env);
+    return ret_val;
+}
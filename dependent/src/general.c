@@ -3,6 +3,10 @@
 #include "dependent-c/general.h"
 #include "dependent-c/memory.h"
 
+#define DEFAULT_TABLE_CAP ((size_t)64 * 1024 * 1024)
+#define DEFAULT_EVAL_DEPTH_CAP 4000
+#define DEFAULT_SPECIALIZATION_CAP 1024
+
 Context context_new(const char *source_name, CharStream source) {
     char *source_name_copy;
     alloc_array(source_name_copy, strlen(source_name) + 1);
@@ -14,8 +18,21 @@ Context context_new(const char *source_name, CharStream source) {
           .source_name = source_name_copy
         , .tokens = tokens
         , .interns = symbol_new()
+        , .fresh = symbol_fresh_new()
         , .symbol_table = symbol_table_new()
         , .ast = (TranslationUnit){0}
+        , .eval_shared = expr_memo_new()
+        , .eval_depth = 0
+        , .eval_depth_cap = DEFAULT_EVAL_DEPTH_CAP
+        , .eval_scoped = false
+        , .quiet = 0
+        , .num_compiled = 0
+        , .compiled = NULL
+        , .eval_compiled = true
+        , .jit = jit_new()
+        , .table_cap = DEFAULT_TABLE_CAP
+        , .table_bytes = 0
+        , .specialization_cap = DEFAULT_SPECIALIZATION_CAP
         , .color_enabled = false
     };
 }
@@ -24,7 +41,16 @@ void context_free(Context *context) {
     dealloc(context->source_name);
     token_stream_free(&context->tokens);
     symbol_free_all(&context->interns);
-    symbol_table_free(&context->symbol_table);
+    symbol_fresh_free_all(&context->fresh);
+    symbol_table_free(context, &context->symbol_table);
     translation_unit_free(context, &context->ast);
+    expr_memo_free(context, &context->eval_shared);
+    for (size_t i = 0; i < context->num_compiled; i++) {
+        if (context->compiled[i] != NULL) {
+            eval_code_free(context, context->compiled[i]);
+        }
+    }
+    dealloc(context->compiled);
+    jit_free(&context->jit);
     memset(context, 0, sizeof *context);
 }
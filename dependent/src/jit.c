@@ -0,0 +1,365 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+#define JIT_DEFAULT_THRESHOLD 1000
+#define JIT_ENTRY "dc_jit_entry"
+
+Jit jit_new(void) {
+    return (Jit){
+          .enabled = false
+        , .compiler_missing = false
+        , .threshold = JIT_DEFAULT_THRESHOLD
+        , .num_globals = 0
+        , .globals = NULL
+        , .dir = NULL
+        , .num_handles = 0
+        , .handles = NULL
+    };
+}
+
+void jit_free(Jit *jit) {
+    for (size_t i = 0; i < jit->num_handles; i++) {
+        dlclose(jit->handles[i]);
+    }
+    dealloc(jit->handles);
+    if (jit->dir != NULL) {
+        rmdir(jit->dir);
+        dealloc(jit->dir);
+    }
+    dealloc(jit->globals);
+}
+
+/***** Eligibility ***********************************************************/
+
+static bool jit_is_scalar(const Expr *type) {
+    return type->tag == EXPR_NAT || type->tag == EXPR_BOOL;
+}
+
+static bool jit_collect(Context *ctx, size_t global,
+    size_t *num_globals, size_t **globals);
+
+static bool jit_collect_expr(Context *ctx, const Expr *expr,
+        size_t *num_globals, size_t **globals) {
+    switch (expr->tag) {
+      case EXPR_IDENT:
+      case EXPR_BOOLEAN:
+        return true;
+
+      case EXPR_NATURAL:
+        return natural_is_small(&expr->natural);
+
+      case EXPR_IFTHENELSE:
+        return jit_collect_expr(ctx, expr->ifthenelse.predicate,
+                num_globals, globals)
+            && jit_collect_expr(ctx, expr->ifthenelse.then_,
+                num_globals, globals)
+            && jit_collect_expr(ctx, expr->ifthenelse.else_,
+                num_globals, globals);
+
+      case EXPR_NAT_IND:
+        return jit_collect_expr(ctx, expr->nat_ind.natural,
+                num_globals, globals)
+            && jit_collect_expr(ctx, expr->nat_ind.base_val,
+                num_globals, globals)
+            && jit_collect_expr(ctx, expr->nat_ind.ind_val,
+                num_globals, globals);
+
+      case EXPR_CALL:
+        if (expr->call.func->tag != EXPR_GLOBAL
+                || !jit_collect(ctx, expr->call.func->global,
+                    num_globals, globals)
+                || expr->call.num_args != ctx->symbol_table
+                    .global_types[expr->call.func->global].forall.num_params) {
+            return false;
+        }
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            if (!jit_collect_expr(ctx, &expr->call.args[i],
+                    num_globals, globals)) {
+                return false;
+            }
+        }
+        return true;
+
+      default:
+        return false;
+    }
+}
+
+/* Collect a global and every global it calls, returning whether they are all
+ * first-order functions on naturals and booleans.
+ */
+static bool jit_collect(Context *ctx, size_t global,
+        size_t *num_globals, size_t **globals) {
+    const SymbolTable *symbols = &ctx->symbol_table;
+    const Expr *type = &symbols->global_types[global];
+    const Expr *define = &symbols->global_defines[global];
+
+    // Builtins are lowered wherever they are called, and report overflowing
+    // 64 bits through the entry point.
+    if (builtin_lookup(symbols, global) != NULL) {
+        return true;
+    }
+    for (size_t i = 0; i < *num_globals; i++) {
+        if ((*globals)[i] == global) {
+            return true;
+        }
+    }
+
+    // Opaque globals do not reduce in the interpreter, so must not natively.
+    if (!symbols->global_defined[global] || symbols->global_opaque[global]
+            || type->tag != EXPR_FORALL
+            || define->tag != EXPR_LAMBDA
+            || !jit_is_scalar(type->forall.ret_type)) {
+        return false;
+    }
+    for (size_t i = 0; i < type->forall.num_params; i++) {
+        if (!jit_is_scalar(&type->forall.param_types[i])) {
+            return false;
+        }
+    }
+
+    // Native code evaluates every argument before a call, which is only
+    // safe where the interpreter would evaluate it anyway.
+    const bool *strict = type_global_strict(ctx, global);
+    if (strict == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < define->lambda.num_params; i++) {
+        if (!strict[i]) {
+            return false;
+        }
+    }
+
+    realloc_array(*globals, *num_globals + 1);
+    (*globals)[*num_globals] = global;
+    *num_globals += 1;
+    return jit_collect_expr(ctx, define->lambda.body, num_globals, globals);
+}
+
+/***** Compilation ***********************************************************/
+
+/* The path of a file in the JIT's directory for a global. */
+static char *jit_path(const Jit *jit, size_t global, const char *extension) {
+    int len = snprintf(NULL, 0, "%s/%zu.%s", jit->dir, global, extension);
+    char *path;
+    alloc_array(path, (size_t)len + 1);
+    snprintf(path, (size_t)len + 1, "%s/%zu.%s", jit->dir, global, extension);
+    return path;
+}
+
+static bool jit_make_dir(Jit *jit) {
+    const char *tmp = getenv("TMPDIR");
+    if (tmp == NULL || *tmp == '\0') {
+        tmp = "/tmp";
+    }
+
+    const char *name = "/dependent-c-XXXXXX";
+    alloc_array(jit->dir, strlen(tmp) + strlen(name) + 1);
+    strcpy(jit->dir, tmp);
+    strcat(jit->dir, name);
+    if (mkdtemp(jit->dir) == NULL) {
+        dealloc(jit->dir);
+        return false;
+    }
+    return true;
+}
+
+/* Write a global and the globals it calls as C, with an entry point taking
+ * the arguments as an array. Overflow jumps back to the entry point, which
+ * reports it rather than aborting the type checker.
+ */
+static bool jit_write(Context *ctx, const char *path, size_t global,
+        size_t num_globals, const size_t *globals) {
+    FILE *to = fopen(path, "w");
+    if (to == NULL) {
+        return false;
+    }
+
+    const Expr *type = &ctx->symbol_table.global_types[global];
+    fputs("#include <setjmp.h>\n\n"
+        "static jmp_buf dc_jit_overflow;\n"
+        "#define dc_overflow() longjmp(dc_jit_overflow, 1)\n\n", to);
+    bool success = codegen_globals(ctx, to, num_globals, globals);
+    fprintf(to, "uint64_t " JIT_ENTRY "(const uint64_t *args, "
+            "bool *overflowed) {\n"
+        "    *overflowed = false;\n"
+        "    if (setjmp(dc_jit_overflow) != 0) {\n"
+        "        *overflowed = true;\n"
+        "        return 0;\n"
+        "    }\n"
+        "    return dc_%s(",
+        symbol_name(ctx->symbol_table.global_names[global]));
+    for (size_t i = 0; i < type->forall.num_params; i++) {
+        fprintf(to, type->forall.param_types[i].tag == EXPR_BOOL
+            ? "%sargs[%zu] != 0" : "%sargs[%zu]", i == 0 ? "" : ", ", i);
+    }
+    fputs(");\n}\n", to);
+
+    return fclose(to) == 0 && success;
+}
+
+/* Run the C compiler to build a shared object, noting if it is missing. */
+static bool jit_run_compiler(Jit *jit, const char *source,
+        const char *object) {
+    const char *cc = getenv("CC");
+    if (cc == NULL || *cc == '\0') {
+        cc = "cc";
+    }
+
+    const char *format = "%s -std=c11 -O2 -shared -fPIC -o '%s' '%s' "
+        "> /dev/null 2>&1";
+    int len = snprintf(NULL, 0, format, cc, object, source);
+    char *command;
+    alloc_array(command, (size_t)len + 1);
+    snprintf(command, (size_t)len + 1, format, cc, object, source);
+    int status = system(command);
+    dealloc(command);
+
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+        fprintf(stderr, "Cannot run the C compiler \"%s\", so hot globals "
+            "will be interpreted.\n", cc);
+        jit->compiler_missing = true;
+        return false;
+    }
+    return WEXITSTATUS(status) == 0;
+}
+
+/* Compile a hot global to native code, returning its new status. */
+static JitStatus jit_compile(Context *ctx, size_t global, JitFn **native) {
+    Jit *jit = &ctx->jit;
+    size_t num_globals = 0;
+    size_t *globals = NULL;
+    if (!jit_collect(ctx, global, &num_globals, &globals)) {
+        dealloc(globals);
+        return JIT_REJECTED;
+    }
+
+    if (jit->dir == NULL && !jit_make_dir(jit)) {
+        fprintf(stderr, "Cannot create a directory for compiled globals, so "
+            "hot globals will be interpreted.\n");
+        jit->compiler_missing = true;
+        dealloc(globals);
+        return JIT_REJECTED;
+    }
+
+    char *source = jit_path(jit, global, "c");
+    char *object = jit_path(jit, global, "so");
+    bool success = jit_write(ctx, source, global, num_globals, globals)
+        && jit_run_compiler(jit, source, object);
+
+    void *handle = NULL;
+    if (success) {
+        handle = dlopen(object, RTLD_NOW | RTLD_LOCAL);
+        if (handle == NULL) {
+            fprintf(stderr, "Cannot load compiled global \"%s\": %s\n",
+                symbol_name(ctx->symbol_table.global_names[global]),
+                dlerror());
+            success = false;
+        }
+    }
+    if (success) {
+        // POSIX guarantees that a function pointer survives this conversion.
+        *(void **)native = dlsym(handle, JIT_ENTRY);
+        success = *native != NULL;
+        realloc_array(jit->handles, jit->num_handles + 1);
+        jit->handles[jit->num_handles] = handle;
+        jit->num_handles += 1;
+    }
+
+    remove(source);
+    remove(object);
+    dealloc(source);
+    dealloc(object);
+    dealloc(globals);
+    return success ? JIT_NATIVE : JIT_REJECTED;
+}
+
+/***** Evaluation ************************************************************/
+
+bool jit_eval_call(Context *ctx, const Expr *call, Expr *result) {
+    assert(call->tag == EXPR_CALL && call->call.func->tag == EXPR_GLOBAL);
+    Jit *jit = &ctx->jit;
+    size_t global = call->call.func->global;
+    if (!jit->enabled) {
+        return false;
+    }
+
+    size_t num_globals = ctx->symbol_table.num_globals;
+    if (jit->num_globals < num_globals) {
+        realloc_array(jit->globals, num_globals);
+        for (size_t i = jit->num_globals; i < num_globals; i++) {
+            jit->globals[i] = (struct JitGlobal){
+                  .status = JIT_COUNTING
+                , .unfoldings = 0
+                , .native = NULL
+            };
+        }
+        jit->num_globals = num_globals;
+    }
+
+    struct JitGlobal *entry = &jit->globals[global];
+    if (entry->status == JIT_COUNTING) {
+        entry->unfoldings += 1;
+        if (entry->unfoldings < jit->threshold || jit->compiler_missing) {
+            return false;
+        }
+        entry->status = jit_compile(ctx, global, &entry->native);
+    }
+    if (entry->status != JIT_NATIVE) {
+        return false;
+    }
+
+    // Closed calls of globals strict in every parameter have their
+    // arguments evaluated for tabling before they get here. Any others, such
+    // as open arguments when checking the body of a function, leave the call
+    // to the interpreter without evaluating anything.
+    size_t num_args = call->call.num_args;
+    uint64_t *args;
+    alloc_array(args, num_args);
+    for (size_t i = 0; i < num_args; i++) {
+        // Native code only handles naturals of 64 bits.
+        const Expr *arg = &call->call.args[i];
+        if (arg->tag == EXPR_BOOLEAN) {
+            args[i] = arg->boolean;
+        } else if (arg->tag == EXPR_NATURAL
+                && natural_is_small(&arg->natural)) {
+            args[i] = arg->natural.small;
+        } else {
+            dealloc(args);
+            return false;
+        }
+    }
+
+    bool overflowed;
+    uint64_t value = entry->native(args, &overflowed);
+    dealloc(args);
+    if (overflowed) {
+        // Naturals past 64 bits are left to the interpreter, which is exact.
+        return false;
+    }
+
+    const Expr *type = &ctx->symbol_table.global_types[global];
+    if (type->forall.ret_type->tag == EXPR_BOOL) {
+        *result = (Expr){
+              .tag = EXPR_BOOLEAN
+            , .well_typed = true
+            , .boolean = value != 0
+        };
+    } else {
+        *result = (Expr){
+              .tag = EXPR_NATURAL
+            , .well_typed = true
+            , .natural = natural_small(value)
+        };
+    }
+    return true;
+}
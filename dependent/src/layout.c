@@ -0,0 +1,477 @@
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Data Layout ***********************************************************/
+
+static const Layout layout_erased = {
+      .is_static = true
+    , .size = 0
+    , .align = 1
+    , .has_niche = false
+};
+
+size_t layout_align_up(size_t offset, size_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+static size_t size_t_max(size_t x, size_t y) {
+    return x > y ? x : y;
+}
+
+static bool layout_is_erased(const Layout *layout) {
+    return layout->is_static && layout->size == 0;
+}
+
+/* Evaluate a type, leaving it as it is if it is stuck. Types depending upon
+ * earlier fields are often stuck, so that is not reported.
+ */
+static Expr layout_whnf(Context *ctx, const Expr *type) {
+    Expr whnf;
+    ctx->quiet += 1;
+    if (!type_eval_transparent(ctx, type, &whnf)) {
+        whnf = expr_copy(ctx, type);
+    }
+    ctx->quiet -= 1;
+    return whnf;
+}
+
+static bool layout_type_whnf(Context *ctx, const Expr *type, Layout *result) {
+    RecordLayout record[1];
+    Layout then_[1], else_[1];
+    VectorShape vector[1];
+
+    switch (type->tag) {
+      case EXPR_TYPE:
+      case EXPR_ID:
+      case EXPR_VOID:
+        *result = layout_erased;
+        return true;
+
+      case EXPR_NAT:
+        *result = (Layout){
+              .is_static = true
+            , .size = sizeof(uint64_t)
+            , .align = _Alignof(uint64_t)
+            , .has_niche = false
+        };
+        return true;
+
+      case EXPR_BOOL:
+        *result = (Layout){
+              .is_static = true
+            , .size = sizeof(bool)
+            , .align = _Alignof(bool)
+            , .has_niche = true
+        };
+        return true;
+
+      case EXPR_FORALL:
+        // Functions returning erased values are erased themselves.
+        symbol_table_enter_scope(&ctx->symbol_table);
+        for (size_t i = 0; i < type->forall.num_params; i++) {
+            if (type->forall.param_names[i] != NULL) {
+                symbol_table_register_local(&ctx->symbol_table,
+                    type->forall.param_names[i], type->forall.param_types[i]);
+            }
+        }
+        bool ret_ok = layout_type(ctx, type->forall.ret_type, result);
+        symbol_table_leave_scope(&ctx->symbol_table);
+
+        if (ret_ok && (!result->is_static || result->size != 0)) {
+            *result = (Layout){
+                  .is_static = true
+                , .size = sizeof(void (*)(void))
+                , .align = _Alignof(void (*)(void))
+                , .has_niche = true // Function pointers are never null.
+            };
+        }
+        return ret_ok;
+
+      case EXPR_SIGMA:
+        if (!layout_record(ctx, type, record)) {
+            return false;
+        }
+        *result = record->layout;
+        record_layout_free(record);
+        return true;
+
+      case EXPR_IFTHENELSE:
+        // The condition is unknown, so either branch may be taken. The
+        // branches share their storage like the members of a C union.
+        if (!layout_type(ctx, type->ifthenelse.then_, then_)
+                || !layout_type(ctx, type->ifthenelse.else_, else_)) {
+            return false;
+        }
+        *result = (Layout){
+              .is_static = then_->is_static && else_->is_static
+            , .size = size_t_max(then_->size, else_->size)
+            , .align = size_t_max(then_->align, else_->align)
+            , .has_niche = false
+        };
+        if (!result->is_static) {
+            result->size = 0;
+        }
+        return true;
+
+      default:
+        // The length of a stuck vector is unknown, but its elements are
+        // still laid out as an array.
+        if (!layout_vector(ctx, type, vector)) {
+            return false;
+        }
+        bool elem_ok = layout_type(ctx, &vector->elem, result);
+        vector_shape_free(ctx, vector);
+
+        if (elem_ok && !layout_is_erased(result)) {
+            *result = (Layout){
+                  .is_static = false
+                , .size = 0
+                , .align = result->align
+                , .has_niche = false
+            };
+        }
+        return elem_ok;
+    }
+}
+
+bool layout_type(Context *ctx, const Expr *type, Layout *result) {
+    Expr whnf = layout_whnf(ctx, type);
+    bool ret_val = layout_type_whnf(ctx, &whnf, result);
+    expr_free(ctx, &whnf);
+    return ret_val;
+}
+
+bool layout_optional_field(Context *ctx, const Expr *sigma, size_t field,
+        size_t *tag, Expr *payload) {
+    bool ret_val = false;
+    Layout then_[1], else_[1];
+
+    Expr whnf[1] = {layout_whnf(ctx, &sigma->sigma.field_types[field])};
+
+    if (whnf->tag != EXPR_IFTHENELSE
+            || whnf->ifthenelse.predicate->tag != EXPR_IDENT) {
+        goto end_of_function;
+    }
+
+    const Expr *present;
+    if (layout_type(ctx, whnf->ifthenelse.else_, else_)
+            && layout_is_erased(else_)) {
+        present = whnf->ifthenelse.then_;
+    } else if (layout_type(ctx, whnf->ifthenelse.then_, then_)
+            && layout_is_erased(then_)) {
+        present = whnf->ifthenelse.else_;
+    } else {
+        goto end_of_function;
+    }
+
+    const char *name = whnf->ifthenelse.predicate->ident;
+    size_t i = field;
+    while (i > 0 && sigma->sigma.field_names[i - 1] != name) {
+        i -= 1;
+    }
+    if (i == 0) {
+        goto end_of_function;
+    }
+    *tag = i - 1;
+
+    Expr tag_type[1] = {layout_whnf(ctx, &sigma->sigma.field_types[*tag])};
+    ret_val = tag_type->tag == EXPR_BOOL;
+    expr_free(ctx, tag_type);
+
+    for (size_t j = *tag + 1; ret_val && j < sigma->sigma.num_fields; j++) {
+        if (j != field) {
+            SymbolSet free_vars = symbol_set_empty();
+            expr_free_vars(ctx, &sigma->sigma.field_types[j], &free_vars);
+            ret_val = !symbol_set_contains(&free_vars, name);
+            symbol_set_free(&free_vars);
+        }
+    }
+
+    if (ret_val) {
+        *payload = expr_copy(ctx, present);
+    }
+
+end_of_function:
+    expr_free(ctx, whnf);
+    return ret_val;
+}
+
+/* Determine whether a field of a sigma type is optional as above and the
+ * type of its value has a niche, so that its tag can be stored in that niche.
+ * Must be called with the earlier fields in scope.
+ */
+static bool layout_niche_tag(Context *ctx, const Expr *sigma, size_t field,
+        size_t *tag) {
+    Expr payload[1];
+    if (!layout_optional_field(ctx, sigma, field, tag, payload)) {
+        return false;
+    }
+
+    Layout layout[1];
+    bool ret_val = layout_type(ctx, payload, layout) && layout->has_niche;
+    expr_free(ctx, payload);
+    return ret_val;
+}
+
+/* Whether a field of a sigma type is stored as a single bit. */
+static bool layout_is_bit(Context *ctx, const Expr *sigma, size_t field) {
+    if (sigma->sigma.layout != SIGMA_LAYOUT_PACKED) {
+        return false;
+    }
+
+    Expr whnf[1] = {layout_whnf(ctx, &sigma->sigma.field_types[field])};
+    bool ret_val = whnf->tag == EXPR_BOOL;
+    expr_free(ctx, whnf);
+    return ret_val;
+}
+
+bool layout_record(Context *ctx, const Expr *sigma, RecordLayout *result) {
+    size_t num_fields = sigma->sigma.num_fields;
+    result->num_fields = num_fields;
+    alloc_array(result->fields, num_fields);
+    alloc_array(result->order, num_fields);
+    alloc_array(result->offsets, num_fields);
+    alloc_array(result->niches, num_fields);
+    alloc_array(result->bits, num_fields);
+
+    // Tagged and packed records store every Bool field by itself.
+    bool use_niches = sigma->sigma.layout == SIGMA_LAYOUT_DERIVED
+        || sigma->sigma.layout == SIGMA_LAYOUT_NICHE;
+
+    symbol_table_enter_scope(&ctx->symbol_table);
+    for (size_t i = 0; i < num_fields; i++) {
+        result->niches[i] = i;
+        result->bits[i] = layout_is_bit(ctx, sigma, i);
+        if (!layout_type(ctx, &sigma->sigma.field_types[i],
+                &result->fields[i])) {
+            symbol_table_leave_scope(&ctx->symbol_table);
+            record_layout_free(result);
+            return false;
+        }
+
+        size_t tag;
+        if (use_niches && layout_niche_tag(ctx, sigma, i, &tag)
+                && result->niches[tag] == tag) {
+            result->niches[tag] = i;
+            result->fields[tag] = layout_erased;
+        }
+
+        if (sigma->sigma.field_names[i] != NULL) {
+            symbol_table_register_local(&ctx->symbol_table,
+                sigma->sigma.field_names[i], sigma->sigma.field_types[i]);
+        }
+    }
+    symbol_table_leave_scope(&ctx->symbol_table);
+
+    // Statically sized fields, most aligned first, with bits last so that
+    // they share bytes. Insertion sort keeps equally aligned fields in their
+    // original order.
+    size_t num_static = 0;
+    for (size_t i = 0; i < num_fields; i++) {
+        if (result->fields[i].is_static) {
+            size_t align = result->bits[i] ? 0 : result->fields[i].align;
+            size_t j = num_static;
+            while (j > 0 && (result->bits[result->order[j - 1]] ? 0
+                    : result->fields[result->order[j - 1]].align) < align) {
+                result->order[j] = result->order[j - 1];
+                j -= 1;
+            }
+            result->order[j] = i;
+            num_static += 1;
+        }
+    }
+
+    // Fields whose sizes depend on other fields come after all of those.
+    size_t num_placed = num_static;
+    for (size_t i = 0; i < num_fields; i++) {
+        if (!result->fields[i].is_static) {
+            result->order[num_placed] = i;
+            num_placed += 1;
+        }
+    }
+
+    size_t offset = 0;
+    size_t align = 1;
+    size_t num_bits = 0;
+    for (size_t i = 0; i < num_fields; i++) {
+        const Layout *field = &result->fields[result->order[i]];
+        align = size_t_max(align, field->align);
+
+        if (result->bits[result->order[i]]) {
+            // Eight bits to a byte.
+            if (num_bits % 8 == 0) {
+                offset += 1;
+            }
+            result->offsets[result->order[i]] = offset - 1;
+            num_bits += 1;
+        } else if (i < num_static) {
+            offset = layout_align_up(offset, field->align);
+            result->offsets[result->order[i]] = offset;
+            offset += field->size;
+        } else {
+            result->offsets[result->order[i]] = 0;
+        }
+    }
+
+    result->num_static = num_static;
+    result->layout = (Layout){
+          .is_static = num_static == num_fields
+        , .size = num_static == num_fields ? layout_align_up(offset, align) : 0
+        , .align = align
+        , .has_niche = false
+    };
+    return true;
+}
+
+void record_layout_free(RecordLayout *layout) {
+    dealloc(layout->fields);
+    dealloc(layout->order);
+    dealloc(layout->offsets);
+    dealloc(layout->niches);
+    dealloc(layout->bits);
+    memset(layout, 0, sizeof *layout);
+}
+
+/***** Vectors ***************************************************************/
+
+/* Whether a type is {T, R} where R does not depend upon the first field. */
+static bool layout_is_cons(Context *ctx, const Expr *type) {
+    if (type->tag != EXPR_SIGMA || type->sigma.num_fields != 2) {
+        return false;
+    } else if (type->sigma.field_names[0] == NULL) {
+        return true;
+    }
+
+    SymbolSet free_vars = symbol_set_empty();
+    expr_free_vars(ctx, &type->sigma.field_types[1], &free_vars);
+    bool ret_val = !symbol_set_contains(&free_vars,
+        type->sigma.field_names[0]);
+    symbol_set_free(&free_vars);
+    return ret_val;
+}
+
+static bool layout_is_nil(const Expr *type) {
+    return type->tag == EXPR_SIGMA && type->sigma.num_fields == 0;
+}
+
+static bool layout_static_vector(Context *ctx, const Expr *sigma,
+        VectorShape *result) {
+    uint64_t length = 0;
+    Expr whnf = expr_copy(ctx, sigma);
+
+    while (layout_is_cons(ctx, &whnf)) {
+        const Expr *elem = &whnf.sigma.field_types[0];
+        if (length == 0) {
+            result->elem = expr_copy(ctx, elem);
+        } else if (!expr_equal(ctx, &result->elem, elem)) {
+            break;
+        }
+
+        Expr tail = layout_whnf(ctx, &whnf.sigma.field_types[1]);
+        expr_free(ctx, &whnf);
+        whnf = tail;
+        length += 1;
+    }
+
+    bool ret_val = length > 0 && layout_is_nil(&whnf);
+    if (ret_val) {
+        result->length = (Expr){
+              .tag = EXPR_NATURAL
+            , .well_typed = true
+            , .natural = natural_small(length)
+        };
+    } else if (length > 0) {
+        expr_free(ctx, &result->elem);
+    }
+
+    expr_free(ctx, &whnf);
+    return ret_val;
+}
+
+/* Recognise F(args) where F(args) unfolds to induction on one of its
+ * arguments, with {} as the base case and {T, F(args)} with that argument
+ * replaced by the predecessor as the inductive case.
+ */
+static bool layout_dynamic_vector(Context *ctx, const Expr *call,
+        VectorShape *result) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    if (call->tag != EXPR_CALL || call->call.func->tag != EXPR_GLOBAL) {
+        return false;
+    }
+
+    size_t global = call->call.func->global;
+    const Expr *lambda = &symbols->global_defines[global];
+    if (!symbols->global_defined[global] || lambda->tag != EXPR_LAMBDA
+            || lambda->lambda.num_params != call->call.num_args) {
+        return false;
+    }
+
+    // The induction is stuck, so the body is not evaluated any further.
+    Expr whnf = expr_copy(ctx, lambda->lambda.body);
+    expr_subst_many(ctx, &whnf, call->call.num_args,
+        lambda->lambda.param_names, call->call.args);
+
+    bool ret_val = false;
+    if (whnf.tag == EXPR_NAT_IND && whnf.nat_ind.goes_down) {
+        const char *pred = whnf.nat_ind.ind_name;
+        Expr base = layout_whnf(ctx, whnf.nat_ind.base_val);
+
+        symbol_table_enter_scope(symbols);
+        symbol_table_register_local(symbols, pred, literal_expr_nat);
+
+        // Keep the inductive case as written, so that its tail is the
+        // application rather than its unfolding.
+        Expr step = whnf.nat_ind.ind_val->tag == EXPR_SIGMA
+            ? expr_copy(ctx, whnf.nat_ind.ind_val)
+            : layout_whnf(ctx, whnf.nat_ind.ind_val);
+
+        Expr tail = expr_copy(ctx, call);
+        for (size_t i = 0; i < tail.call.num_args; i++) {
+            if (expr_equal(ctx, &tail.call.args[i], whnf.nat_ind.natural)) {
+                expr_free(ctx, &tail.call.args[i]);
+                tail.call.args[i] = (Expr){
+                      .tag = EXPR_IDENT
+                    , .well_typed = true
+                    , .ident = pred
+                };
+            }
+        }
+
+        if (layout_is_nil(&base) && layout_is_cons(ctx, &step)
+                && expr_equal(ctx, &step.sigma.field_types[1], &tail)) {
+            SymbolSet free_vars = symbol_set_empty();
+            expr_free_vars(ctx, &step.sigma.field_types[0], &free_vars);
+            ret_val = !symbol_set_contains(&free_vars, pred);
+            symbol_set_free(&free_vars);
+        }
+
+        if (ret_val) {
+            result->elem = expr_copy(ctx, &step.sigma.field_types[0]);
+            result->length = expr_copy(ctx, whnf.nat_ind.natural);
+        }
+
+        symbol_table_leave_scope(symbols);
+        expr_free(ctx, &base);
+        expr_free(ctx, &step);
+        expr_free(ctx, &tail);
+    }
+
+    expr_free(ctx, &whnf);
+    return ret_val;
+}
+
+bool layout_vector(Context *ctx, const Expr *type, VectorShape *result) {
+    Expr whnf = layout_whnf(ctx, type);
+    bool ret_val = whnf.tag == EXPR_SIGMA
+        ? layout_static_vector(ctx, &whnf, result)
+        : layout_dynamic_vector(ctx, &whnf, result);
+    expr_free(ctx, &whnf);
+    return ret_val;
+}
+
+void vector_shape_free(Context *ctx, VectorShape *shape) {
+    expr_free(ctx, &shape->elem);
+    expr_free(ctx, &shape->length);
+}
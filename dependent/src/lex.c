@@ -112,6 +112,8 @@ TokenStream token_stream_new(CharStream source) {
           .source = source
         , .line = 1
         , .column = 1
+        , .last_token = 0
+        , .in_data = false
     };
 }
 
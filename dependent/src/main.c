@@ -1,27 +1,306 @@
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "dependent-c/general.h"
 #include "dependent-c/memory.h"
 
 int yyparse(Context *);
 
-int main(void) {
+static void usage(FILE *to, const char *program) {
+    fprintf(to, "Usage: %s [options] < source\n"
+        "Options:\n"
+        "    --table-cap=BYTES  Limit the memory used for tabling evaluated\n"
+        "                       applications of globals.\n"
+        "    --table-stats      Print tabling statistics after checking.\n"
+        "    --no-compiled-eval Evaluate calls of globals by substituting\n"
+        "                       into their definitions, not compiling them.\n"
+        "    --jit              Compile globals unfolded often in checking to\n"
+        "                       native code, with the C compiler in $CC.\n"
+        "    --jit-threshold=N  Compile globals once unfolded N times.\n"
+        "    --emit-c=FILE      Write the checked program to FILE as C.\n"
+        "    --emit-c-dir=DIR   Write the checked program to DIR as C, split\n"
+        "                       into a file per global with a Makefile.\n"
+        "    --max-specializations=N\n"
+        "                       Limit how many specializations of polymorphic\n"
+        "                       functions are written as C, 1024 by default.\n"
+        "    --run=NAME         Run the global NAME, which must take no\n"
+        "                       parameters, and print its result.\n"
+        "    --bench            Time --run against evaluation by the type\n"
+        "                       checker, without tabling.\n",
+        program);
+}
+
+static double elapsed_ms(clock_t start) {
+    return (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+}
+
+/* Evaluate an expression, along with the fields of any tuples it evaluates
+ * to, since type_eval leaves those as they are.
+ */
+static bool eval_fully(Context *ctx, const Expr *expr, Expr *result) {
+    if (!type_eval(ctx, expr, result)) {
+        return false;
+    }
+
+    if (result->tag == EXPR_PACK) {
+        for (size_t i = 0; i < result->pack.num_fields; i++) {
+            Expr field;
+            if (!eval_fully(ctx, &result->pack.field_values[i], &field)) {
+                expr_free(ctx, result);
+                return false;
+            }
+            expr_free(ctx, &result->pack.field_values[i]);
+            result->pack.field_values[i] = field;
+        }
+    }
+    return true;
+}
+
+/* Write the checked program to path as C. It is generated into a temporary
+ * file first, so that path is only written once the whole program could be
+ * generated, and is otherwise left as it was.
+ */
+static bool emit_c_file(Context *ctx, const char *path) {
+    FILE *temp = tmpfile();
+    if (temp == NULL) {
+        fprintf(stderr, "Could not create a temporary file.\n");
+        return false;
+    }
+
+    bool success = codegen_translation_unit(ctx, temp, &ctx->ast);
+    if (success) {
+        FILE *out = fopen(path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Could not open \"%s\" for writing.\n", path);
+            fclose(temp);
+            return false;
+        }
+
+        char chunk[4096];
+        size_t len;
+        rewind(temp);
+        while ((len = fread(chunk, 1, sizeof chunk, temp)) > 0) {
+            if (fwrite(chunk, 1, len, out) != len) {
+                break;
+            }
+        }
+        bool written = !ferror(temp) && !ferror(out);
+        if (fclose(out) != 0 || !written) {
+            fprintf(stderr, "Could not write \"%s\".\n", path);
+            success = false;
+        }
+    }
+
+    fclose(temp);
+    return success;
+}
+
+/* Run a global by compiling the program to bytecode, optionally comparing
+ * the time taken with evaluating it as the type checker does.
+ */
+static bool run_global(Context *ctx, const char *name, bool bench) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    size_t global;
+    if (!symbol_table_lookup_global(symbols,
+            symbol_intern(&ctx->interns, name), &global)) {
+        fprintf(stderr, "There is no global named \"%s\" to run.\n", name);
+        return false;
+    }
+
+    const Expr *type = &symbols->global_types[global];
+    if (type->tag != EXPR_FORALL || type->forall.num_params != 0) {
+        fprintf(stderr, "Cannot run \"%s\" as it takes parameters.\n", name);
+        return false;
+    }
+
+    bool ret_val = false;
+    Vm vm = vm_new();
+    clock_t start = clock();
+    if (!vm_compile(ctx, &vm, global)) {
+        goto end_of_function;
+    }
+    double compile_ms = elapsed_ms(start);
+
+    VmValue value;
+    start = clock();
+    if (!vm_run(ctx, &vm, global, &value)) {
+        goto end_of_function;
+    }
+    double run_ms = elapsed_ms(start);
+
+    Expr result;
+    bool shown = vm_value_to_expr(ctx, value, type->forall.ret_type, &result);
+    if (shown) {
+        efprintf(ctx, stdout, "%s() = $e\n", ewrap(&result), name);
+    } else {
+        efprintf(ctx, stdout, "%s() has a value of type ($e), which cannot "
+            "be printed.\n", ewrap(type->forall.ret_type), name);
+    }
+    ret_val = true;
+
+    if (bench) {
+        Expr func = {
+              .tag = EXPR_GLOBAL
+            , .well_typed = true
+            , .global = global
+        };
+        Expr call = {
+              .tag = EXPR_CALL
+            , .well_typed = true
+            , .call.func = &func
+            , .call.num_args = 0
+            , .call.args = NULL
+        };
+
+        printf("bytecode: compiled in %.3f ms, ran in %.3f ms\n",
+            compile_ms, run_ms);
+        fflush(stdout);
+
+        // The bytecode does not table calls, so for a fair comparison neither
+        // does type_eval: the tables filled while checking are emptied, and
+        // nothing more is kept in them.
+        for (size_t i = 0; i < symbols->num_globals; i++) {
+            expr_memo_clear(ctx, &symbols->global_tables[i]);
+        }
+        size_t table_cap = ctx->table_cap;
+        ctx->table_bytes = 0;
+        ctx->table_cap = 0;
+
+        Expr evaluated;
+        start = clock();
+        bool evaluated_ok = eval_fully(ctx, &call, &evaluated);
+        double eval_ms = elapsed_ms(start);
+        ctx->table_cap = table_cap;
+
+        // Opaque globals are stuck, so the type checker may not reach the
+        // value the bytecode computes.
+        if (evaluated_ok && (evaluated.tag == EXPR_CALL
+                || evaluated.tag == EXPR_GLOBAL)) {
+            efprintf(ctx, stdout, "type_eval: stuck at ($e)\n",
+                ewrap(&evaluated));
+            expr_free(ctx, &evaluated);
+        } else if (evaluated_ok) {
+            printf("type_eval: evaluated untabled in %.3f ms\n", eval_ms);
+            if (shown && !expr_equal(ctx, &evaluated, &result)) {
+                efprintf(ctx, stdout, "type_eval disagrees: $e\n",
+                    ewrap(&evaluated));
+                ret_val = false;
+            }
+            expr_free(ctx, &evaluated);
+        } else {
+            printf("type_eval: could not evaluate\n");
+        }
+    }
+
+    if (shown) {
+        expr_free(ctx, &result);
+    }
+
+end_of_function:
+    vm_free(&vm);
+    return ret_val;
+}
+
+int main(int argc, char **argv) {
     Context ctx = context_new("<stdin>", file_to_char_stream(stdin));
     ctx.color_enabled = true;
     int ret_value = EXIT_SUCCESS;
+    bool table_stats = false;
+    const char *emit_c = NULL;
+    const char *emit_c_dir = NULL;
+    const char *run = NULL;
+    bool bench = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--table-cap=", strlen("--table-cap=")) == 0) {
+            const char *cap = argv[i] + strlen("--table-cap=");
+            char *end;
+            ctx.table_cap = strtoull(cap, &end, 10);
+            if (*end != '\0') {
+                usage(stderr, argv[0]);
+                context_free(&ctx);
+                return EXIT_FAILURE;
+            }
+        } else if (strncmp(argv[i], "--max-specializations=",
+                strlen("--max-specializations=")) == 0) {
+            const char *cap = argv[i] + strlen("--max-specializations=");
+            char *end;
+            ctx.specialization_cap = strtoull(cap, &end, 10);
+            if (*end != '\0') {
+                usage(stderr, argv[0]);
+                context_free(&ctx);
+                return EXIT_FAILURE;
+            }
+        } else if (strncmp(argv[i], "--jit-threshold=",
+                strlen("--jit-threshold=")) == 0) {
+            const char *threshold = argv[i] + strlen("--jit-threshold=");
+            char *end;
+            ctx.jit.threshold = strtoull(threshold, &end, 10);
+            if (*end != '\0') {
+                usage(stderr, argv[0]);
+                context_free(&ctx);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            ctx.jit.enabled = true;
+        } else if (strncmp(argv[i], "--run=", strlen("--run=")) == 0) {
+            run = argv[i] + strlen("--run=");
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--no-compiled-eval") == 0) {
+            ctx.eval_compiled = false;
+        } else if (strcmp(argv[i], "--table-stats") == 0) {
+            table_stats = true;
+        } else if (strncmp(argv[i], "--emit-c=", strlen("--emit-c=")) == 0) {
+            emit_c = argv[i] + strlen("--emit-c=");
+        } else if (strncmp(argv[i], "--emit-c-dir=",
+                strlen("--emit-c-dir=")) == 0) {
+            emit_c_dir = argv[i] + strlen("--emit-c-dir=");
+        } else {
+            usage(stderr, argv[0]);
+            context_free(&ctx);
+            return EXIT_FAILURE;
+        }
+    }
 
     if (yyparse(&ctx) == 0) {
         printf("Parsed as:\n");
         translation_unit_pprint(&ctx, stdout, &ctx.ast);
         putchar('\n');
 
-        for (size_t i = 0; i < ctx.ast.num_top_levels; i++) {
-            if (!type_check_top_level(&ctx, &ctx.ast.top_levels[i])) {
-                fprintf(stderr, "Failed to type check \"%s\".\n",
-                    ctx.ast.top_levels[i].name);
-                ret_value = EXIT_FAILURE;
+        if (!resolve_translation_unit(&ctx, &ctx.ast)) {
+            ret_value = EXIT_FAILURE;
+        } else {
+            for (size_t i = 0; i < ctx.ast.num_top_levels; i++) {
+                if (!type_check_top_level(&ctx, &ctx.ast.top_levels[i])) {
+                    fprintf(stderr, "Failed to type check \"%s\".\n",
+                        ctx.ast.top_levels[i].name);
+                    ret_value = EXIT_FAILURE;
+                }
             }
         }
+
+        if (emit_c != NULL && ret_value == EXIT_SUCCESS
+                && !emit_c_file(&ctx, emit_c)) {
+            ret_value = EXIT_FAILURE;
+        }
+
+        if (emit_c_dir != NULL && ret_value == EXIT_SUCCESS
+                && !codegen_translation_unit_split(&ctx, emit_c_dir,
+                    &ctx.ast)) {
+            ret_value = EXIT_FAILURE;
+        }
+
+        if (run != NULL && ret_value == EXIT_SUCCESS
+                && !run_global(&ctx, run, bench)) {
+            ret_value = EXIT_FAILURE;
+        }
+
+        if (table_stats) {
+            putchar('\n');
+            symbol_table_pprint_tables(&ctx, stdout, &ctx.symbol_table);
+        }
     } else {
         ret_value = EXIT_FAILURE;
     }
@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Expression Memo Tables ************************************************/
+ExprMemo expr_memo_new(void) {
+    return (ExprMemo){
+          .len = 0
+        , .cap = 0
+        , .hits = 0
+        , .misses = 0
+        , .bytes = 0
+        , .entries = NULL
+    };
+}
+
+void expr_memo_free(Context *ctx, ExprMemo *memo) {
+    expr_memo_clear(ctx, memo);
+    dealloc(memo->entries);
+    memset(memo, 0, sizeof *memo);
+}
+
+void expr_memo_clear(Context *ctx, ExprMemo *memo) {
+    if (memo->len == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < memo->cap; i++) {
+        if (memo->entries[i].occupied) {
+            expr_free(ctx, &memo->entries[i].key);
+            expr_free(ctx, &memo->entries[i].value);
+            memo->entries[i].occupied = false;
+        }
+    }
+
+    memo->len = 0;
+    memo->bytes = 0;
+}
+
+static void expr_memo_resize_if_needed(ExprMemo *memo) {
+    // Growing once from an empty table is not enough to keep a free slot
+    // around for lookups to stop at.
+    while ((memo->len + 1) * 2 >= memo->cap) {
+        size_t old_cap = memo->cap;
+        struct ExprMemoEntry *old_entries = memo->entries;
+
+        size_t new_cap = old_cap * 2 + 1;
+        struct ExprMemoEntry *new_entries;
+        alloc_array(new_entries, new_cap);
+        memset(new_entries, 0, sizeof *new_entries * new_cap);
+
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old_entries[i].occupied) {
+                size_t index = old_entries[i].hash % new_cap;
+
+                while (new_entries[index].occupied) {
+                    index = (index + 1) % new_cap;
+                }
+                new_entries[index] = old_entries[i];
+            }
+        }
+
+        memo->cap = new_cap;
+        memo->entries = new_entries;
+        dealloc(old_entries);
+    }
+}
+
+bool expr_memo_lookup(Context *ctx, ExprMemo *memo,
+        const Expr *key, Expr *result) {
+    if (memo->len == 0) {
+        memo->misses += 1;
+        return false;
+    }
+
+    uint64_t hash = expr_hash(ctx, key);
+    size_t index = hash % memo->cap;
+
+    while (memo->entries[index].occupied) {
+        if (memo->entries[index].hash == hash
+                && expr_equal(ctx, &memo->entries[index].key, key)) {
+            *result = expr_copy(ctx, &memo->entries[index].value);
+            memo->hits += 1;
+            return true;
+        }
+        index = (index + 1) % memo->cap;
+    }
+
+    memo->misses += 1;
+    return false;
+}
+
+void expr_memo_insert(Context *ctx, ExprMemo *memo,
+        const Expr *key, const Expr *value) {
+    expr_memo_resize_if_needed(memo);
+
+    uint64_t hash = expr_hash(ctx, key);
+    size_t index = hash % memo->cap;
+
+    while (memo->entries[index].occupied) {
+        if (memo->entries[index].hash == hash
+                && expr_equal(ctx, &memo->entries[index].key, key)) {
+            return;
+        }
+        index = (index + 1) % memo->cap;
+    }
+
+    memo->entries[index].hash = hash;
+    memo->entries[index].occupied = true;
+    memo->entries[index].key = expr_copy(ctx, key);
+    memo->entries[index].value = expr_copy(ctx, value);
+    memo->len += 1;
+    memo->bytes += expr_memo_entry_size(ctx, key, value);
+}
+
+size_t expr_memo_entry_size(Context *ctx, const Expr *key, const Expr *value) {
+    return sizeof(struct ExprMemoEntry)
+        + (expr_size(ctx, key) + expr_size(ctx, value) - 2) * sizeof(Expr);
+}
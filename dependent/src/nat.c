@@ -0,0 +1,398 @@
+#include <inttypes.h>
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Digits ****************************************************************/
+
+/* View the digits of a natural, using buf for small ones, and return how many
+ * there are without leading zeros.
+ */
+static size_t natural_view(const Natural *n, uint32_t buf[2],
+        const uint32_t **digits) {
+    if (n->num_digits > 0) {
+        *digits = n->digits;
+        return n->num_digits;
+    }
+
+    buf[0] = (uint32_t)n->small;
+    buf[1] = (uint32_t)(n->small >> 32);
+    *digits = buf;
+    return buf[1] != 0 ? 2 : buf[0] != 0 ? 1 : 0;
+}
+
+/* Take ownership of an array of digits, which may have leading zeros. */
+static Natural natural_from_digits(uint32_t *digits, size_t len) {
+    while (len > 0 && digits[len - 1] == 0) {
+        len -= 1;
+    }
+
+    if (len <= 2) {
+        uint64_t small = len == 0 ? 0
+            : len == 1 ? digits[0]
+            : digits[0] | (uint64_t)digits[1] << 32;
+        dealloc(digits);
+        return natural_small(small);
+    }
+
+    realloc_array(digits, len);
+    return (Natural){
+          .small = 0
+        , .num_digits = len
+        , .digits = digits
+    };
+}
+
+static int digits_compare(const uint32_t *x, size_t x_len,
+        const uint32_t *y, size_t y_len) {
+    while (x_len > 0 && x[x_len - 1] == 0) {
+        x_len -= 1;
+    }
+    while (y_len > 0 && y[y_len - 1] == 0) {
+        y_len -= 1;
+    }
+
+    if (x_len != y_len) {
+        return x_len < y_len ? -1 : 1;
+    }
+    for (size_t i = x_len; i-- > 0;) {
+        if (x[i] != y[i]) {
+            return x[i] < y[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* Subtract y from x in place, where x is at least y. */
+static void digits_sub(uint32_t *x, size_t x_len,
+        const uint32_t *y, size_t y_len) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < x_len; i++) {
+        uint64_t subtrahend = (i < y_len ? y[i] : 0) + borrow;
+        borrow = x[i] < subtrahend;
+        x[i] = (uint32_t)(x[i] - subtrahend);
+    }
+}
+
+static uint32_t *digits_copy(const uint32_t *digits, size_t len,
+        size_t new_len) {
+    uint32_t *copy;
+    alloc_array(copy, new_len);
+    memcpy(copy, digits, sizeof *copy * len);
+    memset(copy + len, 0, sizeof *copy * (new_len - len));
+    return copy;
+}
+
+/***** Naturals **************************************************************/
+
+Natural natural_small(uint64_t value) {
+    return (Natural){
+          .small = value
+        , .num_digits = 0
+        , .digits = NULL
+    };
+}
+
+Natural natural_copy(const Natural *n) {
+    if (n->num_digits == 0) {
+        return *n;
+    }
+    return (Natural){
+          .small = 0
+        , .num_digits = n->num_digits
+        , .digits = digits_copy(n->digits, n->num_digits, n->num_digits)
+    };
+}
+
+void natural_free(Natural *n) {
+    dealloc(n->digits);
+    *n = natural_small(0);
+}
+
+bool natural_is_small(const Natural *n) {
+    return n->num_digits == 0;
+}
+
+bool natural_is(const Natural *n, uint64_t value) {
+    return n->num_digits == 0 && n->small == value;
+}
+
+bool natural_equal(const Natural *x, const Natural *y) {
+    if (x->num_digits == 0 || y->num_digits == 0) {
+        return x->num_digits == y->num_digits && x->small == y->small;
+    }
+    return x->num_digits == y->num_digits && memcmp(x->digits, y->digits,
+        sizeof *x->digits * x->num_digits) == 0;
+}
+
+int natural_compare(const Natural *x, const Natural *y) {
+    if (x->num_digits == 0 && y->num_digits == 0) {
+        return (x->small > y->small) - (x->small < y->small);
+    }
+
+    uint32_t x_buf[2], y_buf[2];
+    const uint32_t *x_digits, *y_digits;
+    size_t x_len = natural_view(x, x_buf, &x_digits);
+    size_t y_len = natural_view(y, y_buf, &y_digits);
+    return digits_compare(x_digits, x_len, y_digits, y_len);
+}
+
+uint64_t natural_hash(const Natural *n) {
+    if (n->num_digits == 0) {
+        return n->small;
+    }
+
+    uint64_t hash = n->num_digits;
+    for (size_t i = 0; i < n->num_digits; i++) {
+        hash = (hash ^ n->digits[i]) * UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+/***** Arithmetic ************************************************************/
+
+Natural natural_add(const Natural *x, const Natural *y) {
+    if (x->num_digits == 0 && y->num_digits == 0
+            && x->small + y->small >= x->small) {
+        return natural_small(x->small + y->small);
+    }
+
+    uint32_t x_buf[2], y_buf[2];
+    const uint32_t *x_digits, *y_digits;
+    size_t x_len = natural_view(x, x_buf, &x_digits);
+    size_t y_len = natural_view(y, y_buf, &y_digits);
+    size_t len = (x_len > y_len ? x_len : y_len) + 1;
+
+    uint32_t *digits;
+    alloc_array(digits, len);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < len; i++) {
+        carry += (uint64_t)(i < x_len ? x_digits[i] : 0)
+            + (i < y_len ? y_digits[i] : 0);
+        digits[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    return natural_from_digits(digits, len);
+}
+
+Natural natural_sub(const Natural *x, const Natural *y) {
+    if (natural_compare(x, y) <= 0) {
+        return natural_small(0);
+    } else if (x->num_digits == 0) {
+        return natural_small(x->small - y->small);
+    }
+
+    uint32_t y_buf[2];
+    const uint32_t *y_digits;
+    size_t y_len = natural_view(y, y_buf, &y_digits);
+    uint32_t *digits = digits_copy(x->digits, x->num_digits, x->num_digits);
+    digits_sub(digits, x->num_digits, y_digits, y_len);
+    return natural_from_digits(digits, x->num_digits);
+}
+
+Natural natural_mul(const Natural *x, const Natural *y) {
+    if (x->num_digits == 0 && y->num_digits == 0
+            && (x->small == 0 || y->small <= UINT64_MAX / x->small)) {
+        return natural_small(x->small * y->small);
+    }
+
+    uint32_t x_buf[2], y_buf[2];
+    const uint32_t *x_digits, *y_digits;
+    size_t x_len = natural_view(x, x_buf, &x_digits);
+    size_t y_len = natural_view(y, y_buf, &y_digits);
+    if (x_len == 0 || y_len == 0) {
+        return natural_small(0);
+    }
+
+    size_t len = x_len + y_len;
+    uint32_t *digits;
+    alloc_array(digits, len);
+    memset(digits, 0, sizeof *digits * len);
+    for (size_t i = 0; i < x_len; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < y_len; j++) {
+            carry += (uint64_t)x_digits[i] * y_digits[j] + digits[i + j];
+            digits[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        digits[i + y_len] = (uint32_t)carry;
+    }
+    return natural_from_digits(digits, len);
+}
+
+/* Divide x by y, which is nonzero and at most x. */
+static void natural_divmod(const Natural *x, const Natural *y,
+        Natural *quotient, Natural *remainder) {
+    uint32_t x_buf[2], y_buf[2];
+    const uint32_t *x_digits, *y_digits;
+    size_t x_len = natural_view(x, x_buf, &x_digits);
+    size_t y_len = natural_view(y, y_buf, &y_digits);
+
+    uint32_t *q;
+    alloc_array(q, x_len);
+    memset(q, 0, sizeof *q * x_len);
+
+    if (y_len == 1) {
+        uint64_t rem = 0;
+        for (size_t i = x_len; i-- > 0;) {
+            rem = rem << 32 | x_digits[i];
+            q[i] = (uint32_t)(rem / y_digits[0]);
+            rem %= y_digits[0];
+        }
+        *quotient = natural_from_digits(q, x_len);
+        *remainder = natural_small(rem);
+        return;
+    }
+
+    // Otherwise divide a digit at a time, as in Knuth's Algorithm D, after
+    // shifting both so that the divisor's leading digit has its top bit set.
+    // Each quotient digit is then estimated from the leading digits, and is
+    // at most two too large.
+    unsigned shift = 0;
+    while ((y_digits[y_len - 1] << shift & UINT32_C(0x80000000)) == 0) {
+        shift += 1;
+    }
+    uint32_t *v, *u;
+    alloc_array(v, y_len);
+    alloc_array(u, x_len + 1);
+    for (size_t i = y_len; i-- > 0;) {
+        v[i] = y_digits[i] << shift | (shift == 0 || i == 0 ? 0
+            : y_digits[i - 1] >> (32 - shift));
+    }
+    u[x_len] = shift == 0 ? 0 : x_digits[x_len - 1] >> (32 - shift);
+    for (size_t i = x_len; i-- > 0;) {
+        u[i] = x_digits[i] << shift | (shift == 0 || i == 0 ? 0
+            : x_digits[i - 1] >> (32 - shift));
+    }
+
+    for (size_t j = x_len - y_len + 1; j-- > 0;) {
+        uint64_t top = (uint64_t)u[j + y_len] << 32 | u[j + y_len - 1];
+        uint64_t q_hat = top / v[y_len - 1];
+        uint64_t r_hat = top % v[y_len - 1];
+        while (q_hat > UINT32_MAX || q_hat * v[y_len - 2]
+                > (r_hat << 32 | u[j + y_len - 2])) {
+            q_hat -= 1;
+            r_hat += v[y_len - 1];
+            if (r_hat > UINT32_MAX) {
+                break;
+            }
+        }
+
+        // Subtract q_hat times the divisor, adding it back once if that went
+        // below zero, which the estimate makes rare.
+        uint64_t carry = 0, borrow = 0;
+        for (size_t i = 0; i < y_len; i++) {
+            uint64_t product = q_hat * v[i] + carry;
+            carry = product >> 32;
+            uint64_t diff = (uint64_t)u[i + j] - (uint32_t)product - borrow;
+            u[i + j] = (uint32_t)diff;
+            borrow = diff >> 63;
+        }
+        uint64_t diff = (uint64_t)u[j + y_len] - carry - borrow;
+        u[j + y_len] = (uint32_t)diff;
+
+        if (diff >> 63 != 0) {
+            q_hat -= 1;
+            carry = 0;
+            for (size_t i = 0; i < y_len; i++) {
+                carry += (uint64_t)u[i + j] + v[i];
+                u[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            u[j + y_len] += (uint32_t)carry;
+        }
+        q[j] = (uint32_t)q_hat;
+    }
+
+    // The remainder is what is left of the dividend, shifted back.
+    for (size_t i = 0; i < y_len; i++) {
+        u[i] = u[i] >> shift | (shift == 0 ? 0
+            : u[i + 1] << (32 - shift));
+    }
+    dealloc(v);
+    *quotient = natural_from_digits(q, x_len);
+    *remainder = natural_from_digits(u, y_len);
+}
+
+Natural natural_div(const Natural *x, const Natural *y) {
+    if (natural_is(y, 0)) {
+        return natural_small(0);
+    } else if (x->num_digits == 0 && y->num_digits == 0) {
+        return natural_small(x->small / y->small);
+    } else if (natural_compare(x, y) < 0) {
+        return natural_small(0);
+    }
+
+    Natural quotient, remainder;
+    natural_divmod(x, y, &quotient, &remainder);
+    natural_free(&remainder);
+    return quotient;
+}
+
+Natural natural_mod(const Natural *x, const Natural *y) {
+    if (natural_is(y, 0)) {
+        return natural_small(0);
+    } else if (x->num_digits == 0 && y->num_digits == 0) {
+        return natural_small(x->small % y->small);
+    } else if (natural_compare(x, y) < 0) {
+        return natural_copy(x);
+    }
+
+    Natural quotient, remainder;
+    natural_divmod(x, y, &quotient, &remainder);
+    natural_free(&quotient);
+    return remainder;
+}
+
+void natural_push_decimal(Natural *n, unsigned digit) {
+    if (n->num_digits == 0 && n->small <= (UINT64_MAX - digit) / 10) {
+        n->small = n->small * 10 + digit;
+        return;
+    }
+
+    const Natural ten = natural_small(10), addend = natural_small(digit);
+    Natural scaled = natural_mul(n, &ten);
+    natural_free(n);
+    *n = natural_add(&scaled, &addend);
+    natural_free(&scaled);
+}
+
+/***** Printing **************************************************************/
+
+#define DECIMAL_CHUNK 1000000000
+
+void natural_fprint(FILE *to, const Natural *n) {
+    if (n->num_digits == 0) {
+        fprintf(to, "%" PRIu64, n->small);
+        return;
+    }
+
+    // Split into chunks of nine decimal digits, least significant first, by
+    // repeatedly dividing by 10^9. Each digit holds fewer than ten of them.
+    size_t len = n->num_digits;
+    uint32_t *digits = digits_copy(n->digits, len, len);
+    uint32_t *chunks;
+    alloc_array(chunks, 2 * len);
+    size_t num_chunks = 0;
+    while (len > 0) {
+        uint64_t rem = 0;
+        for (size_t i = len; i-- > 0;) {
+            rem = rem << 32 | digits[i];
+            digits[i] = (uint32_t)(rem / DECIMAL_CHUNK);
+            rem %= DECIMAL_CHUNK;
+        }
+        chunks[num_chunks] = (uint32_t)rem;
+        num_chunks += 1;
+        while (len > 0 && digits[len - 1] == 0) {
+            len -= 1;
+        }
+    }
+
+    fprintf(to, "%" PRIu32, chunks[num_chunks - 1]);
+    for (size_t i = num_chunks - 1; i-- > 0;) {
+        fprintf(to, "%09" PRIu32, chunks[i]);
+    }
+    dealloc(chunks);
+    dealloc(digits);
+}
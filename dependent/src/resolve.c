@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Name Resolution *******************************************************/
+
+/* The names bound by the binders enclosing the expression being resolved,
+ * innermost last, and the number of globals which may be referred to. The
+ * last of those is the global being resolved, and the height it needs to be
+ * above every other global referred to so far is accumulated in height.
+ */
+typedef struct {
+    size_t num_locals;
+    size_t cap_locals;
+    const char **locals;
+
+    size_t num_globals;
+    unsigned height;
+} Scope;
+
+static void scope_push(Scope *scope, const char *name) {
+    if (scope->num_locals == scope->cap_locals) {
+        scope->cap_locals = scope->cap_locals * 2 + 4;
+        realloc_array(scope->locals, scope->cap_locals);
+    }
+    // Unnamed parameters are pushed as NULL so they can be popped uniformly.
+    scope->locals[scope->num_locals] = name;
+    scope->num_locals += 1;
+}
+
+static void scope_pop(Scope *scope, size_t num) {
+    scope->num_locals -= num;
+}
+
+static bool scope_is_local(const Scope *scope, const char *name) {
+    for (size_t i = scope->num_locals; i > 0; i--) {
+        if (scope->locals[i - 1] == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool resolve_expr(Context *ctx, Scope *scope, Expr *expr);
+
+/* Resolve a telescope of binders, each of which scopes over the following
+ * types. The names are left bound, even on failure.
+ */
+static bool resolve_telescope(Context *ctx, Scope *scope, size_t num,
+        const char **names, Expr *types) {
+    bool success = true;
+    for (size_t i = 0; i < num; i++) {
+        success = resolve_expr(ctx, scope, &types[i]) && success;
+        scope_push(scope, names == NULL ? NULL : names[i]);
+    }
+    return success;
+}
+
+/* Resolve every name in an expression, reporting all of those which are
+ * unbound rather than stopping at the first.
+ */
+static bool resolve_expr(Context *ctx, Scope *scope, Expr *expr) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    bool success;
+
+    switch (expr->tag) {
+      case EXPR_GLOBAL:
+      case EXPR_TYPE:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_BOOLEAN:
+      case EXPR_NAT:
+      case EXPR_NATURAL:
+        return true;
+
+      case EXPR_IDENT:
+        if (scope_is_local(scope, expr->ident)) {
+            return true;
+        }
+        for (size_t i = 0; i < scope->num_globals; i++) {
+            if (symbols->global_names[i] == expr->ident) {
+                expr->tag = EXPR_GLOBAL;
+                expr->global = i;
+                // Recursive references don't add to the height.
+                if (i + 1 < scope->num_globals
+                        && symbols->global_heights[i] >= scope->height) {
+                    scope->height = symbols->global_heights[i] + 1;
+                }
+                return true;
+            }
+        }
+        efprintf(ctx, stderr, "Unbound symbol \"%s\".\n", NULL,
+            symbol_name(expr->ident));
+        location_pprint(ctx, ctx->source_name, &expr->location);
+        return false;
+
+      case EXPR_FORALL:
+        success = resolve_telescope(ctx, scope, expr->forall.num_params,
+            expr->forall.param_names, expr->forall.param_types);
+        success = resolve_expr(ctx, scope, expr->forall.ret_type) && success;
+        scope_pop(scope, expr->forall.num_params);
+        return success;
+
+      case EXPR_LAMBDA:
+        success = resolve_telescope(ctx, scope, expr->lambda.num_params,
+            expr->lambda.param_names, expr->lambda.param_types);
+        success = resolve_expr(ctx, scope, expr->lambda.body) && success;
+        scope_pop(scope, expr->lambda.num_params);
+        return success;
+
+      case EXPR_CALL:
+        success = resolve_expr(ctx, scope, expr->call.func);
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            success = resolve_expr(ctx, scope, &expr->call.args[i]) && success;
+        }
+        return success;
+
+      case EXPR_ID:
+        success = resolve_expr(ctx, scope, expr->id.expr1);
+        return resolve_expr(ctx, scope, expr->id.expr2) && success;
+
+      case EXPR_REFLEXIVE:
+        return resolve_expr(ctx, scope, expr->reflexive);
+
+      case EXPR_SUBSTITUTE:
+        success = resolve_expr(ctx, scope, expr->substitute.proof);
+        success = resolve_expr(ctx, scope, expr->substitute.family) && success;
+        return resolve_expr(ctx, scope, expr->substitute.instance) && success;
+
+      case EXPR_EXPLODE:
+        success = resolve_expr(ctx, scope, expr->explode.void_instance);
+        return resolve_expr(ctx, scope, expr->explode.into_type) && success;
+
+      case EXPR_IFTHENELSE:
+        success = resolve_expr(ctx, scope, expr->ifthenelse.predicate);
+        success = resolve_expr(ctx, scope, expr->ifthenelse.then_) && success;
+        return resolve_expr(ctx, scope, expr->ifthenelse.else_) && success;
+
+      case EXPR_NAT_IND:
+        success = resolve_expr(ctx, scope, expr->nat_ind.natural);
+        success = resolve_expr(ctx, scope, expr->nat_ind.base_val) && success;
+        scope_push(scope, expr->nat_ind.ind_name);
+        success = resolve_expr(ctx, scope, expr->nat_ind.ind_val) && success;
+        scope_pop(scope, 1);
+        return success;
+
+      case EXPR_SIGMA:
+        success = resolve_telescope(ctx, scope, expr->sigma.num_fields,
+            expr->sigma.field_names, expr->sigma.field_types);
+        scope_pop(scope, expr->sigma.num_fields);
+        return success;
+
+      case EXPR_PACK:
+        success = expr->pack.as_type == NULL
+            || resolve_expr(ctx, scope, expr->pack.as_type);
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            success = resolve_expr(ctx, scope, &expr->pack.field_values[i])
+                && success;
+        }
+        return success;
+
+      case EXPR_ACCESS:
+        return resolve_expr(ctx, scope, expr->access.record);
+    }
+
+    return false;
+}
+
+static bool resolve_top_level(Context *ctx, Scope *scope,
+        TopLevel *top_level) {
+    switch (top_level->tag) {
+      case TOP_LEVEL_EXPR_DECL: {
+        bool registered = symbol_table_register_global(&ctx->symbol_table,
+            top_level->name, top_level->expr_decl.type);
+        if (!registered) {
+            efprintf(ctx, stderr, "Duplicate definition of \"%s\".\n", NULL,
+                symbol_name(top_level->name));
+            location_pprint(ctx, ctx->source_name, &top_level->location);
+        }
+
+        // A global may refer to itself and those before it, but not to
+        // those after it since they are yet to be checked. A duplicate is
+        // still resolved, to report any unbound names in it too.
+        size_t global = ctx->symbol_table.num_globals - 1;
+        scope->num_globals = global + 1;
+
+        bool success = resolve_expr(ctx, scope, &top_level->expr_decl.type);
+        scope->height = 1;
+        success = resolve_expr(ctx, scope, &top_level->expr_decl.expr)
+            && success;
+        if (!registered || !success) {
+            return false;
+        }
+        ctx->symbol_table.global_heights[global] = scope->height;
+        ctx->symbol_table.global_opaque[global] = top_level->opaque;
+
+        // The symbol table shares everything below the root with the
+        // top-level, so only the roots need updating.
+        ctx->symbol_table.global_types[global] = top_level->expr_decl.type;
+        symbol_table_define_global(&ctx->symbol_table,
+            top_level->name, top_level->expr_decl.expr);
+        return true;
+      }
+    }
+
+    return false;
+}
+
+bool resolve_translation_unit(Context *ctx, TranslationUnit *unit) {
+    Scope scope = {
+          .num_locals = 0
+        , .cap_locals = 0
+        , .locals = NULL
+        , .num_globals = 0
+        , .height = 0
+    };
+
+    builtin_register_all(ctx);
+
+    bool success = true;
+    for (size_t i = 0; i < unit->num_top_levels; i++) {
+        success = resolve_top_level(ctx, &scope, &unit->top_levels[i])
+            && success;
+    }
+
+    dealloc(scope.locals);
+    return success;
+}
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include "dependent-c/general.h"
@@ -100,34 +101,86 @@ const char *symbol_intern(InternedSymbols *interns, const char *str) {
     }
 }
 
-static const char *symbol_gensym_(InternedSymbols *interns, char *str) {
-start_of_function:;
-    uint64_t hash = symbol_hash(str);
-    size_t index = hash % interns->cap;
+/***** Fresh Symbols *********************************************************/
+FreshSymbols symbol_fresh_new(void) {
+    return (FreshSymbols){
+          .len = 0
+        , .cap = 0
+        , .symbols = NULL
+    };
+}
 
-    while (true) {
-        if (interns->symbols[index].symbol == NULL) {
-            const char *result = symbol_intern(interns, str);
-            dealloc(str);
-            return result;
-        } else if (hash == interns->symbols[index].hash
-                && strcmp(str, interns->symbols[index].symbol) == 0) {
-            size_t len = strlen(str);
-            realloc_array(str, len + 2);
-            str[len] = '_';
-            str[len + 1] = '\0';
-            goto start_of_function;
-        } else {
-            index = (index + 1) % interns->cap;
+void symbol_fresh_free_all(FreshSymbols *fresh) {
+    for (size_t i = 0; i < fresh->len; i++) {
+        if (fresh->symbols[i]->rendered != NULL) {
+            dealloc(fresh->symbols[i]->rendered);
         }
+        if (fresh->symbols[i]->mangled != NULL) {
+            dealloc(fresh->symbols[i]->mangled);
+        }
+        dealloc(fresh->symbols[i]);
     }
+
+    dealloc(fresh->symbols);
+    memset(fresh, 0, sizeof *fresh);
 }
 
-const char *symbol_gensym(InternedSymbols *interns, const char *str) {
-    char *str_copy;
-    alloc_array(str_copy, strlen(str) + 1);
-    strcpy(str_copy, str);
-    return symbol_gensym_(interns, str_copy);
+const char *symbol_fresh(FreshSymbols *fresh, const char *symbol) {
+    if (fresh->len == fresh->cap) {
+        fresh->cap = fresh->cap * 2 + 1;
+        realloc_array(fresh->symbols, fresh->cap);
+    }
+
+    // Always number the original symbol rather than nesting fresh symbols.
+    if (symbol[0] == '\0') {
+        symbol = ((const FreshSymbol*)symbol)->base;
+    }
+
+    FreshSymbol *result;
+    alloc_assign(result, ((FreshSymbol){
+          .marker = '\0'
+        , .base = symbol
+        , .number = fresh->len
+        , .rendered = NULL
+        , .mangled = NULL
+    }));
+
+    fresh->symbols[fresh->len] = result;
+    fresh->len += 1;
+    return &result->marker;
+}
+
+const char *symbol_name(const char *symbol) {
+    if (symbol[0] != '\0') {
+        return symbol;
+    }
+
+    FreshSymbol *fresh = (FreshSymbol*)symbol;
+    if (fresh->rendered == NULL) {
+        int len = snprintf(NULL, 0, "%s#%" PRIu64, fresh->base, fresh->number);
+        alloc_array(fresh->rendered, len + 1);
+        snprintf(fresh->rendered, len + 1, "%s#%" PRIu64,
+            fresh->base, fresh->number);
+    }
+
+    return fresh->rendered;
+}
+
+const char *symbol_mangled(const char *symbol) {
+    if (symbol[0] != '\0') {
+        return symbol;
+    }
+
+    FreshSymbol *fresh = (FreshSymbol*)symbol;
+    if (fresh->mangled == NULL) {
+        int len = snprintf(NULL, 0, "%" PRIu64 "_%s", fresh->number,
+            fresh->base);
+        alloc_array(fresh->mangled, len + 1);
+        snprintf(fresh->mangled, len + 1, "%" PRIu64 "_%s",
+            fresh->number, fresh->base);
+    }
+
+    return fresh->mangled;
 }
 
 /***** Symbol Table **********************************************************/
@@ -138,17 +191,42 @@ SymbolTable symbol_table_new(void) {
         , .global_types = NULL
         , .global_defined = NULL
         , .global_defines = NULL
+        , .global_evaluated = NULL
+        , .global_values = NULL
+        , .global_heights = NULL
+        , .global_opaque = NULL
+        , .global_strict = NULL
+        , .global_tables = NULL
+        , .num_builtins = 0
 
         , .locals_stack_size = 0
         , .locals_stack = NULL
     };
 }
 
-void symbol_table_free(SymbolTable *symbols) {
+void symbol_table_free(Context *ctx, SymbolTable *symbols) {
+    // The types of other globals belong to their top-levels.
+    for (size_t i = 0; i < symbols->num_builtins; i++) {
+        expr_free(ctx, &symbols->global_types[i]);
+    }
+    for (size_t i = 0; i < symbols->num_globals; i++) {
+        if (symbols->global_evaluated[i]) {
+            expr_free(ctx, &symbols->global_values[i]);
+        }
+        dealloc(symbols->global_strict[i]);
+        expr_memo_free(ctx, &symbols->global_tables[i]);
+    }
+
     dealloc(symbols->global_names);
     dealloc(symbols->global_types);
     dealloc(symbols->global_defined);
     dealloc(symbols->global_defines);
+    dealloc(symbols->global_evaluated);
+    dealloc(symbols->global_values);
+    dealloc(symbols->global_heights);
+    dealloc(symbols->global_opaque);
+    dealloc(symbols->global_strict);
+    dealloc(symbols->global_tables);
 
     for (size_t i = 0; i < symbols->locals_stack_size; i++) {
         dealloc(symbols->locals_stack[i].local_names);
@@ -180,7 +258,7 @@ void symbol_table_leave_scope(SymbolTable *symbols) {
 bool symbol_table_register_global(SymbolTable *symbols,
         const char *name, Expr type) {
     for (size_t i = 0; i < symbols->num_globals; i++) {
-        if (strcmp(name, symbols->global_names[i]) == 0) {
+        if (name == symbols->global_names[i]) {
             return false;
         }
     }
@@ -192,6 +270,17 @@ bool symbol_table_register_global(SymbolTable *symbols,
     realloc_array(symbols->global_defined, symbols->num_globals + 1);
     symbols->global_defined[symbols->num_globals] = false;
     realloc_array(symbols->global_defines, symbols->num_globals + 1);
+    realloc_array(symbols->global_evaluated, symbols->num_globals + 1);
+    symbols->global_evaluated[symbols->num_globals] = false;
+    realloc_array(symbols->global_values, symbols->num_globals + 1);
+    realloc_array(symbols->global_heights, symbols->num_globals + 1);
+    symbols->global_heights[symbols->num_globals] = 0;
+    realloc_array(symbols->global_opaque, symbols->num_globals + 1);
+    symbols->global_opaque[symbols->num_globals] = false;
+    realloc_array(symbols->global_strict, symbols->num_globals + 1);
+    symbols->global_strict[symbols->num_globals] = NULL;
+    realloc_array(symbols->global_tables, symbols->num_globals + 1);
+    symbols->global_tables[symbols->num_globals] = expr_memo_new();
 
     symbols->num_globals += 1;
     return true;
@@ -200,7 +289,7 @@ bool symbol_table_register_global(SymbolTable *symbols,
 bool symbol_table_define_global(SymbolTable *symbols,
         const char *name, Expr definition) {
     for (size_t i = 0; i < symbols->num_globals; i++) {
-        if (strcmp(name, symbols->global_names[i]) == 0) {
+        if (name == symbols->global_names[i]) {
             if (symbols->global_defined[i]) {
                 return false;
             } else {
@@ -222,7 +311,7 @@ bool symbol_table_register_local(SymbolTable *symbols,
     size_t num_locals = symbols->locals_stack[index].num_locals;
 
     for (size_t i = 0; i < num_locals; i++) {
-        if (strcmp(name, symbols->locals_stack[index].local_names[i]) == 0) {
+        if (name == symbols->locals_stack[index].local_names[i]) {
             return false;
         }
     }
@@ -242,7 +331,7 @@ bool symbol_table_lookup(SymbolTable *symbols,
         size_t i = symbols->locals_stack_size - i_ - 1;
 
         for (size_t j = 0; j < symbols->locals_stack[i].num_locals; j++) {
-            if (strcmp(name, symbols->locals_stack[i].local_names[j]) == 0) {
+            if (name == symbols->locals_stack[i].local_names[j]) {
                 *result = symbols->locals_stack[i].local_types[j];
                 return true;
             }
@@ -250,7 +339,7 @@ bool symbol_table_lookup(SymbolTable *symbols,
     }
 
     for (size_t i = 0; i < symbols->num_globals; i++) {
-        if (strcmp(name, symbols->global_names[i]) == 0) {
+        if (name == symbols->global_names[i]) {
             *result = symbols->global_types[i];
             return true;
         }
@@ -259,19 +348,23 @@ bool symbol_table_lookup(SymbolTable *symbols,
     return false;
 }
 
-bool symbol_table_lookup_define(SymbolTable *symbols,
-        const char *name, Expr *result) {
-    for (size_t i = 0; i < symbols->num_globals; i++) {
-        if (strcmp(name, symbols->global_names[i]) == 0) {
-            if (symbols->global_defined[i]) {
-                *result = symbols->global_defines[i];
-                return true;
-            } else {
+bool symbol_table_lookup_global(SymbolTable *symbols,
+        const char *name, size_t *index) {
+    for (size_t i = 0; i < symbols->locals_stack_size; i++) {
+        for (size_t j = 0; j < symbols->locals_stack[i].num_locals; j++) {
+            if (name == symbols->locals_stack[i].local_names[j]) {
                 return false;
             }
         }
     }
 
+    for (size_t i = 0; i < symbols->num_globals; i++) {
+        if (name == symbols->global_names[i]) {
+            *index = i;
+            return true;
+        }
+    }
+
     return false;
 }
 
@@ -313,13 +406,13 @@ void symbol_table_pprint(Context *ctx, FILE *to, const SymbolTable *symbols) {
         max_name_len = 0;
         for (size_t j = 0; j < symbols->locals_stack[i].num_locals; j++) {
             max_name_len = size_t_max(max_name_len,
-                strlen(symbols->locals_stack[i].local_names[j]));
+                strlen(symbol_name(symbols->locals_stack[i].local_names[j])));
         }
 
         for (size_t j = 0; j < symbols->locals_stack[i].num_locals; j++) {
             fprintf(to, "    ");
             int written = fprintf(to, "%s",
-                symbols->locals_stack[i].local_names[j]);
+                symbol_name(symbols->locals_stack[i].local_names[j]));
             if (written < 0 || written > max_name_len) {
                 putc(' ', to);
             } else {
@@ -334,6 +427,38 @@ void symbol_table_pprint(Context *ctx, FILE *to, const SymbolTable *symbols) {
     }
 }
 
+void symbol_table_pprint_tables(Context *ctx, FILE *to,
+        const SymbolTable *symbols) {
+    size_t total_hits = 0, total_misses = 0, total_bytes = 0;
+
+    fprintf(to, "Evaluated Application Tables\n");
+
+    size_t max_name_len = 0;
+    for (size_t i = 0; i < symbols->num_globals; i++) {
+        max_name_len = size_t_max(max_name_len,
+            strlen(symbols->global_names[i]));
+    }
+
+    for (size_t i = 0; i < symbols->num_globals; i++) {
+        const ExprMemo *table = &symbols->global_tables[i];
+
+        if (table->hits == 0 && table->misses == 0) {
+            continue;
+        }
+
+        fprintf(to, "    %-*s  %zu entries, %zu bytes, %zu hits, %zu misses\n",
+            (int)max_name_len, symbols->global_names[i],
+            table->len, table->bytes, table->hits, table->misses);
+
+        total_hits += table->hits;
+        total_misses += table->misses;
+        total_bytes += table->bytes;
+    }
+
+    fprintf(to, "Total = %zu bytes, %zu hits, %zu misses (cap %zu bytes).\n",
+        total_bytes, total_hits, total_misses, ctx->table_cap);
+}
+
 /***** Symbol Sets ***********************************************************/
 SymbolSet symbol_set_empty(void) {
     return (SymbolSet){
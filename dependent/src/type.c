@@ -6,7 +6,277 @@
 #include "dependent-c/memory.h"
 
 /***** Type Checking / Inference *********************************************/
+static bool type_check_lambda(Context *ctx, const Expr *expr,
+        const Expr *type) {
+    assert(expr->tag == EXPR_LAMBDA);
+    bool ret_val = false;
+
+    Expr forall;
+    if (!type_eval(ctx, type, &forall)) {
+        return false;
+    }
+
+    if (forall.tag != EXPR_FORALL) {
+        efprintf(ctx, stderr, "Cannot check function against non-function "
+            "type ($e).\n", ewrap(type));
+        expr_free(ctx, &forall);
+        return false;
+    }
+
+    if (forall.forall.num_params != expr->lambda.num_params) {
+        efprintf(ctx, stderr, "Cannot check function with %zu parameters "
+            "against function type with %zu parameters.\n", NULL,
+            expr->lambda.num_params, forall.forall.num_params);
+        expr_free(ctx, &forall);
+        return false;
+    }
+
+    // Refer to the parameters by the names the function body uses.
+    size_t num_params = expr->lambda.num_params;
+    Expr *renames;
+    alloc_array(renames, num_params);
+    for (size_t i = 0; i < num_params; i++) {
+        renames[i] = (Expr){
+              .tag = EXPR_IDENT
+            , .well_typed = true
+            , .ident = expr->lambda.param_names[i]
+        };
+    }
+
+    symbol_table_enter_scope(&ctx->symbol_table);
+
+    for (size_t i = 0; i < num_params; i++) {
+        const Expr *param_type = &expr->lambda.param_types[i];
+        Expr expected_type = expr_copy(ctx, &forall.forall.param_types[i]);
+        expr_subst_many(ctx, &expected_type, i,
+            forall.forall.param_names, renames);
+
+        bool param_ok = type_check(ctx, param_type, &literal_expr_type)
+            && type_equal(ctx, param_type, &expected_type);
+        expr_free(ctx, &expected_type);
+        if (!param_ok) {
+            goto end_of_function;
+        }
+
+        symbol_table_register_local(&ctx->symbol_table,
+            expr->lambda.param_names[i], *param_type);
+    }
+
+    expr_subst_many(ctx, forall.forall.ret_type, num_params,
+        forall.forall.param_names, renames);
+
+    symbol_table_enter_scope(&ctx->symbol_table);
+    ret_val = type_check(ctx, expr->lambda.body, forall.forall.ret_type);
+    symbol_table_leave_scope(&ctx->symbol_table);
+
+end_of_function:
+    symbol_table_leave_scope(&ctx->symbol_table);
+    dealloc(renames);
+    expr_free(ctx, &forall);
+    return ret_val;
+}
+
+static bool type_check_pack(Context *ctx, const Expr *expr, const Expr *type) {
+    assert(expr->tag == EXPR_PACK && expr->pack.as_type == NULL);
+    bool ret_val = false;
+
+    Expr sigma;
+    if (!type_eval(ctx, type, &sigma)) {
+        return false;
+    }
+
+    if (sigma.tag != EXPR_SIGMA) {
+        efprintf(ctx, stderr, "Cannot check tuple against non-sigma type "
+            "($e).\n", ewrap(type));
+        goto end_of_function;
+    }
+
+    if (sigma.sigma.num_fields != expr->pack.num_fields) {
+        efprintf(ctx, stderr, "Cannot check tuple with %zu fields against "
+            "sigma with %zu fields.\n", NULL, expr->pack.num_fields,
+            sigma.sigma.num_fields);
+        goto end_of_function;
+    }
+
+    // Each field type sees the values of the fields before it.
+    for (size_t i = 0; i < expr->pack.num_fields; i++) {
+        expr_subst_many(ctx, &sigma.sigma.field_types[i], i,
+            sigma.sigma.field_names, expr->pack.field_values);
+
+        if (!type_check(ctx, &expr->pack.field_values[i],
+                &sigma.sigma.field_types[i])) {
+            goto end_of_function;
+        }
+    }
+
+    ret_val = true;
+
+end_of_function:
+    expr_free(ctx, &sigma);
+    return ret_val;
+}
+
+static bool type_check_nat_ind(Context *ctx, const Expr *expr,
+        const Expr *type) {
+    assert(expr->tag == EXPR_NAT_IND);
+
+    if (!type_check(ctx, expr->nat_ind.natural, &literal_expr_nat)) {
+        efprintf(ctx, stderr, "Cannot perform natural induction on "
+            "non-natural type.\n", NULL);
+        return false;
+    }
+
+    if (!type_check(ctx, expr->nat_ind.base_val, type)) {
+        return false;
+    }
+
+    symbol_table_enter_scope(&ctx->symbol_table);
+    symbol_table_register_local(&ctx->symbol_table,
+        expr->nat_ind.ind_name, literal_expr_nat);
+    bool ret_val = type_check(ctx, expr->nat_ind.ind_val, type);
+    symbol_table_leave_scope(&ctx->symbol_table);
+
+    return ret_val;
+}
+
+/* Enters a scope shadowing the locals bound after the variable name whose
+ * types mention it, with their types refined by replacing name with value.
+ * Locals bound before it refer to an outer variable of the same name, so
+ * they are left alone. The refined types are returned for freeing once the
+ * scope is left.
+ */
+static void type_refine_locals(Context *ctx, const char *name,
+        const Expr *value, size_t *num_refined, Expr **refined) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    SymbolSet seen = symbol_set_empty();
+    size_t num_names = 0;
+    const char **names = NULL;
+    *num_refined = 0;
+    *refined = NULL;
+
+    // Only the innermost binding of each name is visible, so walk from the
+    // innermost local outwards until reaching the binding of name itself.
+    for (size_t i_ = 0; i_ < symbols->locals_stack_size; i_++) {
+        size_t i = symbols->locals_stack_size - i_ - 1;
+        size_t num_locals = symbols->locals_stack[i].num_locals;
+        bool found = false;
+
+        for (size_t j_ = 0; j_ < num_locals; j_++) {
+            size_t j = num_locals - j_ - 1;
+            const char *local = symbols->locals_stack[i].local_names[j];
+            if (local == name) {
+                found = true;
+                break;
+            } else if (symbol_set_contains(&seen, local)) {
+                continue;
+            }
+            symbol_set_add(&seen, local);
+
+            const Expr *type = &symbols->locals_stack[i].local_types[j];
+            SymbolSet free_vars;
+            expr_free_vars(ctx, type, &free_vars);
+            bool mentions = symbol_set_contains(&free_vars, name);
+            symbol_set_free(&free_vars);
+            if (!mentions) {
+                continue;
+            }
+
+            realloc_array(names, num_names + 1);
+            names[num_names] = local;
+            realloc_array(*refined, num_names + 1);
+            (*refined)[num_names] = expr_copy(ctx, type);
+            expr_subst(ctx, &(*refined)[num_names], name, value);
+            num_names += 1;
+        }
+
+        if (found) {
+            break;
+        }
+    }
+
+    symbol_table_enter_scope(symbols);
+    for (size_t i = 0; i < num_names; i++) {
+        symbol_table_register_local(symbols, names[i], (*refined)[i]);
+    }
+    *num_refined = num_names;
+
+    dealloc(names);
+    symbol_set_free(&seen);
+}
+
+/* Checks one branch of an if-then-else on the variable name, which is known
+ * to have the given value in it. The value replaces the variable in the
+ * expected type and in the types of the locals bound after it.
+ */
+static bool type_check_branch(Context *ctx, const Expr *branch,
+        const Expr *type, const char *name, const Expr *value) {
+    size_t num_refined;
+    Expr *refined;
+    type_refine_locals(ctx, name, value, &num_refined, &refined);
+
+    Expr branch_type = expr_copy(ctx, type);
+    expr_subst(ctx, &branch_type, name, value);
+    bool ret_val = type_check(ctx, branch, &branch_type);
+    expr_free(ctx, &branch_type);
+
+    symbol_table_leave_scope(&ctx->symbol_table);
+    for (size_t i = 0; i < num_refined; i++) {
+        expr_free(ctx, &refined[i]);
+    }
+    dealloc(refined);
+    return ret_val;
+}
+
+/* Checks the branches of an if-then-else whose predicate is a variable
+ * against the expected type with the variable replaced by true or false, as
+ * the type may itself branch on it. So may the types of locals, so the
+ * branches also see those refined. Other predicates cannot be replaced, so
+ * those if-then-elses are inferred and compared instead.
+ */
+static bool type_check_ifthenelse(Context *ctx, const Expr *expr,
+        const Expr *type) {
+    assert(expr->tag == EXPR_IFTHENELSE);
+    assert(expr->ifthenelse.predicate->tag == EXPR_IDENT);
+    const char *name = expr->ifthenelse.predicate->ident;
+
+    if (!type_check(ctx, expr->ifthenelse.predicate, &literal_expr_bool)) {
+        return false;
+    }
+
+    return type_check_branch(ctx, expr->ifthenelse.then_, type, name,
+            &literal_expr_true)
+        && type_check_branch(ctx, expr->ifthenelse.else_, type, name,
+            &literal_expr_false);
+}
+
+/* Checks an expression against a known type, pushing the type inwards
+ * through introduction forms and branches so that they never need their
+ * own types synthesized. Anything else is inferred and compared.
+ */
 bool type_check(Context *ctx, const Expr *expr, const Expr *type) {
+    switch (expr->tag) {
+      case EXPR_LAMBDA:
+        return type_check_lambda(ctx, expr, type);
+
+      case EXPR_PACK:
+        if (expr->pack.as_type == NULL) {
+            return type_check_pack(ctx, expr, type);
+        }
+        break;
+
+      case EXPR_IFTHENELSE:
+        if (expr->ifthenelse.predicate->tag == EXPR_IDENT) {
+            return type_check_ifthenelse(ctx, expr, type);
+        }
+        break;
+
+      case EXPR_NAT_IND:
+        return type_check_nat_ind(ctx, expr, type);
+
+      default:
+        break;
+    }
+
     Expr type2[1];
 
     if (!type_infer(ctx, expr, type2)) {
@@ -100,36 +370,53 @@ static bool type_infer_call(Context *ctx, const Expr *expr, Expr *result) {
     }
 
     if (forall.forall.num_params != expr->call.num_args) {
-        fprintf(stderr, "Calling function which expects %zu parameters with "
-            "%zu arguments.\n", forall.forall.num_params,
-            expr->call.num_args);
+        efprintf(ctx, stderr, "Calling function which expects %zu "
+            "parameters with %zu arguments.\n", NULL,
+            forall.forall.num_params, expr->call.num_args);
 
         expr_free(ctx, &forall);
         return false;
     }
 
+    // Each parameter type sees the arguments for the parameters before it.
     for (size_t i = 0; i < forall.forall.num_params; i++) {
-        const Expr arg = expr->call.args[i];
-        const char *param_name = forall.forall.param_names[i];
-
-        if (type_check(ctx, &arg, &forall.forall.param_types[i])) {
-            for (size_t j = i + 1; j < forall.forall.num_params; j++) {
-                expr_subst(ctx, &forall.forall.param_types[j],
-                    param_name, &arg);
-            }
+        Expr param_type = expr_copy(ctx, &forall.forall.param_types[i]);
+        expr_subst_many(ctx, &param_type, i,
+            forall.forall.param_names, expr->call.args);
 
-            expr_subst(ctx, forall.forall.ret_type, param_name, &arg);
-        } else {
+        bool arg_ok = type_check(ctx, &expr->call.args[i], &param_type);
+        expr_free(ctx, &param_type);
+        if (!arg_ok) {
             expr_free(ctx, &forall);
             return false;
         }
     }
 
     *result = expr_copy(ctx, forall.forall.ret_type);
+    expr_subst_many(ctx, result, forall.forall.num_params,
+        forall.forall.param_names, expr->call.args);
     expr_free(ctx, &forall);
     return true;
 }
 
+/* Evaluate a type if it is not already an identity type, returning whether
+ * it is one once evaluated.
+ */
+static bool type_eval_identity(Context *ctx, const Expr *type, Expr *result) {
+    if (type->tag == EXPR_ID) {
+        *result = expr_copy(ctx, type);
+        return true;
+    }
+
+    if (!type_eval(ctx, type, result)) {
+        return false;
+    } else if (result->tag != EXPR_ID) {
+        expr_free(ctx, result);
+        return false;
+    }
+    return true;
+}
+
 static bool type_infer_substitute(Context *ctx, const Expr *expr, Expr *result) {
     assert(expr->tag == EXPR_SUBSTITUTE);
     bool ret_val = false;
@@ -146,11 +433,14 @@ static bool type_infer_substitute(Context *ctx, const Expr *expr, Expr *result)
         goto end_of_function;
     }
 
-    if (proof_type.tag != EXPR_ID) {
+    Expr identity;
+    if (!type_eval_identity(ctx, &proof_type, &identity)) {
         efprintf(ctx, stderr, "Cannot substitute with non-identity type ($e).\n",
             ewrap(&proof_type));
         goto end_of_function;
     }
+    expr_free(ctx, &proof_type);
+    proof_type = identity;
 
     if (!type_infer(ctx, proof_type.id.expr1, &value_type)) {
         goto end_of_function;
@@ -159,11 +449,16 @@ static bool type_infer_substitute(Context *ctx, const Expr *expr, Expr *result)
     // Assume that the proof type given to us is valid, in the sense that both
     // sides have the same type.
 
+    // The family's parameter may have any name, as the result cannot
+    // depend upon it.
+    const char *family_param = family_type.tag == EXPR_FORALL
+        && family_type.forall.num_params == 1
+        ? family_type.forall.param_names[0] : NULL;
     const Expr expected_family = {
           .tag = EXPR_FORALL
         , .forall.num_params = 1
         , .forall.param_types = (Expr[]){value_type}
-        , .forall.param_names = (const char*[]){NULL}
+        , .forall.param_names = (const char*[]){family_param}
         , .forall.ret_type = &literal_expr_type
     };
 
@@ -183,7 +478,7 @@ static bool type_infer_substitute(Context *ctx, const Expr *expr, Expr *result)
     }
 
     result->tag = EXPR_CALL;
-    *result->call.func = expr_copy(ctx, expr->substitute.family);
+    alloc_assign(result->call.func, expr_copy(ctx, expr->substitute.family));
     result->call.num_args = 1;
     alloc_array(result->call.args, 1);
     result->call.args[0] = expr_copy(ctx, proof_type.id.expr2);
@@ -201,8 +496,8 @@ static bool type_infer_nat_ind(Context *ctx, const Expr *expr, Expr *result) {
     assert(expr->tag == EXPR_NAT_IND);
 
     if (!type_check(ctx, expr->nat_ind.natural, &literal_expr_nat)) {
-        fprintf(stderr, "Cannot perform natural induction on non-natural "
-            "type.\n");
+        efprintf(ctx, stderr, "Cannot perform natural induction on "
+            "non-natural type.\n", NULL);
         return false;
     }
 
@@ -228,10 +523,20 @@ static bool type_infer_sigma(Context *ctx, const Expr *expr, Expr *result) {
     assert(expr->tag == EXPR_SIGMA);
     bool ret_val = false;
 
+    bool has_optional = false;
+
     symbol_table_enter_scope(&ctx->symbol_table);
 
     for (size_t i = 0; i < expr->sigma.num_fields; i++) {
         if (type_check(ctx, &expr->sigma.field_types[i], &literal_expr_type)) {
+            size_t tag;
+            Expr payload[1];
+            if (expr->sigma.layout == SIGMA_LAYOUT_NICHE && !has_optional
+                    && layout_optional_field(ctx, expr, i, &tag, payload)) {
+                has_optional = true;
+                expr_free(ctx, payload);
+            }
+
             if (expr->sigma.field_names[i] != NULL) {
                 symbol_table_register_local(&ctx->symbol_table,
                     expr->sigma.field_names[i], expr->sigma.field_types[i]);
@@ -241,6 +546,15 @@ static bool type_infer_sigma(Context *ctx, const Expr *expr, Expr *result) {
         }
     }
 
+    // Whether the payloads have niches may depend upon type parameters, so
+    // that is left to code generation.
+    if (expr->sigma.layout == SIGMA_LAYOUT_NICHE && !has_optional) {
+        efprintf(ctx, stderr, "Cannot use a niche layout for ($e), as none "
+            "of its fields is \"if tag then T else {}\" for an earlier "
+            "Bool field tag.\n", ewrap(expr));
+        goto end_of_function;
+    }
+
     *result = literal_expr_type;
     ret_val = true;
 
@@ -256,6 +570,7 @@ static bool type_infer_pack(Context *ctx, const Expr *expr, Expr *result) {
         Expr sigma;
         sigma.tag = EXPR_SIGMA;
         sigma.sigma.num_fields = expr->pack.num_fields;
+        sigma.sigma.layout = SIGMA_LAYOUT_DERIVED;
         alloc_array(sigma.sigma.field_names, sigma.sigma.num_fields);
         alloc_array(sigma.sigma.field_types, sigma.sigma.num_fields);
 
@@ -283,24 +598,22 @@ static bool type_infer_pack(Context *ctx, const Expr *expr, Expr *result) {
         }
 
         if (expr->pack.as_type->sigma.num_fields != expr->pack.num_fields) {
-            fprintf(stderr, "Cannot case tuple with %zu fields to sigma with "
-                "%zu fields.\n", expr->pack.num_fields,
+            efprintf(ctx, stderr, "Cannot case tuple with %zu fields to "
+                "sigma with %zu fields.\n", NULL, expr->pack.num_fields,
                 expr->pack.as_type->sigma.num_fields);
         }
 
         Expr sigma = expr_copy(ctx, expr->pack.as_type);
 
         for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            expr_subst_many(ctx, &sigma.sigma.field_types[i], i,
+                sigma.sigma.field_names, expr->pack.field_values);
+
             if (!type_check(ctx, &expr->pack.field_values[i],
                     &sigma.sigma.field_types[i])) {
                 expr_free(ctx, &sigma);
                 return false;
             }
-
-            for (size_t j = i + 1; j < sigma.sigma.num_fields; j++) {
-                expr_subst(ctx, &sigma.sigma.field_types[j],
-                    sigma.sigma.field_names[i], &expr->pack.field_values[i]);
-            }
         }
 
         *result = sigma;
@@ -330,27 +643,31 @@ static bool type_infer_access(Context *ctx, const Expr *expr, Expr *result) {
     }
 
     if (expr->access.field_num >= sigma.sigma.num_fields) {
-        fprintf(stderr, "Cannot access field #%zu of sigma with only "
-            "%zu fields.\n", expr->access.field_num, sigma.sigma.num_fields);
+        efprintf(ctx, stderr, "Cannot access field #%zu of sigma with only "
+            "%zu fields.\n", NULL, expr->access.field_num,
+            sigma.sigma.num_fields);
         expr_free(ctx, &sigma);
         return false;
     }
 
     *result = expr_copy(ctx, &sigma.sigma.field_types[expr->access.field_num]);
 
-    for (size_t i = 0; i < expr->access.field_num; i++) {
-        const char *field_name = sigma.sigma.field_names[i];
-
-        if (field_name != NULL) {
-            const Expr replacement = {
-                  .tag = EXPR_ACCESS
-                , .access.record = expr->access.record
-                , .access.field_num = i
-            };
-
-            expr_subst(ctx, result, field_name, &replacement);
-        }
+    // Earlier fields are referred to by accessing them from the same record.
+    size_t num_earlier = expr->access.field_num;
+    Expr *replacements;
+    alloc_array(replacements, num_earlier);
+    for (size_t i = 0; i < num_earlier; i++) {
+        replacements[i] = (Expr){
+              .location = expr->location
+            , .tag = EXPR_ACCESS
+            , .well_typed = expr->well_typed
+            , .access.record = expr->access.record
+            , .access.field_num = i
+        };
     }
+    expr_subst_many(ctx, result, num_earlier,
+        sigma.sigma.field_names, replacements);
+    dealloc(replacements);
 
     expr_free(ctx, &sigma);
     return true;
@@ -379,13 +696,19 @@ bool type_infer(Context *ctx, const Expr *expr, Expr *result) {
 
       case EXPR_IDENT:
         if (!symbol_table_lookup(&ctx->symbol_table, expr->ident, temp)) {
-            fprintf(stderr, "Unbound symbol \"%s\".\n", expr->ident);
+            efprintf(ctx, stderr, "Unbound symbol \"%s\".\n", NULL,
+                symbol_name(expr->ident));
             location_pprint(ctx, ctx->source_name, &expr->location);
             return false;
         }
         *result = expr_copy(ctx, temp);
         return true;
 
+      case EXPR_GLOBAL:
+        *result = expr_copy(ctx,
+            &ctx->symbol_table.global_types[expr->global]);
+        return true;
+
       case EXPR_FORALL:
         return type_infer_forall(ctx, expr, result);
 
@@ -419,9 +742,10 @@ bool type_infer(Context *ctx, const Expr *expr, Expr *result) {
         if (!type_infer(ctx, expr->reflexive, temp)) {
             return false;
         }
+        expr_free(ctx, temp);
         result->tag = EXPR_ID;
-        alloc_assign(result->id.expr1, expr_copy(ctx, temp));
-        alloc_assign(result->id.expr2, *temp);
+        alloc_assign(result->id.expr1, expr_copy(ctx, expr->reflexive));
+        alloc_assign(result->id.expr2, expr_copy(ctx, expr->reflexive));
         return true;
 
       case EXPR_SUBSTITUTE:
@@ -469,20 +793,191 @@ bool type_infer(Context *ctx, const Expr *expr, Expr *result) {
     }
 }
 
-bool type_equal(Context *ctx, const Expr *type1, const Expr *type2) {
+/* Find the defined global at the head of a type, if there is one. */
+static bool type_head_global(Context *ctx, const Expr *type, size_t *global) {
+    const Expr *head = type->tag == EXPR_CALL ? type->call.func : type;
+
+    if (head->tag != EXPR_GLOBAL
+            || !ctx->symbol_table.global_defined[head->global]) {
+        return false;
+    }
+
+    *global = head->global;
+    return true;
+}
+
+/* Unfold the global at the head of a type once, beta reducing its
+ * application but evaluating nothing further.
+ */
+static bool type_unfold_head(Context *ctx, const Expr *type, Expr *result) {
+    size_t global;
+    bool has_head = type_head_global(ctx, type, &global);
+    assert(has_head);
+    (void)has_head;
+    const Expr *define = &ctx->symbol_table.global_defines[global];
+
+    if (type->tag == EXPR_GLOBAL) {
+        *result = expr_copy(ctx, define);
+        return true;
+    }
+
+    // Just to make sure the arguments are of the correct type
+    if (!type->well_typed) {
+        if (!type_infer_call(ctx, type, result)) {
+            return false;
+        }
+        expr_free(ctx, result);
+    }
+
+    if (define->tag == EXPR_LAMBDA
+            && define->lambda.num_params == type->call.num_args) {
+        *result = expr_copy(ctx, define->lambda.body);
+        expr_subst_many(ctx, result, type->call.num_args,
+            define->lambda.param_names, type->call.args);
+    } else {
+        *result = expr_copy(ctx, type);
+        expr_free(ctx, result->call.func);
+        *result->call.func = expr_copy(ctx, define);
+    }
+    return true;
+}
+
+/* Whether the parameter i of a function type is an identity, whose proofs
+ * are all interchangeable, once the arguments before it are substituted into
+ * its type.
+ */
+static bool type_param_irrelevant(Context *ctx, const Expr *func_type,
+        size_t i, const Expr *args) {
+    if (func_type->tag != EXPR_FORALL || i >= func_type->forall.num_params) {
+        return false;
+    }
+
+    Expr param_type = expr_copy(ctx, &func_type->forall.param_types[i]);
+    expr_subst_many(ctx, &param_type, i, func_type->forall.param_names, args);
+
+    Expr identity;
+    bool ret_val = type_eval_identity(ctx, &param_type, &identity);
+    if (ret_val) {
+        expr_free(ctx, &identity);
+    }
+    expr_free(ctx, &param_type);
+    return ret_val;
+}
+
+/* Determine if two types are convertible. Globals are compared by name first
+ * and only unfolded if that fails, the one with the greater height first.
+ * Opaque globals are never unfolded.
+ */
+static bool type_convertible_(Context *ctx,
+        const Expr *type1, const Expr *type2) {
     // TODO, do alpha equivalence rather than simple structural equivalence.
 
+    if (expr_equal(ctx, type1, type2)) {
+        return true;
+    }
+
+    // Applications of the same global are convertible if their arguments
+    // are, which saves unfolding either side. Proofs of identities are
+    // irrelevant, so arguments whose parameter is one are not compared.
+    if (type1->tag == EXPR_CALL && type2->tag == EXPR_CALL
+            && type1->call.func->tag == EXPR_GLOBAL
+            && type2->call.func->tag == EXPR_GLOBAL
+            && type1->call.func->global == type2->call.func->global
+            && type1->call.num_args == type2->call.num_args) {
+        const Expr *func_type =
+            &ctx->symbol_table.global_types[type1->call.func->global];
+        bool args_convertible = true;
+        for (size_t i = 0; i < type1->call.num_args; i++) {
+            if (type_param_irrelevant(ctx, func_type, i,
+                    type1->call.args)) {
+                continue;
+            }
+            if (!type_convertible_(ctx,
+                    &type1->call.args[i], &type2->call.args[i])) {
+                args_convertible = false;
+                break;
+            }
+        }
+        if (args_convertible) {
+            return true;
+        }
+    }
+
+    // Likewise substitutions differ only in their proofs if the rest match.
+    if (type1->tag == EXPR_SUBSTITUTE && type2->tag == EXPR_SUBSTITUTE
+            && type_convertible_(ctx,
+                type1->substitute.family, type2->substitute.family)
+            && type_convertible_(ctx,
+                type1->substitute.instance, type2->substitute.instance)) {
+        return true;
+    }
+
+    const SymbolTable *symbols = &ctx->symbol_table;
+    size_t global1, global2;
+    bool headed1 = type_head_global(ctx, type1, &global1);
+    bool headed2 = type_head_global(ctx, type2, &global2);
+    bool unfold1 = headed1 && !symbols->global_opaque[global1];
+    bool unfold2 = headed2 && !symbols->global_opaque[global2];
+
+    if (unfold1 && unfold2) {
+        if (symbols->global_heights[global1]
+                > symbols->global_heights[global2]) {
+            unfold2 = false;
+        } else if (symbols->global_heights[global1]
+                < symbols->global_heights[global2]) {
+            unfold1 = false;
+        }
+    }
+
+    if (unfold1 || unfold2) {
+        Expr unfolded1[1], unfolded2[1];
+        if (!unfold1) {
+            *unfolded1 = expr_copy(ctx, type1);
+        } else if (!type_unfold_head(ctx, type1, unfolded1)) {
+            return false;
+        }
+        if (!unfold2) {
+            *unfolded2 = expr_copy(ctx, type2);
+        } else if (!type_unfold_head(ctx, type2, unfolded2)) {
+            expr_free(ctx, unfolded1);
+            return false;
+        }
+
+        bool ret_val = type_convertible_(ctx, unfolded1, unfolded2);
+        expr_free(ctx, unfolded1);
+        expr_free(ctx, unfolded2);
+        return ret_val;
+    }
+
+    // Only opaque globals are left at the heads, which must not be unfolded
+    // by evaluation either.
     Expr type1_whnf[1], type2_whnf[1];
-    if (!type_eval(ctx, type1, type1_whnf)) {
+    if (headed1 || !type_eval(ctx, type1, type1_whnf)) {
         *type1_whnf = expr_copy(ctx, type1);
     }
-    if (!type_eval(ctx, type2, type2_whnf)) {
+    if (headed2 || !type_eval(ctx, type2, type2_whnf)) {
         *type2_whnf = expr_copy(ctx, type2);
     }
 
     bool ret_val = expr_equal(ctx, type1_whnf, type2_whnf);
     expr_free(ctx, type1_whnf);
     expr_free(ctx, type2_whnf);
+    return ret_val;
+}
+
+/* Unfolding and evaluating either side may fail, for instance on arguments
+ * which are not well typed or inductions on variables, which only means that
+ * the types are not convertible this way, so nothing is reported.
+ */
+bool type_convertible(Context *ctx, const Expr *type1, const Expr *type2) {
+    ctx->quiet += 1;
+    bool ret_val = type_convertible_(ctx, type1, type2);
+    ctx->quiet -= 1;
+    return ret_val;
+}
+
+bool type_equal(Context *ctx, const Expr *type1, const Expr *type2) {
+    bool ret_val = type_convertible(ctx, type1, type2);
 
     if (!ret_val) {
         efprintf(ctx, stderr, "Could not determine that ($e) ~ ($e).\n",
@@ -492,9 +987,26 @@ bool type_equal(Context *ctx, const Expr *type1, const Expr *type2) {
     return ret_val;
 }
 
-static bool type_eval_call(Context *ctx, const Expr *type, Expr *result) {
+static bool type_eval_beta(Context *ctx, const Expr *type, Expr *result) {
     assert(type->tag == EXPR_CALL);
 
+    // Calls of globals run natively once they are hot, or otherwise their
+    // compiled definition instead of substituting the arguments into it.
+    const EvalCode *code = type->call.func->tag == EXPR_GLOBAL
+        ? eval_global_code(ctx, type->call.func->global) : NULL;
+    if (code != NULL && eval_code_num_params(code) == type->call.num_args) {
+        if (!type->well_typed) {
+            if (!type_infer_call(ctx, type, result)) {
+                return false;
+            }
+            expr_free(ctx, result);
+        }
+        if (jit_eval_call(ctx, type, result)) {
+            return true;
+        }
+        return eval_apply(ctx, code, type->call.args, result);
+    }
+
     Expr reduced_func[1];
     if (!type_eval(ctx, type->call.func, reduced_func)) {
         return false;
@@ -510,32 +1022,305 @@ static bool type_eval_call(Context *ctx, const Expr *type, Expr *result) {
     }
 
     // Just to make sure the arguments are of the correct type
-    if (!type_infer_call(ctx, type, result)) {
+    if (!type->well_typed) {
+        if (!type_infer_call(ctx, type, result)) {
+            expr_free(ctx, reduced_func);
+            return false;
+        }
+        expr_free(ctx, result);
+    }
+
+    if (reduced_func->lambda.num_params != type->call.num_args) {
+        efprintf(ctx, stderr, "Cannot evaluate call of function ($e) with "
+            "%zu arguments.\n", ewrap(reduced_func), type->call.num_args);
         expr_free(ctx, reduced_func);
         return false;
     }
-    expr_free(ctx, result);
 
-    for (size_t i = 0; i < type->call.num_args; i++) {
-        expr_subst(ctx, reduced_func->lambda.body,
-            reduced_func->lambda.param_names[i], &type->call.args[i]);
-    }
+    expr_subst_many(ctx, reduced_func->lambda.body, type->call.num_args,
+        reduced_func->lambda.param_names, type->call.args);
 
     bool ret_val = type_eval(ctx, reduced_func->lambda.body, result);
     expr_free(ctx, reduced_func);
     return ret_val;
 }
 
+/* Evaluate a global by unfolding its definition. The evaluated definition is
+ * kept in the symbol table so that it is only ever computed once.
+ */
+static bool type_eval_global(Context *ctx, const Expr *type, Expr *result) {
+    assert(type->tag == EXPR_GLOBAL);
+    SymbolTable *symbols = &ctx->symbol_table;
+    size_t global = type->global;
+
+    // Opaque globals are stuck, as they are for conversion.
+    if (!symbols->global_defined[global] || symbols->global_opaque[global]) {
+        *result = expr_copy(ctx, type);
+        return true;
+    }
+
+    if (!symbols->global_evaluated[global]) {
+        Expr value[1];
+        if (!type_eval(ctx, &symbols->global_defines[global], value)) {
+            return false;
+        }
+        // Evaluating the definition may have evaluated the global itself.
+        if (symbols->global_evaluated[global]) {
+            expr_free(ctx, value);
+        } else {
+            symbols->global_values[global] = *value;
+            symbols->global_evaluated[global] = true;
+        }
+    }
+
+    *result = expr_copy(ctx, &symbols->global_values[global]);
+    return true;
+}
+
+/* Whether an expression only refers to globals, in which case its value does
+ * not depend upon the current scope.
+ */
+static bool type_is_closed(Context *ctx, const Expr *expr) {
+    SymbolSet free_vars[1];
+    expr_free_vars(ctx, expr, free_vars);
+
+    bool ret_val = free_vars->size == 0;
+    symbol_set_free(free_vars);
+    return ret_val;
+}
+
+/* The globals whose strictness is being computed, innermost first. */
+typedef struct StrictFrame {
+    size_t global;
+    const bool *strict; // The current assumption, while iterating.
+    const struct StrictFrame *next;
+} StrictFrame;
+
+static const bool *type_strict_params(Context *ctx, size_t global,
+    const StrictFrame *frames);
+
+/* Whether evaluating an expression to weak head normal form always evaluates
+ * the variable param, or fails or diverges without it.
+ */
+static bool type_strict_in(Context *ctx, const Expr *expr, const char *param,
+        const StrictFrame *frames) {
+    switch (expr->tag) {
+      case EXPR_IDENT:
+        return expr->ident == param;
+
+      case EXPR_IFTHENELSE:
+        // The predicate is skipped when the branches are convertible.
+        return type_strict_in(ctx, expr->ifthenelse.then_, param, frames)
+            && type_strict_in(ctx, expr->ifthenelse.else_, param, frames);
+
+      case EXPR_NAT_IND:
+        return type_strict_in(ctx, expr->nat_ind.natural, param, frames)
+            || (type_strict_in(ctx, expr->nat_ind.base_val, param, frames)
+                && expr->nat_ind.ind_name != param
+                && type_strict_in(ctx, expr->nat_ind.ind_val, param, frames));
+
+      case EXPR_ACCESS:
+        return type_strict_in(ctx, expr->access.record, param, frames);
+
+      case EXPR_CALL: {
+        if (expr->call.func->tag != EXPR_GLOBAL) {
+            return false;
+        }
+        size_t global = expr->call.func->global;
+        const bool *strict;
+        if (builtin_lookup(&ctx->symbol_table, global) != NULL) {
+            strict = NULL;
+        } else if (frames->global == global) {
+            strict = frames->strict;
+        } else {
+            strict = type_strict_params(ctx, global, frames);
+            if (strict == NULL) {
+                return false;
+            }
+        }
+
+        const Expr *type = &ctx->symbol_table.global_types[global];
+        if (type->tag != EXPR_FORALL
+                || type->forall.num_params != expr->call.num_args) {
+            return false;
+        }
+        for (size_t i = 0; i < expr->call.num_args; i++) {
+            if ((strict == NULL || strict[i])
+                    && type_strict_in(ctx, &expr->call.args[i], param,
+                        frames)) {
+                return true;
+            }
+        }
+        return false;
+      }
+
+      default:
+        return false;
+    }
+}
+
+/* Which parameters a defined global is strict in, or NULL if unknown. A
+ * global's recursive calls are first assumed strict in every parameter, and
+ * the assumption is weakened until it holds.
+ */
+static const bool *type_strict_params(Context *ctx, size_t global,
+        const StrictFrame *frames) {
+    SymbolTable *symbols = &ctx->symbol_table;
+    if (symbols->global_strict[global] != NULL) {
+        return symbols->global_strict[global];
+    }
+
+    const Expr *define = &symbols->global_defines[global];
+    if (!symbols->global_defined[global] || symbols->global_opaque[global]
+            || define->tag != EXPR_LAMBDA) {
+        return NULL;
+    }
+    for (const StrictFrame *frame = frames; frame != NULL;
+            frame = frame->next) {
+        if (frame->global == global) {
+            return NULL;
+        }
+    }
+
+    size_t num_params = define->lambda.num_params;
+    bool *strict;
+    alloc_array(strict, num_params == 0 ? 1 : num_params);
+    for (size_t i = 0; i < num_params; i++) {
+        strict[i] = true;
+    }
+
+    const StrictFrame frame = {
+          .global = global
+        , .strict = strict
+        , .next = frames
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < num_params; i++) {
+            if (strict[i] && !type_strict_in(ctx, define->lambda.body,
+                    define->lambda.param_names[i], &frame)) {
+                strict[i] = false;
+                changed = true;
+            }
+        }
+    }
+
+    symbols->global_strict[global] = strict;
+    return strict;
+}
+
+const bool *type_global_strict(Context *ctx, size_t global) {
+    return type_strict_params(ctx, global, NULL);
+}
+
+/* Evaluate a closed application of a global, reusing the result of any
+ * earlier application to the same arguments anywhere in the translation
+ * unit. Only the arguments the global is strict in are evaluated for the
+ * key, as forcing the others could diverge where the call would not.
+ */
+static bool type_eval_tabled_call(Context *ctx, const Expr *type,
+        size_t global, Expr *result) {
+    assert(type->tag == EXPR_CALL);
+    ExprMemo *table = &ctx->symbol_table.global_tables[global];
+    const bool *strict = type_strict_params(ctx, global, NULL);
+    const Expr *define = &ctx->symbol_table.global_defines[global];
+    if (strict != NULL && define->lambda.num_params != type->call.num_args) {
+        strict = NULL;
+    }
+    bool ret_val = false;
+
+    Expr key = {
+          .location = type->location
+        , .tag = EXPR_CALL
+        , .well_typed = type->well_typed
+        , .call.num_args = type->call.num_args
+    };
+    alloc_assign(key.call.func, expr_copy(ctx, type->call.func));
+    alloc_array(key.call.args, key.call.num_args);
+
+    // Initialize all arguments to a trivially freeable value
+    for (size_t i = 0; i < key.call.num_args; i++) {
+        key.call.args[i] = literal_expr_type;
+    }
+
+    for (size_t i = 0; i < key.call.num_args; i++) {
+        if (strict == NULL || !strict[i]) {
+            key.call.args[i] = expr_copy(ctx, &type->call.args[i]);
+        } else if (!type_eval(ctx, &type->call.args[i], &key.call.args[i])) {
+            goto end_of_function;
+        }
+    }
+
+    if (expr_memo_lookup(ctx, table, &key, result)) {
+        ret_val = true;
+        goto end_of_function;
+    }
+
+    if (!type_eval_beta(ctx, &key, result)) {
+        goto end_of_function;
+    }
+    ret_val = true;
+
+    size_t entry_size = expr_memo_entry_size(ctx, &key, result);
+    if (ctx->table_bytes + entry_size <= ctx->table_cap) {
+        size_t old_bytes = table->bytes;
+        expr_memo_insert(ctx, table, &key, result);
+        ctx->table_bytes += table->bytes - old_bytes;
+    }
+
+end_of_function:
+    expr_free(ctx, &key);
+    return ret_val;
+}
+
+static bool type_eval_call(Context *ctx, const Expr *type, Expr *result) {
+    assert(type->tag == EXPR_CALL);
+
+    const Builtin *builtin = type->call.func->tag == EXPR_GLOBAL
+        ? builtin_lookup(&ctx->symbol_table, type->call.func->global) : NULL;
+    if (builtin != NULL) {
+        if (!type->well_typed) {
+            if (!type_infer_call(ctx, type, result)) {
+                return false;
+            }
+            expr_free(ctx, result);
+        }
+        return builtin_eval_call(ctx, builtin, type, result);
+    }
+
+    // Applications of opaque globals are stuck, leaving their arguments for
+    // conversion to compare.
+    if (type->call.func->tag == EXPR_GLOBAL
+            && ctx->symbol_table.global_opaque[type->call.func->global]) {
+        if (!type->well_typed) {
+            if (!type_infer_call(ctx, type, result)) {
+                return false;
+            }
+            expr_free(ctx, result);
+        }
+        *result = expr_copy(ctx, type);
+        return true;
+    }
+
+    if (type->call.func->tag == EXPR_GLOBAL
+            && ctx->symbol_table.global_defined[type->call.func->global]
+            && type_is_closed(ctx, type)) {
+        return type_eval_tabled_call(ctx, type, type->call.func->global,
+            result);
+    }
+
+    return type_eval_beta(ctx, type, result);
+}
+
 static bool type_eval_ifthenelse(Context *ctx, const Expr *type,
         Expr *result) {
     assert(type->tag == EXPR_IFTHENELSE);
 
-    // If both sides of the if branch are equivalent we can reduce to that
-    if (type_equal(ctx, type->ifthenelse.then_, type->ifthenelse.else_)) {
+    // If both sides of the if branch are equivalent we can reduce to that.
+    // Branches usually differ, so this is not worth reporting.
+    if (type_convertible(ctx, type->ifthenelse.then_, type->ifthenelse.else_)) {
         return type_eval(ctx, type->ifthenelse.then_, result);
-    } else {
-        fprintf(stderr, "    While checking if both if-then-else branches "
-            "have the same type.\n");
     }
 
     Expr reduced_cond[1];
@@ -557,6 +1342,34 @@ static bool type_eval_ifthenelse(Context *ctx, const Expr *type,
 
 static bool type_eval_substitute(Context *ctx, const Expr *type, Expr *result) {
     assert(type->tag == EXPR_SUBSTITUTE);
+    const Expr *proof = type->substitute.proof;
+
+    // Any proof of x = y may stand in for reflexive(x) once x and y are known
+    // to be convertible, so the proof itself need not be evaluated. Variables
+    // have the type they were bound with, which depends on the scope.
+    if (proof->tag == EXPR_REFLEXIVE) {
+        *result = expr_copy(ctx, type->substitute.instance);
+        return true;
+    } else if (proof->well_typed || proof->tag == EXPR_IDENT) {
+        Expr proof_type, identity;
+        if (!type_is_closed(ctx, proof)) {
+            ctx->eval_scoped = true;
+        }
+        if (type_infer(ctx, proof, &proof_type)) {
+            bool irrelevant = false;
+            if (type_eval_identity(ctx, &proof_type, &identity)) {
+                irrelevant = type_convertible(ctx,
+                    identity.id.expr1, identity.id.expr2);
+                expr_free(ctx, &identity);
+            }
+            expr_free(ctx, &proof_type);
+
+            if (irrelevant) {
+                *result = expr_copy(ctx, type->substitute.instance);
+                return true;
+            }
+        }
+    }
 
     Expr reduced_refl;
     if (!type_eval(ctx, type->substitute.proof, &reduced_refl)) {
@@ -591,20 +1404,31 @@ static bool type_eval_nat_ind(Context *ctx, const Expr *type, Expr *result) {
     }
 
     if (reduced_nat.tag == EXPR_NATURAL) {
-        if (reduced_nat.natural == (type->nat_ind.goes_down ? 0 : UINT64_MAX)) {
+        const Natural one = natural_small(1);
+        if (natural_is(&reduced_nat.natural,
+                type->nat_ind.goes_down ? 0 : UINT64_MAX)) {
             bool ret_val = type_eval(ctx, type->nat_ind.base_val, result);
             expr_free(ctx, &reduced_nat);
             return ret_val;
+        } else if (!type->nat_ind.goes_down
+                && !natural_is_small(&reduced_nat.natural)) {
+            efprintf(ctx, stderr, "Cannot count up to NAT_MAX from $e, "
+                "which is above it.\n", ewrap(&reduced_nat));
+            expr_free(ctx, &reduced_nat);
+            return false;
         } else {
             Expr ind_val = expr_copy(ctx, type->nat_ind.ind_val);
-            const Expr replacement = {
+            Expr replacement = {
                   .tag = EXPR_NATURAL
-                , .natural = reduced_nat.natural
-                    + (type->nat_ind.goes_down ? -1 : +1)
+                , .well_typed = true
+                , .natural = type->nat_ind.goes_down
+                    ? natural_sub(&reduced_nat.natural, &one)
+                    : natural_add(&reduced_nat.natural, &one)
             };
             expr_subst(ctx, &ind_val, type->nat_ind.ind_name, &replacement);
             bool ret_val = type_eval(ctx, &ind_val, result);
             expr_free(ctx, &reduced_nat);
+            expr_free(ctx, &replacement);
             expr_free(ctx, &ind_val);
             return ret_val;
         }
@@ -648,11 +1472,10 @@ static bool type_eval_access(Context *ctx, const Expr *type, Expr *result) {
     }
 }
 
-bool type_eval(Context *ctx, const Expr *type, Expr *result) {
-    Expr temp[1];
-
+static bool type_eval_(Context *ctx, const Expr *type, Expr *result) {
     switch (type->tag) {
       // These are all already in weak head normal form.
+      case EXPR_IDENT:
       case EXPR_TYPE:
       case EXPR_FORALL:     case EXPR_LAMBDA:
       case EXPR_ID:         case EXPR_REFLEXIVE:
@@ -663,14 +1486,8 @@ bool type_eval(Context *ctx, const Expr *type, Expr *result) {
         *result = expr_copy(ctx, type);
         return true;
 
-      case EXPR_IDENT:
-        if (symbol_table_lookup_define(&ctx->symbol_table,
-                type->ident, temp)) {
-            return type_eval(ctx, temp, result);
-        } else {
-            *result = expr_copy(ctx, type);
-            return true;
-        }
+      case EXPR_GLOBAL:
+        return type_eval_global(ctx, type, result);
 
       case EXPR_CALL:
         return type_eval_call(ctx, type, result);
@@ -692,17 +1509,113 @@ bool type_eval(Context *ctx, const Expr *type, Expr *result) {
     }
 }
 
-bool type_check_top_level(Context *ctx, const TopLevel *top_level) {
+/* Evaluation is call-by-need: a redex is reduced at most once per outermost
+ * call to type_eval, with later occurrences of a structurally equal redex
+ * (repeated calls, or arguments substituted into several places) reusing the
+ * shared result. Since evaluation is by substitution, equal syntax within a
+ * single evaluation denotes the same value, unless reducing it looked up the
+ * types of locals, which may be bound differently where the syntax recurs.
+ * Such results are not shared.
+ */
+static bool type_eval_shared(Context *ctx, const Expr *type, Expr *result) {
+    switch (type->tag) {
+      case EXPR_CALL:
+      case EXPR_SUBSTITUTE:
+      case EXPR_IFTHENELSE:
+      case EXPR_NAT_IND:
+      case EXPR_ACCESS:
+        break;
+
+      default:
+        return type_eval_(ctx, type, result);
+    }
+
+    if (expr_memo_lookup(ctx, &ctx->eval_shared, type, result)) {
+        return true;
+    }
+
+    bool scoped = ctx->eval_scoped;
+    ctx->eval_scoped = false;
+    bool ret_val = type_eval_(ctx, type, result);
+    if (ret_val && !ctx->eval_scoped) {
+        expr_memo_insert(ctx, &ctx->eval_shared, type, result);
+    }
+    ctx->eval_scoped = scoped || ctx->eval_scoped;
+    return ret_val;
+}
+
+bool type_eval(Context *ctx, const Expr *type, Expr *result) {
+    // Evaluation recurses on the C stack, so recursion too deep to evaluate
+    // is reported before it overflows the stack. This is reported even in
+    // quiet checks, which would otherwise fail for no stated reason.
+    if (ctx->eval_depth >= ctx->eval_depth_cap) {
+        unsigned quiet = ctx->quiet;
+        ctx->quiet = 0;
+        efprintf(ctx, stderr, "Evaluation exceeded the maximum depth of %u.\n",
+            NULL, ctx->eval_depth_cap);
+        ctx->quiet = quiet;
+        return false;
+    }
+
+    ctx->eval_depth += 1;
+    bool ret_val = type_eval_shared(ctx, type, result);
+    ctx->eval_depth -= 1;
+
+    if (ctx->eval_depth == 0) {
+        expr_memo_clear(ctx, &ctx->eval_shared);
+    }
+
+    return ret_val;
+}
+
+bool type_eval_transparent(Context *ctx, const Expr *type, Expr *result) {
+    if (!type_eval(ctx, type, result)) {
+        return false;
+    }
+
+    size_t global;
+    while (type_head_global(ctx, result, &global)
+            && ctx->symbol_table.global_opaque[global]) {
+        Expr unfolded[1];
+        bool unfolded_ok = type_unfold_head(ctx, result, unfolded);
+        expr_free(ctx, result);
+        if (!unfolded_ok) {
+            return false;
+        }
+        bool ret_val = type_eval(ctx, unfolded, result);
+        expr_free(ctx, unfolded);
+        if (!ret_val) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool type_unfold(Context *ctx, const Expr *type, Expr *result) {
+    size_t global;
+    return type_head_global(ctx, type, &global)
+        && type_unfold_head(ctx, type, result);
+}
+
+bool type_check_top_level(Context *ctx, TopLevel *top_level) {
     switch (top_level->tag) {
       case TOP_LEVEL_EXPR_DECL:
-        symbol_table_register_global(&ctx->symbol_table,
-            top_level->name, top_level->expr_decl.type);
-        symbol_table_define_global(&ctx->symbol_table,
-            top_level->name, top_level->expr_decl.expr);
         if (!type_check(ctx, &top_level->expr_decl.expr,
                 &top_level->expr_decl.type)) {
             return false;
         }
+        // The symbol table shares everything below the root with the
+        // top-level, so this marks its copies too. Their roots are marked
+        // separately.
+        expr_mark_well_typed(ctx, &top_level->expr_decl.type);
+        expr_mark_well_typed(ctx, &top_level->expr_decl.expr);
+
+        size_t global;
+        if (symbol_table_lookup_global(&ctx->symbol_table,
+                top_level->name, &global)) {
+            ctx->symbol_table.global_types[global].well_typed = true;
+            ctx->symbol_table.global_defines[global].well_typed = true;
+        }
         return true;
     }
 }
@@ -0,0 +1,998 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "dependent-c/general.h"
+#include "dependent-c/memory.h"
+
+/***** Instructions **********************************************************/
+
+/* Each instruction is a word holding its opcode followed by a word for each
+ * of its operands.
+ */
+#define VM_OPS(X) \
+    X(OP_CONST)             /* value: push the value. */ \
+    X(OP_LOAD)              /* slot: push a local. */ \
+    X(OP_JUMP)              /* target */ \
+    X(OP_JUMP_FALSE)        /* target: pop a Bool, jumping if it is false. */ \
+    X(OP_CASE_DOWN)         /* slot, target: pop a Nat, jumping if it is 0 */ \
+                            /* and storing its predecessor otherwise. */ \
+    X(OP_CASE_UP)           /* slot, target: likewise for NAT_MAX and the */ \
+                            /* successor. */ \
+    X(OP_TUPLE)             /* num: pop that many fields into a tuple. */ \
+    X(OP_FIELD)             /* field: replace a tuple with a field of it. */ \
+    X(OP_CLOSURE)           /* function, num: pop that many captures into */ \
+                            /* a closure. */ \
+    X(OP_CALL)              /* function, num: call with that many args. */ \
+    X(OP_TAIL_CALL)         /* function, num: likewise, replacing the */ \
+                            /* current frame. */ \
+    X(OP_CALL_CLOSURE)      /* num: pop a closure and call it with that */ \
+                            /* many args. */ \
+    X(OP_TAIL_CALL_CLOSURE) /* num: likewise, replacing the current frame. */ \
+    X(OP_BUILTIN)           /* builtin, num: replace that many args with */ \
+                            /* the result of the builtin. */ \
+    X(OP_RETURN)            /* Return the top of the stack. */ \
+    X(OP_TRAP)              /* Reached explode. */
+
+#define VM_ENUM(op) op,
+typedef enum {
+    VM_OPS(VM_ENUM)
+} VmOp;
+#undef VM_ENUM
+
+/* Dispatch straight from one instruction to the next where labels can be
+ * used as values, which is a GNU extension. Otherwise, as when building for
+ * strict ISO C, fall back to a switch.
+ */
+#if defined(__GNUC__) && !defined(__STRICT_ANSI__)
+# define VM_THREADED 1
+#endif
+
+/***** Arena *****************************************************************/
+
+#define VM_CHUNK_SIZE 4096
+
+static void vm_arena_reset(Vm *vm) {
+    for (size_t i = 0; i < vm->num_chunks; i++) {
+        dealloc(vm->chunks[i]);
+    }
+    dealloc(vm->chunks);
+    dealloc(vm->spare_chunk);
+    vm->num_chunks = 0;
+    vm->chunk_used = 0;
+    vm->chunk_cap = 0;
+}
+
+static VmMark vm_arena_save(const Vm *vm) {
+    return (VmMark){
+          .num_chunks = vm->num_chunks
+        , .chunk_used = vm->chunk_used
+        , .chunk_cap = vm->chunk_cap
+    };
+}
+
+/* Free everything allocated since a mark, keeping a chunk of the usual size
+ * so that calls allocating across the end of a chunk do not reallocate it
+ * each time.
+ */
+static void vm_arena_release(Vm *vm, const VmMark *mark) {
+    for (size_t i = vm->num_chunks; i-- > mark->num_chunks;) {
+        if (vm->spare_chunk == NULL && i == vm->num_chunks - 1
+                && vm->chunk_cap == VM_CHUNK_SIZE) {
+            vm->spare_chunk = vm->chunks[i];
+        } else {
+            dealloc(vm->chunks[i]);
+        }
+    }
+    vm->num_chunks = mark->num_chunks;
+    vm->chunk_used = mark->chunk_used;
+    vm->chunk_cap = mark->chunk_cap;
+}
+
+static VmValue *vm_arena_alloc(Vm *vm, size_t num) {
+    if (vm->num_chunks == 0 || vm->chunk_used + num > vm->chunk_cap) {
+        vm->chunk_cap = num > VM_CHUNK_SIZE ? num : VM_CHUNK_SIZE;
+        vm->chunk_used = 0;
+        realloc_array(vm->chunks, vm->num_chunks + 1);
+        if (vm->chunk_cap == VM_CHUNK_SIZE && vm->spare_chunk != NULL) {
+            vm->chunks[vm->num_chunks] = vm->spare_chunk;
+            vm->spare_chunk = NULL;
+        } else {
+            alloc_array(vm->chunks[vm->num_chunks], vm->chunk_cap);
+        }
+        vm->num_chunks += 1;
+    }
+
+    VmValue *ret_val = vm->chunks[vm->num_chunks - 1] + vm->chunk_used;
+    vm->chunk_used += num;
+    return ret_val;
+}
+
+static VmValue vm_pointer(const VmValue *words) {
+    return (VmValue)(uintptr_t)words;
+}
+
+static VmValue *vm_words(VmValue value) {
+    return (VmValue*)(uintptr_t)value;
+}
+
+/***** Compilation ***********************************************************/
+
+typedef struct {
+    Context *ctx;
+    Vm *vm;
+
+    // The locals in scope of the function being compiled, innermost last.
+    size_t num_bound;
+    struct VmBound {
+        const char *name;
+        size_t slot;
+    } *bound;
+    size_t num_locals;
+    size_t depth;
+    size_t max_depth;
+
+    // Globals referred to but not yet compiled, and which have been queued.
+    size_t num_queued;
+    size_t *queued;
+    bool *reached;
+
+    // Local functions found but not yet compiled.
+    size_t num_pending;
+    struct VmPending {
+        size_t function;
+        const Expr *lambda;
+        size_t num_captures;
+        const char **captures;
+    } *pending;
+} VmCompiler;
+
+static void vm_emit(VmCompiler *comp, uint64_t word) {
+    Vm *vm = comp->vm;
+    if (vm->code_len == vm->code_cap) {
+        vm->code_cap = vm->code_cap == 0 ? 256 : vm->code_cap * 2;
+        realloc_array(vm->code, vm->code_cap);
+    }
+    vm->code[vm->code_len] = word;
+    vm->code_len += 1;
+}
+
+/* Emit a placeholder operand, returning where to patch it. */
+static size_t vm_emit_target(VmCompiler *comp) {
+    vm_emit(comp, SIZE_MAX);
+    return comp->vm->code_len - 1;
+}
+
+static void vm_patch_target(VmCompiler *comp, size_t at) {
+    comp->vm->code[at] = comp->vm->code_len;
+}
+
+/* Track the depth of the operand stack as values are pushed and popped. */
+static void vm_stack(VmCompiler *comp, size_t pushed, size_t popped) {
+    assert(comp->depth >= popped);
+    comp->depth = comp->depth - popped + pushed;
+    if (comp->depth > comp->max_depth) {
+        comp->max_depth = comp->depth;
+    }
+}
+
+static size_t vm_bind(VmCompiler *comp, const char *name) {
+    realloc_array(comp->bound, comp->num_bound + 1);
+    comp->bound[comp->num_bound] = (struct VmBound){
+          .name = name
+        , .slot = comp->num_locals
+    };
+    comp->num_bound += 1;
+    comp->num_locals += 1;
+    return comp->num_locals - 1;
+}
+
+static size_t vm_add_function(Vm *vm) {
+    realloc_array(vm->functions, vm->num_functions + 1);
+    vm->functions[vm->num_functions] = (struct VmFunction){
+          .entry = SIZE_MAX
+        , .num_captures = 0
+        , .num_locals = 0
+        , .frame_size = 0
+        , .result_words = SIZE_MAX
+    };
+    vm->num_functions += 1;
+    return vm->num_functions - 1;
+}
+
+/* Whether a global is a builtin or has a definition which is compiled to a
+ * function, in which case it is queued to be compiled unless it has been
+ * already.
+ */
+static bool vm_has_function(VmCompiler *comp, size_t global) {
+    const SymbolTable *symbols = &comp->ctx->symbol_table;
+    if (builtin_lookup(symbols, global) == NULL
+            && (!symbols->global_defined[global]
+                || symbols->global_defines[global].tag != EXPR_LAMBDA)) {
+        fprintf(stderr, "Cannot compile a reference to \"%s\", as it is not "
+            "a defined function.\n", symbols->global_names[global]);
+        return false;
+    }
+
+    if (!comp->reached[global]) {
+        comp->reached[global] = true;
+        realloc_array(comp->queued, comp->num_queued + 1);
+        comp->queued[comp->num_queued] = global;
+        comp->num_queued += 1;
+    }
+    return true;
+}
+
+static bool vm_compile_expr(VmCompiler *comp, const Expr *expr, bool tail);
+
+/* Push a closure of a local function capturing the locals it refers to, and
+ * queue the function to be compiled once the current one is done.
+ */
+static void vm_compile_lambda(VmCompiler *comp, const Expr *lambda) {
+    SymbolSet free_vars = symbol_set_empty();
+    expr_free_vars(comp->ctx, lambda, &free_vars);
+
+    struct VmPending pending = {
+          .function = vm_add_function(comp->vm)
+        , .lambda = lambda
+        , .num_captures = 0
+    };
+    alloc_array(pending.captures, comp->num_bound);
+
+    for (size_t i = comp->num_bound; i-- > 0;) {
+        const char *name = comp->bound[i].name;
+        if (symbol_set_contains(&free_vars, name)) {
+            symbol_set_delete(&free_vars, name);
+            pending.captures[pending.num_captures] = name;
+            pending.num_captures += 1;
+
+            vm_emit(comp, OP_LOAD);
+            vm_emit(comp, comp->bound[i].slot);
+            vm_stack(comp, 1, 0);
+        }
+    }
+    symbol_set_free(&free_vars);
+
+    vm_emit(comp, OP_CLOSURE);
+    vm_emit(comp, pending.function);
+    vm_emit(comp, pending.num_captures);
+    vm_stack(comp, 1, pending.num_captures);
+
+    realloc_array(comp->pending, comp->num_pending + 1);
+    comp->pending[comp->num_pending] = pending;
+    comp->num_pending += 1;
+}
+
+static bool vm_compile_call(VmCompiler *comp, const Expr *expr, bool tail) {
+    assert(expr->tag == EXPR_CALL);
+    const Expr *func = expr->call.func;
+    size_t num_args = expr->call.num_args;
+
+    for (size_t i = 0; i < num_args; i++) {
+        if (!vm_compile_expr(comp, &expr->call.args[i], false)) {
+            return false;
+        }
+    }
+
+    if (func->tag == EXPR_GLOBAL
+            && builtin_lookup(&comp->ctx->symbol_table, func->global)
+                != NULL) {
+        // Builtins run in place, so even in tail position they return.
+        vm_emit(comp, OP_BUILTIN);
+        vm_emit(comp, func->global);
+        vm_emit(comp, num_args);
+        vm_stack(comp, 1, num_args);
+        if (tail) {
+            vm_emit(comp, OP_RETURN);
+        }
+        return true;
+    } else if (func->tag == EXPR_GLOBAL) {
+        if (!vm_has_function(comp, func->global)) {
+            return false;
+        }
+        vm_emit(comp, tail ? OP_TAIL_CALL : OP_CALL);
+        vm_emit(comp, func->global);
+    } else {
+        if (!vm_compile_expr(comp, func, false)) {
+            return false;
+        }
+        vm_emit(comp, tail ? OP_TAIL_CALL_CLOSURE : OP_CALL_CLOSURE);
+        vm_stack(comp, 0, 1);
+    }
+    vm_emit(comp, num_args);
+    vm_stack(comp, 1, num_args);
+    return true;
+}
+
+static bool vm_compile_expr(VmCompiler *comp, const Expr *expr, bool tail) {
+    size_t depth = comp->depth;
+    size_t else_, end;
+
+    switch (expr->tag) {
+      case EXPR_IDENT:
+        for (size_t i = comp->num_bound; i-- > 0;) {
+            if (comp->bound[i].name == expr->ident) {
+                vm_emit(comp, OP_LOAD);
+                vm_emit(comp, comp->bound[i].slot);
+                vm_stack(comp, 1, 0);
+                break;
+            }
+        }
+        if (comp->depth == depth) {
+            fprintf(stderr, "Cannot compile unbound variable \"%s\".\n",
+                symbol_name(expr->ident));
+            return false;
+        }
+        break;
+
+      case EXPR_GLOBAL:
+        // A global used as a value is a closure capturing nothing.
+        if (!vm_has_function(comp, expr->global)) {
+            return false;
+        }
+        vm_emit(comp, OP_CLOSURE);
+        vm_emit(comp, expr->global);
+        vm_emit(comp, 0);
+        vm_stack(comp, 1, 0);
+        break;
+
+      // Types and proofs are erased.
+      case EXPR_TYPE:
+      case EXPR_FORALL:
+      case EXPR_ID:
+      case EXPR_REFLEXIVE:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_NAT:
+      case EXPR_SIGMA:
+        vm_emit(comp, OP_CONST);
+        vm_emit(comp, 0);
+        vm_stack(comp, 1, 0);
+        break;
+
+      case EXPR_LAMBDA:
+        vm_compile_lambda(comp, expr);
+        break;
+
+      case EXPR_CALL:
+        return vm_compile_call(comp, expr, tail);
+
+      case EXPR_SUBSTITUTE:
+        // Rewriting by a proof does not change the value.
+        return vm_compile_expr(comp, expr->substitute.instance, tail);
+
+      case EXPR_EXPLODE:
+        vm_emit(comp, OP_TRAP);
+        vm_stack(comp, 1, 0);
+        break;
+
+      case EXPR_BOOLEAN:
+        vm_emit(comp, OP_CONST);
+        vm_emit(comp, expr->boolean);
+        vm_stack(comp, 1, 0);
+        break;
+
+      case EXPR_NATURAL:
+        if (!natural_is_small(&expr->natural)) {
+            fprintf(stderr, "Cannot compile a natural literal of more than 64 "
+                "bits.\n");
+            return false;
+        }
+        vm_emit(comp, OP_CONST);
+        vm_emit(comp, expr->natural.small);
+        vm_stack(comp, 1, 0);
+        break;
+
+      case EXPR_IFTHENELSE:
+        if (!vm_compile_expr(comp, expr->ifthenelse.predicate, false)) {
+            return false;
+        }
+        vm_emit(comp, OP_JUMP_FALSE);
+        else_ = vm_emit_target(comp);
+        vm_stack(comp, 0, 1);
+
+        if (!vm_compile_expr(comp, expr->ifthenelse.then_, tail)) {
+            return false;
+        }
+        if (!tail) {
+            vm_emit(comp, OP_JUMP);
+            end = vm_emit_target(comp);
+        }
+
+        comp->depth = depth;
+        vm_patch_target(comp, else_);
+        if (!vm_compile_expr(comp, expr->ifthenelse.else_, tail)) {
+            return false;
+        }
+        if (!tail) {
+            vm_patch_target(comp, end);
+        }
+        return true;
+
+      case EXPR_NAT_IND: {
+        if (!vm_compile_expr(comp, expr->nat_ind.natural, false)) {
+            return false;
+        }
+        size_t num_bound = comp->num_bound;
+        vm_emit(comp, expr->nat_ind.goes_down ? OP_CASE_DOWN : OP_CASE_UP);
+        vm_emit(comp, vm_bind(comp, expr->nat_ind.ind_name));
+        size_t base = vm_emit_target(comp);
+        vm_stack(comp, 0, 1);
+
+        bool ind_ok = vm_compile_expr(comp, expr->nat_ind.ind_val, tail);
+        comp->num_bound = num_bound;
+        if (!ind_ok) {
+            return false;
+        }
+        if (!tail) {
+            vm_emit(comp, OP_JUMP);
+            end = vm_emit_target(comp);
+        }
+
+        comp->depth = depth;
+        vm_patch_target(comp, base);
+        if (!vm_compile_expr(comp, expr->nat_ind.base_val, tail)) {
+            return false;
+        }
+        if (!tail) {
+            vm_patch_target(comp, end);
+        }
+        return true;
+      }
+
+      case EXPR_PACK:
+        for (size_t i = 0; i < expr->pack.num_fields; i++) {
+            if (!vm_compile_expr(comp, &expr->pack.field_values[i], false)) {
+                return false;
+            }
+        }
+        vm_emit(comp, OP_TUPLE);
+        vm_emit(comp, expr->pack.num_fields);
+        vm_stack(comp, 1, expr->pack.num_fields);
+        break;
+
+      case EXPR_ACCESS:
+        if (!vm_compile_expr(comp, expr->access.record, false)) {
+            return false;
+        }
+        vm_emit(comp, OP_FIELD);
+        vm_emit(comp, expr->access.field_num);
+        break;
+    }
+
+    if (tail) {
+        vm_emit(comp, OP_RETURN);
+    }
+    return true;
+}
+
+/* Whether values of a type are represented without referring to the arena.
+ * Values of the empty record are tuples, but have no fields to read.
+ */
+static bool vm_is_unboxed(Context *ctx, const Expr *type) {
+    Expr whnf[1];
+    ctx->quiet += 1;
+    bool evaluated = type_eval_transparent(ctx, type, whnf);
+    ctx->quiet -= 1;
+    if (!evaluated) {
+        return false;
+    }
+
+    bool ret_val;
+    switch (whnf->tag) {
+      case EXPR_TYPE:
+      case EXPR_ID:
+      case EXPR_VOID:
+      case EXPR_BOOL:
+      case EXPR_NAT:
+        ret_val = true;
+        break;
+
+      case EXPR_SIGMA:
+        ret_val = whnf->sigma.num_fields == 0;
+        break;
+
+      case EXPR_IFTHENELSE:
+        ret_val = vm_is_unboxed(ctx, whnf->ifthenelse.then_)
+            && vm_is_unboxed(ctx, whnf->ifthenelse.else_);
+        break;
+
+      default:
+        ret_val = false;
+        break;
+    }
+
+    expr_free(ctx, whnf);
+    return ret_val;
+}
+
+/* How results of a type refer to the arena, as for result_words. */
+static size_t vm_result_words(Context *ctx, const Expr *type) {
+    if (vm_is_unboxed(ctx, type)) {
+        return 0;
+    }
+
+    Expr whnf[1];
+    ctx->quiet += 1;
+    bool evaluated = type_eval_transparent(ctx, type, whnf);
+    ctx->quiet -= 1;
+    if (!evaluated) {
+        return SIZE_MAX;
+    }
+
+    size_t ret_val = SIZE_MAX;
+    if (whnf->tag == EXPR_SIGMA) {
+        ret_val = whnf->sigma.num_fields;
+        for (size_t i = 0; i < whnf->sigma.num_fields; i++) {
+            if (!vm_is_unboxed(ctx, &whnf->sigma.field_types[i])) {
+                ret_val = SIZE_MAX;
+                break;
+            }
+        }
+    }
+
+    expr_free(ctx, whnf);
+    return ret_val;
+}
+
+/* Compile a function whose arguments are the parameters of a lambda followed
+ * by the locals it captures, with the type of its result if it is known.
+ */
+static bool vm_compile_function(VmCompiler *comp, size_t function,
+        const Expr *lambda, const Expr *ret_type, size_t num_captures,
+        const char **captures) {
+    assert(lambda->tag == EXPR_LAMBDA);
+    comp->num_bound = 0;
+    comp->num_locals = 0;
+    comp->depth = 0;
+    comp->max_depth = 0;
+
+    for (size_t i = 0; i < lambda->lambda.num_params; i++) {
+        vm_bind(comp, lambda->lambda.param_names[i]);
+    }
+    for (size_t i = 0; i < num_captures; i++) {
+        vm_bind(comp, captures[i]);
+    }
+
+    struct VmFunction *entry = &comp->vm->functions[function];
+    entry->entry = comp->vm->code_len;
+    if (!vm_compile_expr(comp, lambda->lambda.body, true)) {
+        return false;
+    }
+
+    entry = &comp->vm->functions[function];
+    entry->num_captures = num_captures;
+    entry->num_locals = comp->num_locals;
+    entry->frame_size = comp->num_locals + comp->max_depth;
+    entry->result_words = ret_type != NULL
+        ? vm_result_words(comp->ctx, ret_type) : SIZE_MAX;
+    return true;
+}
+
+/* Compile the function standing for a builtin used as a value, which calls
+ * the builtin with its arguments.
+ */
+static void vm_compile_builtin(VmCompiler *comp, size_t global) {
+    const Builtin *builtin = builtin_lookup(&comp->ctx->symbol_table, global);
+    struct VmFunction *entry = &comp->vm->functions[global];
+    entry->entry = comp->vm->code_len;
+    entry->num_captures = 0;
+    entry->num_locals = builtin->num_params;
+    entry->frame_size = 2 * builtin->num_params;
+    entry->result_words = 0;
+
+    for (size_t i = 0; i < builtin->num_params; i++) {
+        vm_emit(comp, OP_LOAD);
+        vm_emit(comp, i);
+    }
+    vm_emit(comp, OP_BUILTIN);
+    vm_emit(comp, global);
+    vm_emit(comp, builtin->num_params);
+    vm_emit(comp, OP_RETURN);
+}
+
+bool vm_compile(Context *ctx, Vm *vm, size_t global) {
+    const SymbolTable *symbols = &ctx->symbol_table;
+    VmCompiler comp = {
+          .ctx = ctx
+        , .vm = vm
+        , .num_bound = 0
+        , .bound = NULL
+        , .num_queued = 0
+        , .queued = NULL
+        , .num_pending = 0
+        , .pending = NULL
+    };
+
+    // Functions of globals come first, so they are added on the first call.
+    if (vm->num_globals == 0) {
+        vm->num_globals = symbols->num_globals;
+        for (size_t i = 0; i < symbols->num_globals; i++) {
+            vm_add_function(vm);
+        }
+    }
+    assert(vm->num_globals == symbols->num_globals);
+    size_t code_len = vm->code_len;
+    size_t num_functions = vm->num_functions;
+
+    // Globals compiled by an earlier call count as reached, so that they are
+    // not compiled again.
+    alloc_array(comp.reached, symbols->num_globals);
+    for (size_t i = 0; i < symbols->num_globals; i++) {
+        comp.reached[i] = vm->functions[i].entry != SIZE_MAX;
+    }
+    bool success = comp.reached[global] || vm_has_function(&comp, global);
+
+    while (success && comp.num_queued > 0) {
+        comp.num_queued -= 1;
+        size_t next = comp.queued[comp.num_queued];
+        if (builtin_lookup(symbols, next) != NULL) {
+            vm_compile_builtin(&comp, next);
+            continue;
+        }
+        const Expr *type = &symbols->global_types[next];
+        success = vm_compile_function(&comp, next,
+            &symbols->global_defines[next],
+            type->tag == EXPR_FORALL ? type->forall.ret_type : NULL, 0, NULL);
+        while (success && comp.num_pending > 0) {
+            comp.num_pending -= 1;
+            struct VmPending pending = comp.pending[comp.num_pending];
+            success = vm_compile_function(&comp, pending.function,
+                pending.lambda, NULL, pending.num_captures,
+                pending.captures);
+            dealloc(pending.captures);
+        }
+    }
+
+    // Drop whatever was compiled by this call, so that what is left can
+    // still be run.
+    if (!success) {
+        vm->code_len = code_len;
+        vm->num_functions = num_functions;
+        for (size_t i = 0; i < symbols->num_globals; i++) {
+            if (vm->functions[i].entry >= code_len) {
+                vm->functions[i].entry = SIZE_MAX;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < comp.num_pending; i++) {
+        dealloc(comp.pending[i].captures);
+    }
+    dealloc(comp.pending);
+    dealloc(comp.queued);
+    dealloc(comp.reached);
+    dealloc(comp.bound);
+    return success;
+}
+
+/***** Execution *************************************************************/
+
+Vm vm_new(void) {
+    return (Vm){
+          .code_len = 0
+        , .code_cap = 0
+        , .code = NULL
+        , .num_functions = 0
+        , .functions = NULL
+        , .num_globals = 0
+        , .stack_cap = 0
+        , .stack = NULL
+        , .frames_cap = 0
+        , .frames = NULL
+        , .num_chunks = 0
+        , .chunks = NULL
+        , .chunk_used = 0
+        , .chunk_cap = 0
+        , .spare_chunk = NULL
+    };
+}
+
+void vm_free(Vm *vm) {
+    vm_arena_reset(vm);
+    dealloc(vm->code);
+    dealloc(vm->functions);
+    dealloc(vm->stack);
+    dealloc(vm->frames);
+    memset(vm, 0, sizeof *vm);
+}
+
+static void vm_reserve_stack(Vm *vm, size_t size) {
+    if (size > vm->stack_cap) {
+        vm->stack_cap = size * 2;
+        realloc_array(vm->stack, vm->stack_cap);
+    }
+}
+
+static void vm_reserve_frames(Vm *vm, size_t size) {
+    if (size > vm->frames_cap) {
+        vm->frames_cap = size * 2;
+        realloc_array(vm->frames, vm->frames_cap);
+    }
+}
+
+bool vm_run(Context *ctx, Vm *vm, size_t global, VmValue *result) {
+    const uint64_t *code = vm->code;
+    const struct VmFunction *functions = vm->functions;
+    const struct VmFunction *function = &functions[global];
+    if (function->entry == SIZE_MAX) {
+        fprintf(stderr, "Cannot run \"%s\" as it was not compiled.\n",
+            ctx->symbol_table.global_names[global]);
+        return false;
+    }
+
+    vm_arena_reset(vm);
+    vm_reserve_stack(vm, function->frame_size);
+    vm_reserve_frames(vm, 1);
+
+    VmValue *stack = vm->stack;
+    size_t num_frames = 0;
+    size_t base = 0;
+    size_t sp = function->num_locals;
+    size_t pc = function->entry;
+
+    uint64_t callee, num_args;
+    VmValue value, *words;
+    const Builtin *builtin;
+
+    // Enter a function whose arguments and captures start at base.
+#define VM_ENTER(func) \
+    do { \
+        function = &functions[func]; \
+        if (base + function->frame_size > vm->stack_cap) { \
+            vm_reserve_stack(vm, base + function->frame_size); \
+            stack = vm->stack; \
+        } \
+        sp = base + function->num_locals; \
+        pc = function->entry; \
+    } while (0)
+
+#define VM_PUSH_FRAME() \
+    do { \
+        vm_reserve_frames(vm, num_frames + 1); \
+        vm->frames[num_frames] = (struct VmFrame){ \
+              .return_to = pc \
+            , .base = base \
+            , .function = function \
+            , .mark = vm_arena_save(vm) \
+        }; \
+        num_frames += 1; \
+    } while (0)
+
+#ifdef VM_THREADED
+# define VM_LABEL(op) [op] = &&label_##op,
+    static const void *const labels[] = {
+        VM_OPS(VM_LABEL)
+    };
+# undef VM_LABEL
+# define VM_CASE(op) label_##op
+# define VM_NEXT goto *labels[code[pc++]]
+    VM_NEXT;
+#else
+# define VM_CASE(op) case op
+# define VM_NEXT continue
+    while (true) switch ((VmOp)code[pc++]) {
+#endif
+
+    VM_CASE(OP_CONST):
+        stack[sp++] = code[pc++];
+        VM_NEXT;
+
+    VM_CASE(OP_LOAD):
+        stack[sp++] = stack[base + code[pc++]];
+        VM_NEXT;
+
+    VM_CASE(OP_JUMP):
+        pc = code[pc];
+        VM_NEXT;
+
+    VM_CASE(OP_JUMP_FALSE):
+        pc = stack[--sp] ? pc + 1 : code[pc];
+        VM_NEXT;
+
+    VM_CASE(OP_CASE_DOWN):
+        value = stack[--sp];
+        if (value == 0) {
+            pc = code[pc + 1];
+        } else {
+            stack[base + code[pc]] = value - 1;
+            pc += 2;
+        }
+        VM_NEXT;
+
+    VM_CASE(OP_CASE_UP):
+        value = stack[--sp];
+        if (value == UINT64_MAX) {
+            pc = code[pc + 1];
+        } else {
+            stack[base + code[pc]] = value + 1;
+            pc += 2;
+        }
+        VM_NEXT;
+
+    VM_CASE(OP_TUPLE):
+        num_args = code[pc++];
+        words = vm_arena_alloc(vm, num_args);
+        sp -= num_args;
+        memcpy(words, &stack[sp], sizeof *words * num_args);
+        stack[sp++] = vm_pointer(words);
+        VM_NEXT;
+
+    VM_CASE(OP_FIELD):
+        stack[sp - 1] = vm_words(stack[sp - 1])[code[pc++]];
+        VM_NEXT;
+
+    VM_CASE(OP_CLOSURE):
+        callee = code[pc++];
+        num_args = code[pc++];
+        words = vm_arena_alloc(vm, num_args + 1);
+        sp -= num_args;
+        words[0] = callee;
+        memcpy(words + 1, &stack[sp], sizeof *words * num_args);
+        stack[sp++] = vm_pointer(words);
+        VM_NEXT;
+
+    VM_CASE(OP_CALL):
+        callee = code[pc++];
+        num_args = code[pc++];
+        VM_PUSH_FRAME();
+        base = sp - num_args;
+        VM_ENTER(callee);
+        VM_NEXT;
+
+    VM_CASE(OP_TAIL_CALL):
+        callee = code[pc++];
+        num_args = code[pc++];
+        memmove(&stack[base], &stack[sp - num_args],
+            sizeof *stack * num_args);
+        VM_ENTER(callee);
+        VM_NEXT;
+
+    VM_CASE(OP_CALL_CLOSURE):
+        num_args = code[pc++];
+        words = vm_words(stack[--sp]);
+        callee = words[0];
+        VM_PUSH_FRAME();
+        base = sp - num_args;
+        goto enter_closure;
+
+    VM_CASE(OP_TAIL_CALL_CLOSURE):
+        num_args = code[pc++];
+        words = vm_words(stack[--sp]);
+        callee = words[0];
+        memmove(&stack[base], &stack[sp - num_args],
+            sizeof *stack * num_args);
+        goto enter_closure;
+
+    enter_closure:
+        // The captures follow the arguments.
+        VM_ENTER(callee);
+        memcpy(&stack[base + num_args], words + 1,
+            sizeof *words * function->num_captures);
+        VM_NEXT;
+
+    VM_CASE(OP_BUILTIN):
+        callee = code[pc++];
+        num_args = code[pc++];
+        sp -= num_args;
+        builtin = builtin_lookup(&ctx->symbol_table, callee);
+        if (!builtin->run(&stack[sp], &value)) {
+            fprintf(stderr, "Evaluation overflowed 64 bits in \"%s\".\n",
+                builtin->name);
+            return false;
+        }
+        stack[sp++] = value;
+        VM_NEXT;
+
+    VM_CASE(OP_RETURN):
+        value = stack[sp - 1];
+        if (num_frames == 0) {
+            *result = value;
+            return true;
+        }
+        num_frames -= 1;
+
+        // What the call allocated is unreachable once it returns, unless
+        // its result refers to it. A tuple of values which do not is moved
+        // down to where the call started allocating.
+        num_args = function->result_words;
+        if (num_args != SIZE_MAX) {
+            vm_reserve_stack(vm, sp + num_args);
+            stack = vm->stack;
+            if (num_args > 0) {
+                memcpy(&stack[sp], vm_words(value), sizeof *stack * num_args);
+            }
+            vm_arena_release(vm, &vm->frames[num_frames].mark);
+            if (num_args > 0) {
+                words = vm_arena_alloc(vm, num_args);
+                memcpy(words, &stack[sp], sizeof *words * num_args);
+                value = vm_pointer(words);
+            }
+        }
+
+        sp = base;
+        stack[sp++] = value;
+        pc = vm->frames[num_frames].return_to;
+        base = vm->frames[num_frames].base;
+        function = vm->frames[num_frames].function;
+        VM_NEXT;
+
+    VM_CASE(OP_TRAP):
+        fprintf(stderr, "Evaluation reached explode.\n");
+        return false;
+
+#ifndef VM_THREADED
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_ENTER
+#undef VM_PUSH_FRAME
+}
+
+/***** Reading Values Back ***************************************************/
+
+bool vm_value_to_expr(Context *ctx, VmValue value, const Expr *type,
+        Expr *result) {
+    Expr whnf[1];
+    if (!type_eval_transparent(ctx, type, whnf)) {
+        return false;
+    }
+
+    bool ret_val = true;
+    const VmValue *words;
+
+    switch (whnf->tag) {
+      case EXPR_NAT:
+        *result = (Expr){
+              .tag = EXPR_NATURAL
+            , .well_typed = true
+            , .natural = natural_small(value)
+        };
+        break;
+
+      case EXPR_BOOL:
+        *result = (Expr){
+              .tag = EXPR_BOOLEAN
+            , .well_typed = true
+            , .boolean = value != 0
+        };
+        break;
+
+      case EXPR_SIGMA:
+        // Each field's type sees the values of the fields before it.
+        words = vm_words(value);
+        *result = (Expr){
+              .tag = EXPR_PACK
+            , .well_typed = true
+            , .pack.as_type = NULL
+            , .pack.num_fields = 0
+        };
+        alloc_array(result->pack.field_values, whnf->sigma.num_fields);
+
+        for (size_t i = 0; ret_val && i < whnf->sigma.num_fields; i++) {
+            Expr field_type = expr_copy(ctx, &whnf->sigma.field_types[i]);
+            expr_subst_many(ctx, &field_type, i, whnf->sigma.field_names,
+                result->pack.field_values);
+            ret_val = vm_value_to_expr(ctx, words[i], &field_type,
+                &result->pack.field_values[i]);
+            expr_free(ctx, &field_type);
+            if (ret_val) {
+                result->pack.num_fields += 1;
+            }
+        }
+
+        if (!ret_val) {
+            expr_free(ctx, result);
+        }
+        break;
+
+      default:
+        ret_val = false;
+        break;
+    }
+
+    expr_free(ctx, whnf);
+    return ret_val;
+}
@@ -0,0 +1,158 @@
+#!/bin/sh
+# Runs the example programs in test/programs with bin/dependent-c:
+#     check/NAME.dc   must type check without reporting anything, with and
+#                     without compiled evaluation and with every global JIT
+#                     compiled. If there is a NAME.expected, every line of it
+#                     must be printed when checked without the JIT, which
+#                     changes how many calls are evaluated.
+#     reject/NAME.dc  must be rejected, reporting every line of NAME.expected.
+#     run/NAME.dc     must run main with --run and --bench, printing every
+#                     line of NAME.expected, with the bytecode and type_eval
+#                     results agreeing, in at most 64 MB of memory.
+#     emit/NAME.dc    is emitted with --emit-c as program.c, which
+#                     NAME.main.c includes; its output must be NAME.expected.
+#                     Every named type it declares must be used elsewhere.
+#                     The --emit-c-dir output must build with make.
+# An optional NAME.flags holds extra arguments for bin/dependent-c.
+# Prints each failure, and exits with failure if there were any.
+
+cd "$(dirname "$0")/.." || exit 1
+compiler=./bin/dependent-c
+cc=${CC:-cc}
+failures=0
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+fail() {
+    echo "FAIL: $1"
+    failures=$((failures + 1))
+}
+
+flags() {
+    if [ -f "${1%.dc}.flags" ]; then
+        cat "${1%.dc}.flags"
+    fi
+}
+
+# Checks that $output contains every line of the program's .expected file.
+expect() {
+    while IFS= read -r line; do
+        case "$output" in
+          *"$line"*) ;;
+          *) fail "$1 did not report: $line" ;;
+        esac
+    done < "${1%.dc}.expected"
+}
+
+# Prints the named types declared in emitted C which nothing else refers to.
+# Each declaration is a paragraph of its own, naming the type last.
+unused_types() {
+    awk -v RS= '
+        function words(text, list) {
+            return split(text, list, /[^A-Za-z0-9_]+/)
+        }
+        { paragraphs[NR] = $0 }
+        END {
+            for (i = 1; i <= NR; i++) {
+                if (paragraphs[i] !~ /^typedef/) {
+                    continue
+                }
+                name = ""
+                n = words(paragraphs[i], list)
+                for (k = 1; k <= n; k++) {
+                    if (list[k] ~ /^dc_(record|fn|array|vector|union)_[0-9a-f]+$/) {
+                        name = list[k]
+                    }
+                }
+                used = name == ""
+                for (j = 1; j <= NR && !used; j++) {
+                    n = j == i ? 0 : words(paragraphs[j], list)
+                    for (k = 1; k <= n && !used; k++) {
+                        used = list[k] == name
+                    }
+                }
+                if (!used) {
+                    print name
+                }
+            }
+        }' "$1"
+}
+
+for program in test/programs/check/*.dc; do
+    for mode in "" --no-compiled-eval "--jit --jit-threshold=1"; do
+        # shellcheck disable=SC2046,SC2086
+        if ! errors=$("$compiler" $mode $(flags "$program") < "$program" \
+                2>&1 > /dev/null); then
+            fail "$program does not type check${mode:+ with $mode}"
+        elif [ -n "$errors" ]; then
+            fail "$program reported errors${mode:+ with $mode}"
+            printf '%s\n' "$errors"
+        elif [ -f "${program%.dc}.expected" ] \
+                && [ "${mode#--jit}" = "$mode" ]; then
+            # shellcheck disable=SC2046,SC2086
+            output=$("$compiler" $mode $(flags "$program") < "$program" 2>&1)
+            expect "$program"
+        fi
+    done
+done
+
+for program in test/programs/reject/*.dc; do
+    # shellcheck disable=SC2046
+    output=$("$compiler" $(flags "$program") < "$program" 2>&1)
+    if [ $? -eq 0 ]; then
+        fail "$program was not rejected"
+    fi
+    expect "$program"
+done
+
+escape=$(printf '\033')
+for program in test/programs/run/*.dc; do
+    # shellcheck disable=SC2046
+    output=$(ulimit -v 65536 && "$compiler" --run=main --bench \
+        $(flags "$program") < "$program" 2>&1)
+    if [ $? -ne 0 ]; then
+        fail "$program did not run"
+    fi
+    output=$(printf '%s\n' "$output" | sed "s/$escape\[[0-9;]*m//g")
+    case "$output" in
+      *disagrees*) fail "$program: bytecode and type_eval disagree" ;;
+    esac
+    expect "$program"
+done
+
+for program in test/programs/emit/*.dc; do
+    name=$(basename "$program" .dc)
+    rm -rf "$tmp/$name"
+    mkdir "$tmp/$name"
+    # shellcheck disable=SC2046
+    if ! "$compiler" --emit-c="$tmp/$name/program.c" $(flags "$program") \
+            < "$program" > /dev/null 2>&1; then
+        fail "$program could not be emitted"
+        continue
+    fi
+    for type in $(unused_types "$tmp/$name/program.c"); do
+        fail "$program: emitted C declares $type but never uses it"
+    done
+    if ! "$cc" -std=c11 -I"$tmp/$name" -o "$tmp/$name/main" \
+            "${program%.dc}.main.c" 2> "$tmp/$name/errors"; then
+        fail "$program: emitted C does not compile"
+        cat "$tmp/$name/errors"
+    elif ! "$tmp/$name/main" | diff "${program%.dc}.expected" - \
+            > "$tmp/$name/diff"; then
+        fail "$program: emitted C gave the wrong output"
+        cat "$tmp/$name/diff"
+    fi
+    mkdir "$tmp/$name/dir"
+    # shellcheck disable=SC2046
+    if ! "$compiler" --emit-c-dir="$tmp/$name/dir" $(flags "$program") \
+            < "$program" > /dev/null 2>&1 ||
+            ! make -s -C "$tmp/$name/dir" CC="$cc" > /dev/null 2>&1; then
+        fail "$program: split C output does not build"
+    fi
+done
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures program test(s) failed."
+    exit 1
+fi
+echo "All program tests passed."
@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include "program.c"
+
+/* Builtins passed as values are closures like any other global. */
+int main(void) {
+    printf("%llu %llu %d %d\n",
+        (unsigned long long)dc_fold(&dc_nat_add__closure, 0, 100),
+        (unsigned long long)dc_fold(&dc_nat_mul__closure, 1, 10),
+        dc_test(&dc_nat_lt__closure, 2, 3), dc_test(&dc_nat_eq__closure, 2, 3));
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include "program.c"
+
+/* Every environment use allocates is released when it returns, and those
+ * adder returns when its caller says so, leaving the arena empty.
+ */
+int main(void) {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < 1000000; i++) {
+        total += dc_use(i, 1);
+    }
+    for (uint64_t i = 0; i < 1000; i++) {
+        dcrt_mark mark = dcrt_save();
+        total += dc_adder(i)->code(dc_adder(i), 2);
+        dcrt_release(mark);
+    }
+    printf("%llu %s\n", (unsigned long long)total,
+        dcrt_top == NULL ? "released" : "leaked");
+    return 0;
+}
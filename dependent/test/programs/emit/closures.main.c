@@ -0,0 +1,9 @@
+#include <stdio.h>
+#include "program.c"
+
+int main(void) {
+    printf("%llu %llu %llu\n", (unsigned long long)dc_apply_adder(5, 2),
+        (unsigned long long)dc_apply_adder(40, 2),
+        (unsigned long long)dc_use(3, 4));
+    return 0;
+}
@@ -0,0 +1,14 @@
+#include <stdio.h>
+#include "program.c"
+
+int main(void) {
+    dcrt_mark mark = dcrt_save();
+    dc_record_9f654dce buffer = dc_make();
+    printf("%llu %d %llu %llu %llu\n", (unsigned long long)dc_length(buffer),
+        dc_last(buffer), (unsigned long long)dc_items(buffer)[0],
+        (unsigned long long)dc_items(buffer)[1],
+        (unsigned long long)dc_made_length());
+    dcrt_release(mark);
+    printf("%s\n", dcrt_top == NULL ? "released" : "leaked");
+    return 0;
+}
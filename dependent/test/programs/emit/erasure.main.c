@@ -0,0 +1,9 @@
+#include <stdio.h>
+#include "program.c"
+
+int main(void) {
+    printf("%llu %llu %d %d\n",
+        (unsigned long long)dc_first_pred(dc_swap(dc_make(3, 5))),
+        (unsigned long long)dc_pred(0), dc_positive(0), dc_positive(2));
+    return 0;
+}
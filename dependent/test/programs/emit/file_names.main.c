@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include "program.c"
+
+/* With --emit-c-dir, the files of program must not replace program.h, the
+ * header every file shares.
+ */
+int main(void) {
+    printf("%llu %llu\n", (unsigned long long)dc_program(1),
+        (unsigned long long)dc_twice(3));
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Count the blocks the arena allocates. */
+static unsigned long blocks = 0;
+
+static void *counting_malloc(size_t size) {
+    blocks += 1;
+    return malloc(size);
+}
+
+#define malloc counting_malloc
+#include "program.c"
+#undef malloc
+
+/* run is lowered to a loop, each step of which allocates the environment of
+ * the closure adder returns. Each step releases it, so the arena reuses its
+ * first block however many steps there are.
+ */
+int main(void) {
+    unsigned long long total = dc_run(1000000, 0);
+    printf("%llu %s %s\n", total, blocks == 1 ? "bounded" : "unbounded",
+        dcrt_top == NULL ? "released" : "leaked");
+    return 0;
+}
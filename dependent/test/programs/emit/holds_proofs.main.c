@@ -0,0 +1,8 @@
+#include <stdio.h>
+#include "program.c"
+
+int main(void) {
+    printf("%llu %llu\n", (unsigned long long)dc_safe_div(7, 2),
+        (unsigned long long)dc_halve(9));
+    return 0;
+}
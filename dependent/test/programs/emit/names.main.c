@@ -0,0 +1,8 @@
+#include <stdio.h>
+#include "program.c"
+
+int main(void) {
+    printf("%llu %llu\n", (unsigned long long)dc_triangle(0, 7),
+        (unsigned long long)dc_triangle(100, 5));
+    return 0;
+}
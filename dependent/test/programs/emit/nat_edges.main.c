@@ -0,0 +1,24 @@
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "program.c"
+
+static void trapped(int signal) {
+    static const char message[] = "trapped\n";
+    (void)signal;
+    write(STDOUT_FILENO, message, sizeof message - 1);
+    _exit(0);
+}
+
+int main(void) {
+    printf("%llu %llu %llu %llu %llu\n", (unsigned long long)dc_fits(),
+        (unsigned long long)dc_fits_mul(),
+        (unsigned long long)dc_sub_below_zero(),
+        (unsigned long long)dc_div_by_zero(),
+        (unsigned long long)dc_mod_by_zero());
+    fflush(stdout);
+    signal(SIGABRT, trapped);
+    printf("%llu\n", (unsigned long long)dc_too_big());
+    return 1;
+}
@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include "program.c"
+
+/* The specialization of second to {Nat, Bool} names the type of a[1] while
+ * reading a[1][0], which the generated code never refers to.
+ * test/programs.sh checks that it is not declared.
+ */
+int main(void) {
+    printf("%llu %llu\n", (unsigned long long)dc_main().f0,
+        (unsigned long long)dc_main().f1);
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include "program.c"
+
+/* Reading a[1][1][0] names the types of a[1] and a[1][1] along the way, but
+ * the generated code never refers to them. test/programs.sh checks that
+ * neither is declared.
+ */
+int main(void) {
+    printf("%llu\n", (unsigned long long)dc_main());
+    return 0;
+}